@@ -0,0 +1,1032 @@
+/*
+	Microbenchmarks for the per-cycle hot paths: COBS framing in the tx/rx callbacks,
+	DARTT round-trips over loopback against an in-process ActuatorEmulator, every
+	trig_fixed function and its trig_batch array version, gain multiplies with runtime vs
+	compile-time radix, the pctl_emu position loop, a cable_sim plant step, trajectory
+	sampling, the tension solver, forward kinematics, Line::push_sample, the plot channel
+	store, the CPU plot vertex transform and the plot history pyramid.
+
+	Each benchmark runs a number of samples of a fixed number of operations and reports
+	ns per operation (min / p50 / p99 / mean over samples). Output is CSV by default, one row
+	per benchmark, or a single JSON document with --json, so results can be diffed and
+	tracked from release to release.
+
+	usage: spooler_bench [options]
+		--json            JSON instead of CSV
+		--out FILE        write results to FILE instead of stdout
+		--filter STR      only run benchmarks whose name contains STR
+		--samples N       samples per benchmark (default 200; round-trips use 10x)
+		--port N          first UDP port for the emulated actuator (default 5480)
+		--list            print benchmark names and exit
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <functional>
+#include <cmath>
+
+#define TINYCSOCKET_IMPLEMENTATION
+#include "tinycsocket.h"
+
+#include "dartt_init.h"
+#include "motor.h"
+#include "actuator_emulator.h"
+#include "trig_fixed.h"
+#include "trig_batch.h"
+#include "fixed_q.h"
+#include "pctl_emu.h"
+#include "cable_sim.h"
+#include "trajectory.h"
+#include "tension_solver.h"
+#include "kinematics.h"
+#include "plotting.h"
+#include "history_pyramid.h"
+
+struct BenchResult
+{
+	std::string name;
+	uint64_t ops;	//operations timed, over all samples
+	double ns_min;
+	double ns_p50;
+	double ns_p99;
+	double ns_mean;
+	uint64_t errors;	//operations that returned a failure (round-trips, tension solves)
+};
+
+/*
+	A benchmark body runs ops operations and returns how many of them failed.
+	The result of every operation is folded into g_sink so nothing can be optimized away.
+*/
+typedef std::function<uint64_t(int ops)> bench_body_t;
+
+struct Benchmark
+{
+	const char* name;
+	int ops_per_sample;
+	int sample_scale;	//samples = --samples * sample_scale
+	bench_body_t body;
+};
+
+static volatile int64_t g_sink = 0;
+
+static BenchResult run_bench(const Benchmark& b, int samples)
+{
+	BenchResult r;
+	r.name = b.name;
+	r.ops = 0;
+	r.errors = 0;
+
+	b.body(b.ops_per_sample);	//warm caches, sockets and branch predictors
+
+	std::vector<double> ns;
+	ns.reserve(samples);
+	for (int s = 0; s < samples; s++)
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		r.errors += b.body(b.ops_per_sample);
+		auto t1 = std::chrono::steady_clock::now();
+		ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count() / b.ops_per_sample);
+		r.ops += b.ops_per_sample;
+	}
+	std::sort(ns.begin(), ns.end());
+	double sum = 0;
+	for (double v : ns)
+		sum += v;
+	r.ns_min = ns.front();
+	r.ns_p50 = ns[ns.size() / 2];
+	r.ns_p99 = ns[(ns.size() * 99) / 100];
+	r.ns_mean = sum / ns.size();
+	return r;
+}
+
+/*
+	Benchmark inputs. Fixed seed, so every run (and every release) times the same values.
+*/
+#define TRIG_INPUTS 4096
+
+static int32_t g_angle_12b[TRIG_INPUTS];	//-PI_12B..PI_12B
+static int32_t g_angle_14b[TRIG_INPUTS];	//-PI_14B..PI_14B
+static int32_t g_any_angle[TRIG_INPUTS];	//several turns either way, for wrap
+static int32_t g_y[TRIG_INPUTS];
+static int32_t g_x[TRIG_INPUTS];
+static int32_t g_sqrt32[TRIG_INPUTS];
+static int64_t g_sqrt64[TRIG_INPUTS];
+static int32_t g_encoder[TRIG_INPUTS];	//wrapped encoder readings of a moving spool
+
+static void init_inputs(void)
+{
+	std::mt19937 rng(12345);
+	std::uniform_int_distribution<int32_t> a12(-PI_12B, PI_12B);
+	std::uniform_int_distribution<int32_t> a14(-PI_14B, PI_14B);
+	std::uniform_int_distribution<int32_t> turns(-8 * TWO_PI_14B, 8 * TWO_PI_14B);
+	std::uniform_int_distribution<int32_t> xy(-(1 << 16), 1 << 16);	//atan2 shifts min(|x|,|y|) left by 14
+	std::uniform_int_distribution<int32_t> s32(0, INT32_MAX);
+	std::uniform_int_distribution<int64_t> s64(0, INT64_MAX);
+	std::uniform_int_distribution<int32_t> step(-PI_14B / 4, PI_14B / 4);
+	int32_t theta = 0;
+	for (int i = 0; i < TRIG_INPUTS; i++)
+	{
+		g_angle_12b[i] = a12(rng);
+		g_angle_14b[i] = a14(rng);
+		g_any_angle[i] = turns(rng);
+		g_y[i] = xy(rng);
+		g_x[i] = xy(rng);
+		g_sqrt32[i] = s32(rng);
+		g_sqrt64[i] = s64(rng);
+		theta += step(rng);
+		g_encoder[i] = wrap_2pi_14b(theta);
+	}
+}
+
+// one op = one call; the sample walks the input table
+#define TRIG_BENCH_1(fn, in) \
+	{#fn, TRIG_INPUTS, 1, [](int ops) -> uint64_t { \
+		int64_t acc = 0; \
+		for (int i = 0; i < ops; i++) \
+			acc += fn(in[i & (TRIG_INPUTS - 1)]); \
+		g_sink = g_sink + acc; \
+		return 0; }}
+
+// one op = one element; a sample is one call over the whole input table
+static int32_t g_batch_out[TRIG_INPUTS];
+
+#define TRIG_BATCH_BENCH_1(fn, in) \
+	{#fn, TRIG_INPUTS, 1, [](int ops) -> uint64_t { \
+		fn(in, g_batch_out, (size_t)ops); \
+		g_sink = g_sink + g_batch_out[ops - 1]; \
+		return 0; }}
+
+/*
+	Sample frame for the framing benchmarks: a 16 byte read reply (command_word, misc,
+	theta_rem_m, iq) with its address byte and CRC, the same shape SpoolerRobot reads every cycle.
+*/
+#define FRAME_LEN 19
+
+static unsigned char g_frame[FRAME_LEN];
+static unsigned char g_frame_cobs[64];
+static size_t g_frame_cobs_len = 0;
+
+static void init_frame(void)
+{
+	int32_t words[4] = {1500, 0, 123456, -200};
+	g_frame[0] = 0x01;
+	memcpy(g_frame + 1, words, sizeof(words));
+	g_frame[17] = 0x5A;
+	g_frame[18] = 0xC3;
+}
+
+static UdpState g_framing_state;
+
+static void init_framing_state(void)
+{
+	memset(&g_framing_state, 0, sizeof(g_framing_state));
+	g_framing_state.socket = TCS_SOCKET_INVALID;
+	g_framing_state.connected = true;	//STAGE/REPLAY never touch the socket
+	g_framing_state.rx_timeout_ms = -1;
+
+	//encode once through tx_blocking to get the wire form the decode benchmark replays
+	unsigned char work[SERIAL_BUFFER_SIZE];
+	memcpy(work, g_frame, FRAME_LEN);
+	dartt_buffer_t b = {.buf = work, .size = sizeof(work), .len = FRAME_LEN};
+	g_framing_state.mode = UDP_MODE_STAGE;
+	g_framing_state.tx_staged_len = 0;
+	tx_blocking(0x01, &b, &g_framing_state, 0);
+	g_frame_cobs_len = g_framing_state.tx_staged_len;
+	memcpy(g_frame_cobs, g_framing_state.tx_cobs_mem, g_frame_cobs_len);
+}
+
+static uint64_t bench_cobs_encode(int ops)
+{
+	unsigned char work[SERIAL_BUFFER_SIZE];
+	uint64_t errors = 0;
+	g_framing_state.mode = UDP_MODE_STAGE;
+	for (int i = 0; i < ops; i++)
+	{
+		memcpy(work, g_frame, FRAME_LEN);	//tx_blocking encodes in place
+		dartt_buffer_t b = {.buf = work, .size = sizeof(work), .len = FRAME_LEN};
+		g_framing_state.tx_staged_len = 0;
+		if (tx_blocking(0x01, &b, &g_framing_state, 0) != DARTT_PROTOCOL_SUCCESS)
+			errors++;
+	}
+	g_sink = g_sink + (int64_t)g_framing_state.tx_staged_len;
+	return errors;
+}
+
+static uint64_t bench_cobs_decode(int ops)
+{
+	unsigned char work[SERIAL_BUFFER_SIZE];
+	uint64_t errors = 0;
+	g_framing_state.mode = UDP_MODE_REPLAY;
+	for (int i = 0; i < ops; i++)
+	{
+		memcpy(g_framing_state.rx_cobs_mem, g_frame_cobs, g_frame_cobs_len);
+		g_framing_state.rx_pending_len = g_frame_cobs_len;
+		dartt_buffer_t b = {.buf = work, .size = SERIAL_BUFFER_SIZE - NUM_BYTES_COBS_OVERHEAD, .len = 0};
+		if (rx_blocking(&b, &g_framing_state, 0) != DARTT_PROTOCOL_SUCCESS)
+			errors++;
+		g_sink = g_sink + (int64_t)b.len;
+	}
+	return errors;
+}
+
+/*
+	DARTT round-trips, blocking path, against an emulated actuator on loopback.
+	Reads are the 16 byte block SpoolerRobot reads each cycle; writes are command_word.
+*/
+static Motor* g_motor = nullptr;
+
+static uint64_t bench_dartt_read(int ops)
+{
+	uint64_t errors = 0;
+	for (int i = 0; i < ops; i++)
+	{
+		dartt_buffer_t r = {
+			.buf  = g_motor->ds.ctl_base.buf,
+			.size = sizeof(uint32_t) * 4,
+			.len  = sizeof(uint32_t) * 4
+		};
+		if (dartt_read_multi(&r, &g_motor->ds) != DARTT_PROTOCOL_SUCCESS)
+			errors++;
+	}
+	g_sink = g_sink + g_motor->dp_periph.theta_rem_m;
+	return errors;
+}
+
+static uint64_t bench_dartt_write(int ops)
+{
+	uint64_t errors = 0;
+	for (int i = 0; i < ops; i++)
+	{
+		g_motor->dp_ctl.command_word = (int32_t)(i & 0xFF);
+		dartt_buffer_t w = {
+			.buf  = g_motor->ds.ctl_base.buf,
+			.size = sizeof(uint32_t),
+			.len  = sizeof(uint32_t)
+		};
+		if (dartt_write_multi(&w, &g_motor->ds) != DARTT_PROTOCOL_SUCCESS)
+			errors++;
+	}
+	return errors;
+}
+
+// write command_word then read the block back, i.e. SpoolerRobot::write() + read() for one motor
+static uint64_t bench_dartt_write_read(int ops)
+{
+	uint64_t errors = 0;
+	for (int i = 0; i < ops; i++)
+	{
+		errors += bench_dartt_write(1);
+		errors += bench_dartt_read(1);
+	}
+	return errors;
+}
+
+/*
+	Fixed-point gains: one PI update per op (kp*e + ki*integral, integral clamped) with
+	runtime-radix i32_t gains as the firmware structs carry them, and with compile-time Q gains.
+	The i32_t radices are set at runtime so the compiler cannot turn them into constants.
+*/
+typedef Q<3, 12> gain_q_t;
+
+static i32_t g_kp_rt;
+static i32_t g_ki_rt;
+static const gain_q_t g_kp_q = gain_q_t::constant(2.5);
+static const gain_q_t g_ki_q = gain_q_t::constant(0.125);
+static volatile int32_t g_gain_radix = 12;
+
+static void init_gains(void)
+{
+	g_kp_rt.radix = g_gain_radix;
+	g_kp_rt.i32 = g_kp_q.raw;
+	g_ki_rt.radix = g_gain_radix;
+	g_ki_rt.i32 = g_ki_q.raw;
+}
+
+#define PI_INTEGRAL_SAT (1 << 20)
+
+static uint64_t bench_pi_runtime_radix(int ops)
+{
+	int32_t integral = 0;
+	int64_t acc = 0;
+	for (int i = 0; i < ops; i++)
+	{
+		int32_t e = g_y[i & (TRIG_INPUTS - 1)];
+		integral += e;
+		integral = integral > PI_INTEGRAL_SAT ? PI_INTEGRAL_SAT : (integral < -PI_INTEGRAL_SAT ? -PI_INTEGRAL_SAT : integral);
+		acc += (int32_t)(((int64_t)g_kp_rt.i32 * e) >> g_kp_rt.radix) + (int32_t)(((int64_t)g_ki_rt.i32 * integral) >> g_ki_rt.radix);
+	}
+	g_sink = g_sink + acc;
+	return 0;
+}
+
+static uint64_t bench_pi_q_template(int ops)
+{
+	int32_t integral = 0;
+	int64_t acc = 0;
+	for (int i = 0; i < ops; i++)
+	{
+		int32_t e = g_y[i & (TRIG_INPUTS - 1)];
+		integral += e;
+		integral = integral > PI_INTEGRAL_SAT ? PI_INTEGRAL_SAT : (integral < -PI_INTEGRAL_SAT ? -PI_INTEGRAL_SAT : integral);
+		acc += q_scale(e, g_kp_q) + q_scale(integral, g_ki_q);
+	}
+	g_sink = g_sink + acc;
+	return 0;
+}
+
+/*
+	pctl_emu: a full position-loop update (PI + damping + clamp) on the wire structs, one
+	call per op and as an array run over the same inputs.
+*/
+static pctl_params_t g_pctl;
+
+static void init_pctl(void)
+{
+	g_pctl.kpki.kp = g_kp_rt;
+	g_pctl.kpki.ki = g_ki_rt;
+	g_pctl.kpki.x_integral_div = 16;
+	g_pctl.kpki.x = 0;
+	g_pctl.kpki.x_sat = PI_INTEGRAL_SAT;
+	g_pctl.kpki.out_rshift = 2;
+	g_pctl.kd.i32 = 3 << 12;
+	g_pctl.kd.radix = g_gain_radix;
+	g_pctl.out_sat = 3000;
+}
+
+static uint64_t bench_pctl_step(int ops)
+{
+	int64_t acc = 0;
+	for (int i = 0; i < ops; i++)
+	{
+		acc += pctl_step(&g_pctl, g_y[i & (TRIG_INPUTS - 1)], g_x[i & (TRIG_INPUTS - 1)]);
+	}
+	g_sink = g_sink + acc;
+	return 0;
+}
+
+static uint64_t bench_pctl_run(int ops)
+{
+	pctl_run(&g_pctl, g_y, g_x, g_batch_out, (size_t)ops);
+	g_sink = g_sink + g_batch_out[ops - 1];
+	return 0;
+}
+
+/*
+	Cable-robot plant: one fixed integration step of the two-spool model, commands held.
+*/
+static uint64_t bench_cable_sim_step(int ops)
+{
+	static CableSim<2> plant;
+	plant.regs(0).command_word = 300;
+	plant.regs(1).command_word = 100;
+	for (int i = 0; i < ops; i++)
+	{
+		plant.step();
+	}
+	g_sink = g_sink + plant.regs(0).theta_rem_m;
+	return 0;
+}
+
+/*
+	Trajectory: one setpoint per op at a 1 kHz tick through the looping oscillation profile
+	(two S-curves and two dwells), as follow_trajectory samples it.
+*/
+static uint64_t bench_trajectory_sample(int ops)
+{
+	static Trajectory traj;
+	static double t = 0.0;
+	if (traj.empty())
+	{
+		const TrajLimits lim = {4000.0, 12000.0, 60000.0};
+		traj.reset(-2000.0);
+		traj.append_scurve(-20000.0, lim);
+		traj.append_hold(0.5);
+		traj.append_scurve(-2000.0, lim);
+		traj.append_hold(0.5);
+		traj.loop = true;
+	}
+	double acc = 0.0;
+	for (int i = 0; i < ops; i++)
+	{
+		acc += traj.sample(t);
+		t += 0.001;
+	}
+	g_sink = g_sink + (int64_t)acc;
+	return 0;
+}
+
+/*
+	Tension distribution, one solve per op at a 1 kHz tick. Poses follow a slow Lissajous
+	path through a 2 m cube frame, the wrench holds 100 N up against gravity plus a small
+	varying disturbance, limits are 10..1000 N. Structure matrices are precomputed so only
+	the solve is timed; any result that is not TENSION_OK counts as an error.
+		line_n2       the two-spool line (compute_tensions with use_tension_solver)
+		planar_n3     point mass in a vertical plane, three cables: closed form
+		3d_n4         point mass under the four top corners: closed form
+		3d_n8_warm    point mass, all eight corners, warm-started active-set QP
+		6dof_n8_warm  platform on eight crossed cables, warm-started
+		6dof_n8_cold  the same with reset() before every solve: the QP from scratch each
+		              cycle, the worst case against the 1 ms budget
+*/
+#define TENSION_POSES 1000
+#define TENSION_PATH_STEP (6.283185307179586 / TENSION_POSES)	//one lap of the path per TENSION_POSES
+
+template <int M, int N>
+struct TensionCase
+{
+	TensionSolver<M, N> solver;
+	std::vector<Eigen::Matrix<double, M, N>, Eigen::aligned_allocator<Eigen::Matrix<double, M, N>>> A;
+	std::vector<Eigen::Matrix<double, M, 1>, Eigen::aligned_allocator<Eigen::Matrix<double, M, 1>>> w;
+	int next = 0;
+};
+
+static TensionCase<1, 2> g_tension_line;
+static TensionCase<2, 3> g_tension_planar;
+static TensionCase<3, 4> g_tension_n4;
+static TensionCase<3, 8> g_tension_n8;
+static TensionCase<6, 8> g_tension_6dof;
+
+static Eigen::Vector3d tension_path(int k)
+{
+	double s = TENSION_PATH_STEP * k;
+	return Eigen::Vector3d(0.4 * sin(s), 0.3 * sin(2.0 * s), 0.2 * cos(3.0 * s));
+}
+
+// Point mass at x: column i is the unit vector towards anchor i
+template <int M, int N>
+static void tension_point_case(TensionCase<M, N>& c, const Eigen::Matrix<double, M, N>& anchor)
+{
+	c.solver.set_limits(10.0, 1000.0);
+	for (int k = 0; k < TENSION_POSES; k++)
+	{
+		Eigen::Matrix<double, M, 1> x = tension_path(k).template head<M>();
+		Eigen::Matrix<double, M, N> d = anchor.colwise() - x;
+		Eigen::Matrix<double, M, N> A = (d.array().rowwise() / d.colwise().norm().array()).matrix();
+		Eigen::Matrix<double, M, 1> w = Eigen::Matrix<double, M, 1>::Zero();
+		w[M - 1] = 100.0;
+		w[0] += 10.0 * sin(0.02 * k);
+		c.A.push_back(A);
+		c.w.push_back(w);
+	}
+}
+
+static void init_tension(void)
+{
+	g_tension_line.solver.set_limits(100.0, 600.0);
+	for (int k = 0; k < TENSION_POSES; k++)
+	{
+		g_tension_line.A.push_back(Eigen::Matrix<double, 1, 2>(1.0, -1.0));
+		g_tension_line.w.push_back(Eigen::Matrix<double, 1, 1>(300.0 * sin(TENSION_PATH_STEP * k)));
+	}
+
+	Eigen::Matrix<double, 2, 3> planar;
+	planar << -1.0, 1.0, 0.0,
+	           1.0, 1.0, -1.0;
+	tension_point_case(g_tension_planar, planar);
+
+	Eigen::Matrix<double, 3, 4> top;
+	top << -1.0, 1.0, 1.0, -1.0,
+	       -1.0, -1.0, 1.0, 1.0,
+	        1.0, 1.0, 1.0, 1.0;
+	tension_point_case(g_tension_n4, top);
+
+	Eigen::Matrix<double, 3, 8> corners;
+	for (int i = 0; i < 8; i++)
+		corners.col(i) = Eigen::Vector3d((i & 1) ? 1.0 : -1.0, (i & 2) ? 1.0 : -1.0, (i & 4) ? 1.0 : -1.0);
+	tension_point_case(g_tension_n8, corners);
+
+	//platform: corner i of a 0.2 m cube, cabled to the frame corner mirrored in x, and in y too for the bottom four
+	g_tension_6dof.solver.set_limits(10.0, 1000.0);
+	for (int k = 0; k < TENSION_POSES; k++)
+	{
+		Eigen::Vector3d x = tension_path(k);
+		Eigen::Matrix<double, 6, 8> A;
+		for (int i = 0; i < 8; i++)
+		{
+			Eigen::Vector3d b = 0.1 * corners.col(i);
+			Eigen::Vector3d a = corners.col(i);
+			a.x() = -a.x();
+			if (a.z() < 0.0)
+				a.y() = -a.y();
+			Eigen::Vector3d u = (a - x - b).normalized();
+			A.col(i) << u, b.cross(u);
+		}
+		Eigen::Matrix<double, 6, 1> w;
+		w << 10.0 * sin(0.02 * k), 0.0, 100.0, 0.0, 2.0 * cos(0.03 * k), 0.0;
+		g_tension_6dof.A.push_back(A);
+		g_tension_6dof.w.push_back(w);
+	}
+}
+
+template <int M, int N>
+static uint64_t bench_tension(TensionCase<M, N>& c, int ops, bool cold)
+{
+	uint64_t errors = 0;
+	Eigen::Matrix<double, N, 1> t;
+	double acc = 0.0;
+	for (int i = 0; i < ops; i++)
+	{
+		if (cold)
+			c.solver.reset();
+		if (c.solver.solve(c.A[c.next], c.w[c.next], t) != TENSION_OK)
+			errors++;
+		acc += t[0];
+		c.next = (c.next + 1) % TENSION_POSES;
+	}
+	g_sink = g_sink + (int64_t)acc;
+	return errors;
+}
+
+/*
+	Forward kinematics, one warm-started solve per op at a 1 kHz tick, along the tension
+	benchmark's path. Lengths are precomputed with inverse(), so only forward() is timed; a
+	solve that does not converge counts as an error.
+		line_n2   the two-spool line, 4.2 m span as in cable_sim
+		3d_n4     point mass under the four top corners of the 2 m frame
+		3d_n8     all eight corners
+*/
+template <int D, int N>
+struct KinematicsCase
+{
+	CableKinematics<D, N> kin;
+	std::vector<Eigen::Matrix<double, N, 1>, Eigen::aligned_allocator<Eigen::Matrix<double, N, 1>>> l;
+	int next = 0;
+};
+
+static KinematicsCase<2, 2> g_kin_line;
+static KinematicsCase<3, 4> g_kin_n4;
+static KinematicsCase<3, 8> g_kin_n8;
+
+template <int D, int N>
+static void kinematics_case(KinematicsCase<D, N>& c, const Eigen::Matrix<double, D, N>& anchor, const Eigen::Matrix<double, D, 1>& origin)
+{
+	c.kin.set_geometry(anchor, 0.01, origin);
+	for (int k = 0; k < TENSION_POSES; k++)
+	{
+		Eigen::Matrix<double, N, 1> l;
+		c.kin.inverse(origin + tension_path(k).template head<D>(), l);
+		c.l.push_back(l);
+	}
+}
+
+static void init_kinematics(void)
+{
+	Eigen::Matrix<double, 2, 2> line;
+	line << 0.0, 4.2,
+	        0.0, 0.0;
+	kinematics_case(g_kin_line, line, Eigen::Vector2d(2.1, -0.6));
+
+	Eigen::Matrix<double, 3, 4> top;
+	top << -1.0, 1.0, 1.0, -1.0,
+	       -1.0, -1.0, 1.0, 1.0,
+	        1.0, 1.0, 1.0, 1.0;
+	kinematics_case(g_kin_n4, top, Eigen::Vector3d(0.0, 0.0, 0.0));
+
+	Eigen::Matrix<double, 3, 8> corners;
+	for (int i = 0; i < 8; i++)
+		corners.col(i) = Eigen::Vector3d((i & 1) ? 1.0 : -1.0, (i & 2) ? 1.0 : -1.0, (i & 4) ? 1.0 : -1.0);
+	kinematics_case(g_kin_n8, corners, Eigen::Vector3d(0.0, 0.0, 0.0));
+}
+
+template <int D, int N>
+static uint64_t bench_kinematics(KinematicsCase<D, N>& c, int ops)
+{
+	uint64_t errors = 0;
+	Eigen::Matrix<double, D, 1> x;
+	double acc = 0.0;
+	for (int i = 0; i < ops; i++)
+	{
+		if (!c.kin.forward(c.l[c.next], x))
+			errors++;
+		acc += x[0];
+		c.next = (c.next + 1) % TENSION_POSES;
+	}
+	g_sink = g_sink + (int64_t)(acc * 1000.0);
+	return errors;
+}
+
+/*
+	Plotting, in a 1920x1080 window. Line 0 holds its own points at the default enqueue_cap,
+	fed from a sine. Line 1 reads the middle channel of a three channel timebase in
+	Plotter::channels (p, iq, dp as main.cpp keeps per motor), one row per pixel column.
+*/
+#define PLOT_POINTS 2000
+#define PLOT_ROWS 1920
+
+static Plotter* g_plotter = nullptr;
+static float g_plot_x = 0.f;
+static float g_plot_y = 0.f;
+static PlotTimebase g_plot_tb;
+
+static void append_plot_row(void)
+{
+	g_plot_x += 0.001f;
+	float row[3] = {cosf(g_plot_x * 6.f), sinf(g_plot_x * 6.f), 6.f * cosf(g_plot_x * 6.f)};
+	g_plotter->channels.append(g_plot_tb, g_plot_x, row);
+}
+
+static void init_plot(void)
+{
+	g_plotter = new Plotter();
+	g_plotter->window_width = 1920;
+	g_plotter->window_height = 1080;
+	g_plotter->lines.resize(2);
+	Line& l = g_plotter->lines[0];
+	l.yscale = 300.f;
+	l.color = template_colors[0];
+	for (int i = 0; i < PLOT_POINTS; i++)
+	{
+		g_plot_x += 0.001f;
+		g_plot_y = sinf(g_plot_x * 6.f);
+		l.push_sample(g_plot_x, g_plot_y, g_plotter->window_width);
+	}
+
+	g_plot_tb = g_plotter->channels.add_timebase(PLOT_ROWS);
+	g_plotter->channels.add_channel(g_plot_tb);
+	Line& c = g_plotter->lines[1];
+	c.channel = g_plotter->channels.add_channel(g_plot_tb);
+	g_plotter->channels.add_channel(g_plot_tb);
+	c.yscale = 300.f;
+	c.color = template_colors[1];
+	for (int i = 0; i < PLOT_ROWS; i++)
+	{
+		append_plot_row();
+	}
+	g_plotter->update();
+}
+
+// buffer already at enqueue_cap, so every call takes the drop-oldest path
+static uint64_t bench_enqueue_full(int ops)
+{
+	Line& l = g_plotter->lines[0];
+	l.enqueue_cap = PLOT_POINTS;
+	for (int i = 0; i < ops; i++)
+	{
+		g_plot_x += 0.001f;
+		g_plot_y = sinf(g_plot_x * 6.f);
+		l.push_sample(g_plot_x, g_plot_y, g_plotter->window_width);
+	}
+	g_sink = g_sink + (int64_t)l.points.size();
+	return 0;
+}
+
+// the same with a 10^6 sample history: append cost should not depend on the cap. In a
+// 1920 px window this line decimates to min/max columns of 521 samples.
+static Line g_line_1m;
+
+static void fill_line_1m(void)
+{
+	if (g_line_1m.enqueue_cap == 1000000)
+		return;
+	g_line_1m.enqueue_cap = 1000000;
+	for (int i = 0; i < 1000000; i++)
+	{
+		g_plot_x += 0.001f;
+		g_plot_y = sinf(g_plot_x * 6.f);
+		g_line_1m.push_sample(g_plot_x, g_plot_y, g_plotter->window_width);
+	}
+}
+
+static uint64_t bench_enqueue_full_1m(int ops)
+{
+	fill_line_1m();
+	for (int i = 0; i < ops; i++)
+	{
+		g_plot_x += 0.001f;
+		g_plot_y = sinf(g_plot_x * 6.f);
+		g_line_1m.push_sample(g_plot_x, g_plot_y, g_plotter->window_width);
+	}
+	g_sink = g_sink + (int64_t)g_line_1m.points.size();
+	return 0;
+}
+
+// one op = the vertices for one full line. render() now leaves this to the vertex shader and
+// uploads only new samples; this row is what each frame cost on the CPU before that.
+static uint64_t bench_build_vertices(int ops)
+{
+	static std::vector<PlotVertex> verts;
+	for (int i = 0; i < ops; i++)
+	{
+		g_plotter->build_vertices(g_plotter->lines[0], verts);
+		g_sink = g_sink + (int64_t)verts.back().y;
+	}
+	return 0;
+}
+
+// the 10^6 sample line: decimated, so about as many vertices as the 2000 point one
+static uint64_t bench_build_vertices_1m(int ops)
+{
+	static std::vector<PlotVertex> verts;
+	fill_line_1m();
+	for (int i = 0; i < ops; i++)
+	{
+		g_plotter->build_vertices(g_line_1m, verts);
+		g_sink = g_sink + (int64_t)verts.back().y;
+	}
+	return 0;
+}
+
+// one row of three channels: a shared timestamp and three value columns, no allocation
+static uint64_t bench_channels_append(int ops)
+{
+	for (int i = 0; i < ops; i++)
+	{
+		append_plot_row();
+	}
+	g_sink = g_sink + (int64_t)g_plotter->channels.time(g_plot_tb).size();
+	return 0;
+}
+
+// the vertices for the channel line, read straight from its time and value columns
+static uint64_t bench_build_vertices_channel(int ops)
+{
+	static std::vector<PlotVertex> verts;
+	for (int i = 0; i < ops; i++)
+	{
+		g_plotter->build_vertices(g_plotter->lines[1], verts);
+		g_sink = g_sink + (int64_t)verts.back().y;
+	}
+	return 0;
+}
+
+/*
+	History pyramid, 8 MB as main.cpp gives each plot line, filled with three hours of a 1 kHz
+	sine. push is one sample into every level; query_* summarise a window ending at the
+	newest sample into 1920 columns, and should cost about the same at any window length.
+*/
+#define HISTORY_RATE_HZ 1000.0
+#define HISTORY_FILL_S (3.0 * 3600.0)
+
+static HistoryPyramid* g_history = nullptr;
+static double g_history_t = 0.0;
+
+static void fill_history(void)
+{
+	if (g_history != nullptr)
+		return;
+	g_history = new HistoryPyramid();
+	g_history->configure(8u << 20);
+	for (long i = 0; i < (long)(HISTORY_FILL_S * HISTORY_RATE_HZ); i++)
+	{
+		g_history_t += 1.0 / HISTORY_RATE_HZ;
+		g_history->push(g_history_t, sinf((float)g_history_t * 0.1f));
+	}
+}
+
+static uint64_t bench_history_push(int ops)
+{
+	fill_history();
+	for (int i = 0; i < ops; i++)
+	{
+		g_history_t += 1.0 / HISTORY_RATE_HZ;
+		g_history->push(g_history_t, sinf((float)g_history_t * 0.1f));
+	}
+	return 0;
+}
+
+static uint64_t bench_history_query(int ops, double window_s)
+{
+	static std::vector<HistoryBin> bins(1920);
+	fill_history();
+	uint64_t errors = 0;
+	for (int i = 0; i < ops; i++)
+	{
+		if (g_history->query(g_history_t - window_s, g_history_t, 1920, bins.data()) < 0)
+			errors++;
+		g_sink = g_sink + (int64_t)bins[1919].count;
+	}
+	return errors;
+}
+
+static void print_csv(FILE* out, const std::vector<BenchResult>& results)
+{
+	fprintf(out, "name,ops,ns_per_op_min,ns_per_op_p50,ns_per_op_p99,ns_per_op_mean,errors\n");
+	for (const BenchResult& r : results)
+	{
+		fprintf(out, "%s,%llu,%.2f,%.2f,%.2f,%.2f,%llu\n", r.name.c_str(), (unsigned long long)r.ops,
+			r.ns_min, r.ns_p50, r.ns_p99, r.ns_mean, (unsigned long long)r.errors);
+	}
+}
+
+static void print_json(FILE* out, const std::vector<BenchResult>& results, int samples)
+{
+#if defined(__clang__)
+	const char* compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+	const char* compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+	const char* compiler = "msvc";
+#else
+	const char* compiler = "unknown";
+#endif
+#ifdef NDEBUG
+	const char* build = "release";
+#else
+	const char* build = "debug";
+#endif
+	long long now = (long long)std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	fprintf(out, "{\n  \"schema\": 1,\n  \"unix_time\": %lld,\n  \"compiler\": \"%s\",\n  \"build\": \"%s\",\n"
+		"  \"trig_batch_isa\": \"%s\",\n  \"samples\": %d,\n  \"results\": [\n", now, compiler, build,
+		trig_batch_isa_name(trig_batch_isa()), samples);
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult& r = results[i];
+		fprintf(out, "    {\"name\": \"%s\", \"ops\": %llu, \"ns_per_op_min\": %.2f, \"ns_per_op_p50\": %.2f, "
+			"\"ns_per_op_p99\": %.2f, \"ns_per_op_mean\": %.2f, \"errors\": %llu}%s\n",
+			r.name.c_str(), (unsigned long long)r.ops, r.ns_min, r.ns_p50, r.ns_p99, r.ns_mean,
+			(unsigned long long)r.errors, (i + 1 < results.size()) ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char* argv[])
+{
+	bool json = false;
+	bool list = false;
+	const char* out_path = nullptr;
+	const char* filter = nullptr;
+	int samples = 200;
+	uint16_t port = 5480;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--json") == 0)
+			json = true;
+		else if (strcmp(argv[i], "--list") == 0)
+			list = true;
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			out_path = argv[++i];
+		else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+			samples = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+			port = (uint16_t)atoi(argv[++i]);
+		else
+		{
+			printf("unknown option %s\n", argv[i]);
+			return -1;
+		}
+	}
+	if (samples < 1)
+	{
+		printf("--samples must be at least 1\n");
+		return -1;
+	}
+
+	std::vector<Benchmark> benches = {
+		{"cobs_encode_tx_stage", 1000, 1, bench_cobs_encode},
+		{"cobs_decode_rx_replay", 1000, 1, bench_cobs_decode},
+		{"dartt_read_multi_loopback", 1, 10, bench_dartt_read},
+		{"dartt_write_multi_loopback", 1, 10, bench_dartt_write},
+		{"dartt_write_read_loopback", 1, 10, bench_dartt_write_read},
+		TRIG_BENCH_1(sin_12b, g_angle_12b),
+		TRIG_BENCH_1(cos_12b, g_angle_12b),
+		TRIG_BENCH_1(sin_14b, g_angle_14b),
+		TRIG_BENCH_1(cos_14b, g_angle_14b),
+		{"atan2_12b", TRIG_INPUTS, 1, [](int ops) -> uint64_t {
+			int64_t acc = 0;
+			for (int i = 0; i < ops; i++)
+				acc += atan2_12b(g_y[i & (TRIG_INPUTS - 1)], g_x[i & (TRIG_INPUTS - 1)]);
+			g_sink = g_sink + acc;
+			return 0; }},
+		{"atan2_14b", TRIG_INPUTS, 1, [](int ops) -> uint64_t {
+			int64_t acc = 0;
+			for (int i = 0; i < ops; i++)
+				acc += atan2_14b(g_y[i & (TRIG_INPUTS - 1)], g_x[i & (TRIG_INPUTS - 1)]);
+			g_sink = g_sink + acc;
+			return 0; }},
+		TRIG_BENCH_1(wrap_2pi_12b, g_any_angle),
+		TRIG_BENCH_1(wrap_2pi_14b, g_any_angle),
+		{"wrap_2pi_fixed", TRIG_INPUTS, 1, [](int ops) -> uint64_t {
+			int64_t acc = 0;
+			for (int i = 0; i < ops; i++)
+				acc += wrap_2pi_fixed(g_any_angle[i & (TRIG_INPUTS - 1)], TWO_PI_14B);
+			g_sink = g_sink + acc;
+			return 0; }},
+		{"unwrap_angle_32b_overflow", TRIG_INPUTS, 1, [](int ops) -> uint64_t {
+			static unwrap_state_t st = {0, 0, 0};
+			int64_t acc = 0;
+			for (int i = 0; i < ops; i++)
+				acc += unwrap_angle_32b_overflow(g_encoder[i & (TRIG_INPUTS - 1)], TWO_PI_14B, &st);
+			g_sink = g_sink + acc;
+			return 0; }},
+		TRIG_BENCH_1(sqrt_i32, g_sqrt32),
+		TRIG_BENCH_1(sqrt_i64, g_sqrt64),
+		TRIG_BATCH_BENCH_1(sin_14b_batch, g_angle_14b),
+		TRIG_BATCH_BENCH_1(cos_14b_batch, g_angle_14b),
+		{"atan2_14b_batch", TRIG_INPUTS, 1, [](int ops) -> uint64_t {
+			atan2_14b_batch(g_y, g_x, g_batch_out, (size_t)ops);
+			g_sink = g_sink + g_batch_out[ops - 1];
+			return 0; }},
+		TRIG_BATCH_BENCH_1(sqrt_i32_batch, g_sqrt32),
+		{"pi_gain_runtime_radix", TRIG_INPUTS, 1, bench_pi_runtime_radix},
+		{"pi_gain_q_template", TRIG_INPUTS, 1, bench_pi_q_template},
+		{"pctl_step", TRIG_INPUTS, 1, bench_pctl_step},
+		{"pctl_run", TRIG_INPUTS, 1, bench_pctl_run},
+		{"cable_sim_step_2spool", 1000, 1, bench_cable_sim_step},
+		{"trajectory_sample_1khz", 1000, 1, bench_trajectory_sample},
+		{"tension_line_n2", 1000, 1, [](int ops) -> uint64_t { return bench_tension(g_tension_line, ops, false); }},
+		{"tension_planar_n3", 1000, 1, [](int ops) -> uint64_t { return bench_tension(g_tension_planar, ops, false); }},
+		{"tension_3d_n4", 1000, 1, [](int ops) -> uint64_t { return bench_tension(g_tension_n4, ops, false); }},
+		{"tension_3d_n8_warm", 1000, 1, [](int ops) -> uint64_t { return bench_tension(g_tension_n8, ops, false); }},
+		{"tension_6dof_n8_warm", 1000, 1, [](int ops) -> uint64_t { return bench_tension(g_tension_6dof, ops, false); }},
+		{"tension_6dof_n8_cold", 1000, 1, [](int ops) -> uint64_t { return bench_tension(g_tension_6dof, ops, true); }},
+		{"kinematics_line_n2", 1000, 1, [](int ops) -> uint64_t { return bench_kinematics(g_kin_line, ops); }},
+		{"kinematics_3d_n4", 1000, 1, [](int ops) -> uint64_t { return bench_kinematics(g_kin_n4, ops); }},
+		{"kinematics_3d_n8", 1000, 1, [](int ops) -> uint64_t { return bench_kinematics(g_kin_n8, ops); }},
+		{"line_push_sample_full", 1000, 1, bench_enqueue_full},
+		{"line_push_sample_full_1m", 1000, 1, bench_enqueue_full_1m},
+		{"plot_channels_append_3ch", 1000, 1, bench_channels_append},
+		{"plot_build_vertices_2000pts", 10, 1, bench_build_vertices},
+		{"plot_build_vertices_1m", 10, 1, bench_build_vertices_1m},
+		{"plot_build_vertices_channel_1920", 10, 1, bench_build_vertices_channel},
+		{"history_push", 1000, 1, bench_history_push},
+		{"history_query_10s", 1, 1, [](int ops) -> uint64_t { return bench_history_query(ops, 10.0); }},
+		{"history_query_1h", 1, 1, [](int ops) -> uint64_t { return bench_history_query(ops, 3600.0); }},
+	};
+
+	if (list)
+	{
+		for (const Benchmark& b : benches)
+			printf("%s\n", b.name);
+		return 0;
+	}
+
+	init_inputs();
+	init_frame();
+	init_framing_state();
+	init_gains();
+	init_pctl();
+	init_tension();
+	init_kinematics();
+	init_plot();
+
+	bool need_emulator = false;
+	for (const Benchmark& b : benches)
+	{
+		if (strncmp(b.name, "dartt_", 6) == 0 && (filter == nullptr || strstr(b.name, filter) != nullptr))
+			need_emulator = true;
+	}
+	ActuatorEmulator emulator;
+	if (need_emulator)
+	{
+		if (!emulator.add_motor(0x1, "127.0.0.1", port) || !emulator.start())
+		{
+			printf("Failed to start the emulated actuator on port %u\n", port);
+			return -1;
+		}
+		g_motor = new Motor(0x1);
+		snprintf(g_motor->socket.ip, sizeof(g_motor->socket.ip), "%s", "127.0.0.1");
+		g_motor->socket.port = port;
+		if (!udp_connect(&g_motor->socket))
+		{
+			printf("Failed to connect to the emulated actuator\n");
+			emulator.stop();
+			return -1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+
+	std::vector<BenchResult> results;
+	for (const Benchmark& b : benches)
+	{
+		if (filter != nullptr && strstr(b.name, filter) == nullptr)
+			continue;
+		results.push_back(run_bench(b, samples * b.sample_scale));
+	}
+
+	if (g_motor != nullptr)
+	{
+		udp_disconnect(&g_motor->socket);
+		delete g_motor;
+		emulator.stop();
+	}
+	delete g_plotter;
+	delete g_history;
+
+	FILE* out = stdout;
+	if (out_path != nullptr)
+	{
+		out = fopen(out_path, "w");
+		if (out == NULL)
+		{
+			printf("Failed to open %s for writing\n", out_path);
+			return -1;
+		}
+	}
+	if (json)
+		print_json(out, results, samples);
+	else
+		print_csv(out, results);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,252 @@
+/*
+	Exhaustive check that the trig_batch kernels match the scalar trig_fixed functions bit for bit.
+
+	For every kernel set this CPU supports:
+		sin_14b, cos_14b  every input in [-2PI_14B, 2PI_14B] (the documented range and the wrapped
+		                  region either side); --full sweeps all 2^32 inputs
+		sqrt_i32          all 2^32 inputs (negative inputs are roots of the uint32 value, as in the scalar code)
+		atan2_14b         every (y, x) in [-1024, 1024]^2; every ratio minv/maxv the polynomial can see,
+		                  in all eight octants, at three magnitudes; 2^26 random pairs with |y|, |x| < 2^17
+	Inputs go through in odd-sized, misaligned chunks (and every other chunk in place) so the
+	vector tails and unaligned loads are covered too.
+
+	usage: trig_batch_verify [--full] [--isa scalar|sse4.1|avx2]
+	Exits 1 on any mismatch.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#include "trig_fixed.h"
+#include "trig_batch.h"
+
+#define CHUNK 4093	//odd, so every chunk ends in a scalar tail
+
+typedef void (*batch1_t)(const int32_t*, int32_t*, size_t);
+typedef int32_t (*scalar1_t)(int32_t);
+
+struct Mismatches
+{
+	uint64_t checked;
+	uint64_t count;
+	int32_t first_in[2];
+	int32_t first_got;
+	int32_t first_want;
+
+	Mismatches() : checked(0), count(0), first_in{0, 0}, first_got(0), first_want(0) {}
+
+	void check(int32_t in0, int32_t in1, int32_t got, int32_t want)
+	{
+		checked++;
+		if (got != want)
+		{
+			if (count == 0)
+			{
+				first_in[0] = in0;
+				first_in[1] = in1;
+				first_got = got;
+				first_want = want;
+			}
+			count++;
+		}
+	}
+};
+
+static bool report(const char* fn, const char* isa, const char* domain, const Mismatches& m, bool two_args)
+{
+	printf("%-10s %-7s %-34s %12llu checked  %llu mismatches", fn, isa, domain,
+		(unsigned long long)m.checked, (unsigned long long)m.count);
+	if (m.count != 0)
+	{
+		if (two_args)
+			printf("  first: (%d, %d) -> %d, scalar %d", m.first_in[0], m.first_in[1], m.first_got, m.first_want);
+		else
+			printf("  first: %d -> %d, scalar %d", m.first_in[0], m.first_got, m.first_want);
+	}
+	printf("\n");
+	return m.count == 0;
+}
+
+// every int32 in [lo, hi]
+static Mismatches sweep1(batch1_t batch, scalar1_t scalar, int64_t lo, int64_t hi)
+{
+	Mismatches m;
+	std::vector<int32_t> in(CHUNK + 1);
+	std::vector<int32_t> out(CHUNK + 1);
+	int32_t* pin = in.data() + 1;	//misaligned on purpose
+	int32_t* pout = out.data() + 1;
+	uint64_t chunk = 0;
+	for (int64_t base = lo; base <= hi; base += CHUNK, chunk++)
+	{
+		size_t n = (size_t)((hi - base + 1) < CHUNK ? (hi - base + 1) : CHUNK);
+		for (size_t i = 0; i < n; i++)
+			pin[i] = (int32_t)(base + (int64_t)i);
+		if (chunk & 1)
+		{
+			memcpy(pout, pin, n * sizeof(int32_t));
+			batch(pout, pout, n);
+		}
+		else
+		{
+			batch(pin, pout, n);
+		}
+		for (size_t i = 0; i < n; i++)
+			m.check(pin[i], 0, pout[i], scalar(pin[i]));
+	}
+	return m;
+}
+
+// pairs produced by next(y, x), CHUNK at a time, until it returns false
+template <typename F>
+static void sweep2(Mismatches& m, F next)
+{
+	std::vector<int32_t> y(CHUNK + 1), x(CHUNK + 1), out(CHUNK + 1);
+	int32_t* py = y.data() + 1;
+	int32_t* px = x.data() + 1;
+	int32_t* pout = out.data() + 1;
+	bool more = true;
+	while (more)
+	{
+		size_t n = 0;
+		while (n < CHUNK && (more = next(py[n], px[n])))
+			n++;
+		atan2_14b_batch(py, px, pout, n);
+		for (size_t i = 0; i < n; i++)
+			m.check(py[i], px[i], pout[i], atan2_14b(py[i], px[i]));
+	}
+}
+
+static Mismatches verify_atan2(void)
+{
+	Mismatches m;
+
+	//small grid: every sign and octant combination, axes and the origin
+	{
+		int32_t y = -1024, x = -1024;
+		sweep2(m, [&](int32_t& oy, int32_t& ox) {
+			if (y > 1024)
+				return false;
+			oy = y;
+			ox = x;
+			if (++x > 1024)
+			{
+				x = -1024;
+				y++;
+			}
+			return true;
+		});
+	}
+
+	//every minv in [0, maxv] for a few maxv, i.e. every polynomial input, in all 8 octants
+	{
+		const int32_t maxvs[3] = {1 << 14, 100003, (1 << 17) - 1};
+		int mi = 0;
+		int octant = 0;
+		int32_t minv = 0;
+		sweep2(m, [&](int32_t& oy, int32_t& ox) {
+			if (mi == 3)
+				return false;
+			int32_t maxv = maxvs[mi];
+			int32_t a = (octant & 1) ? maxv : minv;
+			int32_t b = (octant & 1) ? minv : maxv;
+			oy = (octant & 2) ? -a : a;
+			ox = (octant & 4) ? -b : b;
+			if (++minv > maxv)
+			{
+				minv = 0;
+				if (++octant == 8)
+				{
+					octant = 0;
+					mi++;
+				}
+			}
+			return true;
+		});
+	}
+
+	//random pairs over the whole range where (minv << 14) does not overflow
+	{
+		std::mt19937 rng(7);
+		std::uniform_int_distribution<int32_t> d(-((1 << 17) - 1), (1 << 17) - 1);
+		uint64_t left = 1ull << 26;
+		sweep2(m, [&](int32_t& oy, int32_t& ox) {
+			if (left == 0)
+				return false;
+			left--;
+			oy = d(rng);
+			ox = d(rng);
+			return true;
+		});
+	}
+	return m;
+}
+
+int main(int argc, char* argv[])
+{
+	bool full = false;
+	int only = -1;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--full") == 0)
+		{
+			full = true;
+		}
+		else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc)
+		{
+			i++;
+			for (int isa = TRIG_BATCH_SCALAR; isa <= TRIG_BATCH_AVX2; isa++)
+			{
+				if (strcmp(argv[i], trig_batch_isa_name((trig_batch_isa_t)isa)) == 0)
+					only = isa;
+			}
+			if (only < 0)
+			{
+				printf("unknown isa %s\n", argv[i]);
+				return -1;
+			}
+		}
+		else
+		{
+			printf("usage: %s [--full] [--isa scalar|sse4.1|avx2]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	printf("default kernel set: %s\n", trig_batch_isa_name(trig_batch_isa()));
+	const int64_t sin_lo = full ? INT32_MIN : -2 * (int64_t)TWO_PI_14B;
+	const int64_t sin_hi = full ? INT32_MAX : 2 * (int64_t)TWO_PI_14B;
+	const char* sin_domain = full ? "all int32" : "[-2PI_14B, 2PI_14B]";
+
+	bool ok = true;
+	int tested = 0;
+	for (int i = TRIG_BATCH_SCALAR; i <= TRIG_BATCH_AVX2; i++)
+	{
+		trig_batch_isa_t isa = (trig_batch_isa_t)i;
+		if (only >= 0 && i != only)
+			continue;
+		const char* name = trig_batch_isa_name(isa);
+		if (!trig_batch_set_isa(isa))
+		{
+			printf("%s: not supported on this CPU/build, skipped\n", name);
+			continue;
+		}
+		tested++;
+		auto t0 = std::chrono::steady_clock::now();
+		ok &= report("sin_14b", name, sin_domain, sweep1(sin_14b_batch, sin_14b, sin_lo, sin_hi), false);
+		ok &= report("cos_14b", name, sin_domain, sweep1(cos_14b_batch, cos_14b, sin_lo, sin_hi), false);
+		ok &= report("sqrt_i32", name, "all int32", sweep1(sqrt_i32_batch, sqrt_i32, INT32_MIN, INT32_MAX), false);
+		ok &= report("atan2_14b", name, "grid + octant ratios + random", verify_atan2(), true);
+		printf("%s: %.1f s\n", name, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+	}
+	if (tested == 0)
+	{
+		printf("nothing tested\n");
+		return 1;
+	}
+	printf(ok ? "PASS\n" : "FAIL\n");
+	return ok ? 0 : 1;
+}
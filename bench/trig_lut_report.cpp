@@ -0,0 +1,253 @@
+/*
+	Accuracy and speed of the trig_lut.h table configurations against the polynomial
+	sin_12b / sin_14b / atan2_14b in trig_fixed.c.
+
+	For each variant: max and rms error against double-precision sin/atan2, in output LSBs
+	(1 / 2^Q), and ns per call. Every variant, polynomial included, is called through a
+	function pointer so call overhead is the same for all of them.
+		sin      every angle in [-PI_Q, PI_Q]
+		atan2    every point on a square of half-width 4096 around the origin (all angles at
+		         fine resolution), plus 2^20 random pairs with |y|, |x| < 2^16
+
+	usage: trig_lut_report [--budget LSB] [--out FILE]
+		--budget LSB   also report, per function, the fastest variant whose max error is within LSB
+	Output is CSV; the --budget lines are appended as # comments.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+#include "trig_fixed.h"
+#include "trig_lut.h"
+
+typedef int32_t (*fn1_t)(int32_t);
+typedef int32_t (*fn2_t)(int32_t, int32_t);
+
+struct Variant
+{
+	const char* function;	//sin_q14, sin_q12, atan2_q14
+	std::string name;
+	int q;
+	int table_bits;	//0 for the polynomial
+	const char* interp;
+	size_t table_bytes;
+	fn1_t f1;
+	fn2_t f2;
+
+	double max_err;
+	double rms_err;
+	double ns_per_call;
+};
+
+template <int Q, int B, trig_lut_interp_t I>
+static int32_t lut_sin(int32_t theta)
+{
+	return TrigLut<Q, B, I>::sin(theta);
+}
+
+template <int Q, int B, trig_lut_interp_t I>
+static int32_t lut_atan2(int32_t y, int32_t x)
+{
+	return TrigLut<Q, B, I>::atan2(y, x);
+}
+
+template <int Q, int B, trig_lut_interp_t I>
+static void add_lut(std::vector<Variant>& v)
+{
+	const char* interp = (I == TRIG_LUT_NEAREST) ? "nearest" : "linear";
+	char name[48];
+	snprintf(name, sizeof(name), "lut%d_%s", 1 << B, interp);
+	//each function only touches its own table
+	size_t bytes = TrigLut<Q, B, I>::table_bytes() / 2;
+	v.push_back({Q == 14 ? "sin_q14" : "sin_q12", name, Q, B, interp, bytes, &lut_sin<Q, B, I>, nullptr, 0, 0, 0});
+	if (Q == 14)
+		v.push_back({"atan2_q14", name, Q, B, interp, bytes, nullptr, &lut_atan2<Q, B, I>, 0, 0, 0});
+}
+
+template <int Q, int B>
+static void add_lut_both(std::vector<Variant>& v)
+{
+	add_lut<Q, B, TRIG_LUT_NEAREST>(v);
+	add_lut<Q, B, TRIG_LUT_LINEAR>(v);
+}
+
+static std::vector<int32_t> g_ay;
+static std::vector<int32_t> g_ax;
+
+static void atan2_inputs(void)
+{
+	const int32_t h = 4096;
+	for (int32_t i = -h; i < h; i++)
+	{
+		g_ay.push_back(h); g_ax.push_back(i);
+		g_ay.push_back(-h); g_ax.push_back(-i);
+		g_ay.push_back(-i); g_ax.push_back(h);
+		g_ay.push_back(i); g_ax.push_back(-h);
+	}
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<int32_t> d(-(1 << 16), 1 << 16);
+	for (int i = 0; i < (1 << 20); i++)
+	{
+		g_ay.push_back(d(rng));
+		g_ax.push_back(d(rng));
+	}
+}
+
+static void measure_error(Variant& v)
+{
+	const double scale = (double)(1 << v.q);
+	double max_err = 0;
+	double sum_sq = 0;
+	size_t n = 0;
+	if (v.f1 != nullptr)
+	{
+		const int32_t pi = (v.q == 14) ? PI_14B : PI_12B;
+		for (int32_t t = -pi; t <= pi; t++)
+		{
+			double err = fabs((double)v.f1(t) - sin((double)t / scale) * scale);
+			max_err = std::max(max_err, err);
+			sum_sq += err * err;
+			n++;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < g_ay.size(); i++)
+		{
+			double ref = atan2((double)g_ay[i], (double)g_ax[i]) * scale;
+			double err = fabs((double)v.f2(g_ay[i], g_ax[i]) - ref);
+			max_err = std::max(max_err, err);
+			sum_sq += err * err;
+			n++;
+		}
+	}
+	v.max_err = max_err;
+	v.rms_err = sqrt(sum_sq / (double)n);
+}
+
+static volatile int64_t g_sink = 0;
+
+static void measure_speed(Variant& v)
+{
+	const int N = 4096;
+	std::vector<int32_t> a(N), b(N);
+	std::mt19937 rng(11);
+	const int32_t pi = (v.q == 14) ? PI_14B : PI_12B;
+	std::uniform_int_distribution<int32_t> da(-pi, pi);
+	std::uniform_int_distribution<int32_t> dxy(-(1 << 16), 1 << 16);
+	for (int i = 0; i < N; i++)
+	{
+		a[i] = (v.f1 != nullptr) ? da(rng) : dxy(rng);
+		b[i] = dxy(rng);
+	}
+	fn1_t volatile f1 = v.f1;
+	fn2_t volatile f2 = v.f2;
+	double best = 1e30;
+	for (int run = 0; run < 7; run++)
+	{
+		int64_t acc = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		for (int rep = 0; rep < 200; rep++)
+		{
+			if (v.f1 != nullptr)
+			{
+				fn1_t f = f1;
+				for (int i = 0; i < N; i++)
+					acc += f(a[i]);
+			}
+			else
+			{
+				fn2_t f = f2;
+				for (int i = 0; i < N; i++)
+					acc += f(a[i], b[i]);
+			}
+		}
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / (200.0 * N);
+		best = std::min(best, ns);
+		g_sink = g_sink + acc;
+	}
+	v.ns_per_call = best;
+}
+
+int main(int argc, char* argv[])
+{
+	double budget = -1;
+	const char* out_path = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc)
+			budget = atof(argv[++i]);
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			out_path = argv[++i];
+		else
+		{
+			printf("usage: %s [--budget LSB] [--out FILE]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	std::vector<Variant> v;
+	v.push_back({"sin_q14", "poly", 14, 0, "-", 0, &sin_14b, nullptr, 0, 0, 0});
+	v.push_back({"sin_q12", "poly", 12, 0, "-", 0, &sin_12b, nullptr, 0, 0, 0});
+	v.push_back({"atan2_q14", "poly", 14, 0, "-", 0, nullptr, &atan2_14b, 0, 0, 0});
+	add_lut_both<14, 6>(v);
+	add_lut_both<14, 8>(v);
+	add_lut_both<14, 10>(v);
+	add_lut_both<14, 12>(v);
+	add_lut_both<12, 6>(v);
+	add_lut_both<12, 8>(v);
+	add_lut_both<12, 10>(v);
+	add_lut_both<12, 12>(v);
+
+	atan2_inputs();
+	for (Variant& x : v)
+	{
+		measure_error(x);
+		measure_speed(x);
+	}
+
+	FILE* out = stdout;
+	if (out_path != nullptr)
+	{
+		out = fopen(out_path, "w");
+		if (out == NULL)
+		{
+			printf("Failed to open %s for writing\n", out_path);
+			return -1;
+		}
+	}
+	fprintf(out, "function,variant,q,table_bits,interp,table_bytes,max_err_lsb,rms_err_lsb,ns_per_call\n");
+	for (const Variant& x : v)
+	{
+		fprintf(out, "%s,%s,%d,%d,%s,%zu,%.3f,%.3f,%.2f\n", x.function, x.name.c_str(), x.q, x.table_bits,
+			x.interp, x.table_bytes, x.max_err, x.rms_err, x.ns_per_call);
+	}
+	if (budget >= 0)
+	{
+		const char* functions[3] = {"sin_q14", "sin_q12", "atan2_q14"};
+		for (const char* fn : functions)
+		{
+			const Variant* best = nullptr;
+			for (const Variant& x : v)
+			{
+				if (strcmp(x.function, fn) == 0 && x.max_err <= budget && (best == nullptr || x.ns_per_call < best->ns_per_call))
+					best = &x;
+			}
+			if (best != nullptr)
+				fprintf(out, "# %s within %.3f LSB: %s (max err %.3f, %.2f ns/call, %zu table bytes)\n",
+					fn, budget, best->name.c_str(), best->max_err, best->ns_per_call, best->table_bytes);
+			else
+				fprintf(out, "# %s within %.3f LSB: no variant\n", fn, budget);
+		}
+	}
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,176 @@
+/*
+	Syscall-count and latency comparison of the per-motor blocking path
+	(send + setsockopt(SO_RCVTIMEO) + recv per motor, as tx_blocking/rx_blocking do)
+	against UdpBatchTransport (one sendmmsg, poll + recvmmsg to drain).
+
+	Runs entirely on loopback against an in-process echo responder per "motor".
+
+	usage: udp_batch_bench [num_motors] [cycles]
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define TINYCSOCKET_IMPLEMENTATION
+#include "tinycsocket.h"
+
+#include "udp_batch.h"
+
+static const uint16_t BASE_PORT = 54000;
+static const int FRAME_LEN = 20;	//typical COBS-encoded read request/reply size
+
+static std::atomic<bool> g_running(true);
+
+static void echo_responders(int n)
+{
+	std::vector<pollfd> pfds(n);
+	for (int i = 0; i < n; i++)
+	{
+		int fd = socket(AF_INET, SOCK_DGRAM, 0);
+		sockaddr_in a;
+		memset(&a, 0, sizeof(a));
+		a.sin_family = AF_INET;
+		a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		a.sin_port = htons(BASE_PORT + i);
+		bind(fd, (sockaddr*)&a, sizeof(a));
+		pfds[i].fd = fd;
+		pfds[i].events = POLLIN;
+	}
+	unsigned char buf[64];
+	while (g_running.load())
+	{
+		if (poll(pfds.data(), n, 10) <= 0)
+			continue;
+		for (int i = 0; i < n; i++)
+		{
+			if (!(pfds[i].revents & POLLIN))
+				continue;
+			sockaddr_in src;
+			socklen_t sl = sizeof(src);
+			ssize_t r = recvfrom(pfds[i].fd, buf, sizeof(buf), 0, (sockaddr*)&src, &sl);
+			if (r > 0)
+				sendto(pfds[i].fd, buf, r, 0, (sockaddr*)&src, sl);
+		}
+	}
+	for (int i = 0; i < n; i++)
+		close(pfds[i].fd);
+}
+
+static void report(const char* name, std::vector<double>& us, double syscalls_per_cycle)
+{
+	std::sort(us.begin(), us.end());
+	size_t n = us.size();
+	double sum = 0;
+	for (double v : us)
+		sum += v;
+	printf("%-10s mean %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us  syscalls/cycle %5.1f\n",
+		name, sum / n, us[n / 2], us[(n * 99) / 100], us[n - 1], syscalls_per_cycle);
+}
+
+int main(int argc, char* argv[])
+{
+	int num_motors = argc > 1 ? atoi(argv[1]) : 2;
+	int cycles = argc > 2 ? atoi(argv[2]) : 5000;
+	if (num_motors < 1 || num_motors > UDP_BATCH_MAX_PEERS || cycles < 1)
+	{
+		printf("usage: %s [num_motors 1..%d] [cycles]\n", argv[0], UDP_BATCH_MAX_PEERS);
+		return -1;
+	}
+
+	std::thread echo(echo_responders, num_motors);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+	unsigned char frame[FRAME_LEN];
+	for (int i = 0; i < FRAME_LEN; i++)
+		frame[i] = (unsigned char)(i + 1);	//no zero bytes, like a COBS payload
+
+	// --- per-motor blocking path ---
+	std::vector<int> fds(num_motors);
+	for (int i = 0; i < num_motors; i++)
+	{
+		fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		sockaddr_in a;
+		memset(&a, 0, sizeof(a));
+		a.sin_family = AF_INET;
+		a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		a.sin_port = htons(BASE_PORT + i);
+		connect(fds[i], (sockaddr*)&a, sizeof(a));
+	}
+	std::vector<double> serial_us;
+	serial_us.reserve(cycles);
+	uint64_t serial_syscalls = 0;
+	int serial_lost = 0;
+	for (int c = 0; c < cycles; c++)
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < num_motors; i++)
+		{
+			unsigned char rx[64];
+			send(fds[i], frame, FRAME_LEN, 0);
+			timeval tv = {0, 10000};
+			setsockopt(fds[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+			if (recv(fds[i], rx, sizeof(rx), 0) <= 0)
+				serial_lost++;
+			serial_syscalls += 3;
+		}
+		serial_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+	}
+	for (int i = 0; i < num_motors; i++)
+		close(fds[i]);
+
+	// --- batched path ---
+	UdpBatchTransport batch;
+	if (!batch.open())
+	{
+		g_running.store(false);
+		echo.join();
+		return -1;
+	}
+	std::vector<UdpState> states(num_motors);
+	std::vector<UdpState*> ptrs(num_motors);
+	for (int i = 0; i < num_motors; i++)
+	{
+		memset(&states[i], 0, sizeof(UdpState));
+		snprintf(states[i].ip, sizeof(states[i].ip), "127.0.0.1");
+		states[i].port = (uint16_t)(BASE_PORT + i);
+		states[i].connected = true;
+		ptrs[i] = &states[i];
+	}
+	std::vector<double> batch_us;
+	batch_us.reserve(cycles);
+	int batch_lost = 0;
+	for (int c = 0; c < cycles; c++)
+	{
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < num_motors; i++)
+		{
+			memcpy(states[i].tx_cobs_mem, frame, FRAME_LEN);
+			states[i].tx_staged_len = FRAME_LEN;
+			states[i].awaiting_reply = true;
+		}
+		batch.send(ptrs.data(), num_motors);
+		int got = batch.gather(ptrs.data(), num_motors, 10);
+		batch_lost += num_motors - got;
+		batch_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+	}
+
+	g_running.store(false);
+	echo.join();
+
+	printf("%d motors, %d cycles, loopback echo\n", num_motors, cycles);
+	report("per-motor", serial_us, (double)serial_syscalls / cycles);
+	report("batched", batch_us, (double)batch.stats.syscalls / cycles);
+	printf("lost: per-motor %d, batched %d\n", serial_lost, batch_lost);
+	return 0;
+}
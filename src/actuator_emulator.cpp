@@ -0,0 +1,372 @@
+#include "actuator_emulator.h"
+#include "cobs.h"
+#include "dartt.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static constexpr double TICKS_PER_RAD = (double)(1 << 14);	//theta_rem_m scale
+static constexpr double DTHETA_SCALE = 16.0;	//dtheta_fixedpoint_rad_p_sec = rad/s * 16
+
+ActuatorEmulator::ActuatorEmulator()
+	: link()
+	, plant()
+	, motors()
+	, pending()
+	, pool(nullptr)
+	, events()
+	, thread()
+	, running(false)
+	, rng(1)
+	, t0_us(0)
+	, sim_us(0)
+	, stat_requests(0)
+	, stat_replies(0)
+	, stat_dropped(0)
+{
+	link.latency_us = 0;
+	link.jitter_us = 0;
+	link.loss = 0.f;
+	link.reorder = 0.f;
+
+	plant.inertia = 1e-3;
+	plant.damping = 2e-3;
+	plant.torque_per_count = 1e-4;
+	plant.iq_tau_s = 1e-3;
+	plant.line_stiffness = 0.0;
+	plant.step_s = 1e-4;
+}
+
+ActuatorEmulator::~ActuatorEmulator()
+{
+	stop();
+	for (int i = 0; i < (int)motors.size(); i++)
+	{
+		if (motors[i].socket != TCS_SOCKET_INVALID)
+		{
+			tcs_close(&motors[i].socket);
+		}
+	}
+	if (pool != nullptr)
+	{
+		tcs_pool_destroy(&pool);
+	}
+}
+
+bool ActuatorEmulator::add_motor(unsigned char addr, const char* bind_ip, uint16_t port)
+{
+	if (running.load())
+	{
+		return false;
+	}
+	if (pool == nullptr && tcs_pool_create(&pool) != TCS_SUCCESS)
+	{
+		pool = nullptr;
+		printf("Emulator: failed to create socket pool\n");
+		return false;
+	}
+
+	EmulatedMotor m;
+	memset(&m.mem, 0, sizeof(m.mem));
+	m.address = addr;
+	m.socket = TCS_SOCKET_INVALID;
+	m.theta_frac = 0.0;
+	m.omega = 0.0;
+	m.iq = 0.0;
+	TcsResult res = tcs_udp_receiver_str(&m.socket, bind_ip, port);
+	if (res != TCS_SUCCESS)
+	{
+		printf("Emulator: failed to bind %s:%u (%d)\n", bind_ip, port, res);
+		return false;
+	}
+	motors.push_back(m);
+	int idx = (int)motors.size() - 1;
+	tcs_pool_add(pool, m.socket, (void*)(intptr_t)idx, true, false, false);
+	events.resize(motors.size());
+	printf("Emulator: motor 0x%02X listening on %s:%u\n", addr, bind_ip, port);
+	return true;
+}
+
+void ActuatorEmulator::seed(uint32_t s)
+{
+	rng.seed(s);
+}
+
+int64_t ActuatorEmulator::now_us(void) const
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - t0_us;
+}
+
+bool ActuatorEmulator::start(void)
+{
+	if (running.load())
+	{
+		return true;
+	}
+	if (motors.empty())
+	{
+		return false;
+	}
+	t0_us = 0;	//poll() restarts the clock
+	running.store(true);
+	thread = std::thread(&ActuatorEmulator::run, this);
+	return true;
+}
+
+void ActuatorEmulator::stop(void)
+{
+	running.store(false);
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+void ActuatorEmulator::run(void)
+{
+	while (running.load(std::memory_order_relaxed))
+	{
+		poll(1000);
+	}
+}
+
+/*
+	One fixed plant step. Each spool: first-order current loop tracking command_word,
+	torque into inertia with viscous damping. With line_stiffness set, motors 0 and 1
+	are the two ends of one line - paying out one side must be taken up by the other.
+*/
+void ActuatorEmulator::step_plant(double dt)
+{
+	double line_torque = 0.0;
+	if (plant.line_stiffness > 0.0 && motors.size() >= 2)
+	{
+		double th0 = ((double)motors[0].mem.unwrap_state.unwrapped_angle + motors[0].theta_frac) / TICKS_PER_RAD;
+		double th1 = ((double)motors[1].mem.unwrap_state.unwrapped_angle + motors[1].theta_frac) / TICKS_PER_RAD;
+		line_torque = plant.line_stiffness * (th0 + th1);
+	}
+
+	for (int i = 0; i < (int)motors.size(); i++)
+	{
+		EmulatedMotor& m = motors[i];
+		m.iq += ((double)m.mem.command_word - m.iq) * (dt / plant.iq_tau_s);
+		double torque = plant.torque_per_count * m.iq - plant.damping * m.omega;
+		if (i < 2)
+		{
+			torque -= line_torque;
+		}
+		m.omega += (torque / plant.inertia) * dt;
+
+		m.theta_frac += m.omega * dt * TICKS_PER_RAD;
+		double whole = std::trunc(m.theta_frac);
+		m.theta_frac -= whole;
+		m.mem.unwrap_state.unwrapped_angle += (int32_t)whole;	//host writes here to rezero, so integrate in place
+
+		m.mem.theta_rem_m = m.mem.unwrap_state.unwrapped_angle;
+		m.mem.iq = (int32_t)m.iq;
+		m.mem.dtheta_fixedpoint_rad_p_sec = (int32_t)(m.omega * DTHETA_SCALE);
+	}
+}
+
+void ActuatorEmulator::advance_plant(int64_t to_us)
+{
+	int64_t step_us = (int64_t)(plant.step_s * 1e6);
+	if (step_us < 1)
+	{
+		step_us = 1;
+	}
+	while (sim_us + step_us <= to_us)
+	{
+		step_plant((double)step_us * 1e-6);
+		sim_us += step_us;
+	}
+	for (int i = 0; i < (int)motors.size(); i++)
+	{
+		motors[i].mem.tick = (uint32_t)(sim_us / 1000);
+	}
+}
+
+void ActuatorEmulator::queue_reply(int m, const unsigned char* buf, size_t len, const struct TcsAddress* dest)
+{
+	std::uniform_real_distribution<float> u01(0.f, 1.f);
+	int64_t delay = link.latency_us;
+	if (link.jitter_us > 0)
+	{
+		delay += std::uniform_int_distribution<uint32_t>(0, link.jitter_us)(rng);
+	}
+	if (link.reorder > 0.f && u01(rng) < link.reorder)
+	{
+		delay += 2 * ((int64_t)link.latency_us + link.jitter_us) + 1000;	//let the next reply overtake this one
+	}
+
+	for (int i = 0; i < EMULATOR_MAX_PENDING; i++)
+	{
+		if (!pending[i].used)
+		{
+			PendingReply& p = pending[i];
+			p.used = true;
+			p.motor = m;
+			p.due_us = now_us() + delay;
+			p.dest = *dest;
+			memcpy(p.buf, buf, len);
+			p.len = len;
+			return;
+		}
+	}
+	stat_dropped++;	//link queue full
+}
+
+void ActuatorEmulator::flush_due(void)
+{
+	int64_t now = now_us();
+	for (int i = 0; i < EMULATOR_MAX_PENDING; i++)
+	{
+		PendingReply& p = pending[i];
+		if (!p.used || p.due_us > now)
+		{
+			continue;
+		}
+		size_t sent = 0;
+		tcs_send_to(motors[p.motor].socket, p.buf, p.len, TCS_FLAG_NONE, &p.dest, &sent);
+		stat_replies++;
+		p.used = false;
+	}
+}
+
+void ActuatorEmulator::handle_frame(int m, unsigned char* frame, size_t len, const struct TcsAddress* src)
+{
+	EmulatedMotor& mot = motors[m];
+
+	unsigned char dec_mem[EMULATOR_FRAME_SIZE];
+	cobs_buf_t cb_enc = {
+		.buf = frame,
+		.size = len,
+		.length = len
+	};
+	cobs_buf_t cb_dec = {
+		.buf = dec_mem,
+		.size = sizeof(dec_mem),
+		.length = 0
+	};
+	if (cobs_decode_double_buffer(&cb_enc, &cb_dec) != COBS_SUCCESS)
+	{
+		return;
+	}
+
+	//same parse the firmware runs on its serial port
+	dartt_buffer_t rx = {
+		.buf = dec_mem,
+		.size = sizeof(dec_mem),
+		.len = cb_dec.length
+	};
+	payload_layer_msg_t pld;
+	if (dartt_frame_to_payload(&rx, TYPE_SERIAL_MESSAGE, PAYLOAD_ALIAS, &pld) != DARTT_PROTOCOL_SUCCESS)
+	{
+		return;
+	}
+	if (pld.address != mot.address)
+	{
+		return;
+	}
+	unsigned char reply_mem[EMULATOR_FRAME_SIZE];
+	dartt_buffer_t reply = {
+		.buf = reply_mem,
+		.size = sizeof(reply_mem) - 2,	//leave room for COBS, as on the host side
+		.len = 0
+	};
+	int rc = dartt_parse_general_message(&pld, TYPE_SERIAL_MESSAGE, (unsigned char*)&mot.mem, sizeof(mot.mem), &reply);
+	if (rc != DARTT_PROTOCOL_SUCCESS || reply.len == 0)
+	{
+		return;	//writes are not acknowledged
+	}
+
+	cobs_buf_t cb_reply = {
+		.buf = reply.buf,
+		.size = sizeof(reply_mem),
+		.length = reply.len,
+		.encoded_state = COBS_DECODED
+	};
+	if (cobs_encode_single_buffer(&cb_reply) != 0)
+	{
+		return;
+	}
+	queue_reply(m, cb_reply.buf, cb_reply.length, src);
+}
+
+/*
+	A datagram may carry several COBS frames back to back (see SpoolerRobot::exchange),
+	each terminated by a zero byte. Handle them in order.
+*/
+void ActuatorEmulator::handle_datagram(int m, const unsigned char* data, size_t len, const struct TcsAddress* src)
+{
+	stat_requests++;
+	if (link.loss > 0.f && std::uniform_real_distribution<float>(0.f, 1.f)(rng) < link.loss)
+	{
+		stat_dropped++;
+		return;
+	}
+
+	unsigned char frame[EMULATOR_FRAME_SIZE];
+	size_t start = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		if (data[i] != 0)
+		{
+			continue;
+		}
+		size_t flen = i + 1 - start;
+		if (flen > 1 && flen <= sizeof(frame))
+		{
+			memcpy(frame, data + start, flen);
+			handle_frame(m, frame, flen, src);
+		}
+		start = i + 1;
+	}
+}
+
+void ActuatorEmulator::poll(uint32_t timeout_us)
+{
+	if (t0_us == 0)
+	{
+		t0_us = now_us();
+		sim_us = 0;
+	}
+
+	//don't sleep past the next due reply; sub-millisecond waits spin
+	int64_t now = now_us();
+	int64_t wait_us = timeout_us;
+	for (int i = 0; i < EMULATOR_MAX_PENDING; i++)
+	{
+		if (pending[i].used && pending[i].due_us - now < wait_us)
+		{
+			wait_us = pending[i].due_us - now;
+		}
+	}
+	int64_t wait_ms = wait_us > 0 ? wait_us / 1000 : 0;
+
+	size_t populated = 0;
+	if (pool != nullptr)
+	{
+		tcs_pool_poll(pool, events.data(), events.size(), &populated, wait_ms);
+	}
+
+	advance_plant(now_us());
+
+	for (size_t e = 0; e < populated; e++)
+	{
+		if (!events[e].can_read)
+		{
+			continue;
+		}
+		int m = (int)(intptr_t)events[e].user_data;
+		unsigned char buf[EMULATOR_FRAME_SIZE * 2];
+		struct TcsAddress src = TCS_ADDRESS_NONE;
+		size_t received = 0;
+		if (tcs_receive_from(motors[m].socket, buf, sizeof(buf), TCS_FLAG_NONE, &src, &received) == TCS_SUCCESS && received > 0)
+		{
+			handle_datagram(m, buf, received, &src);
+		}
+	}
+
+	flush_due();
+}
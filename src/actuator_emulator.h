@@ -0,0 +1,120 @@
+#ifndef ACTUATOR_EMULATOR_H
+#define ACTUATOR_EMULATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+#include "dartt_mctl_params.h"
+#include "tinycsocket.h"
+
+/*
+	Local stand-in for the ESP32 bridges + actuators. Each emulated motor binds a UDP port,
+	decodes COBS-framed DARTT requests against its own dartt_mctl_params_t image exactly
+	like the firmware does, and replies from the same port. A small plant model moves
+	theta_rem_m / iq / dtheta_fixedpoint_rad_p_sec in response to command_word.
+
+	Replies pass through an impaired link (latency, jitter, loss, reordering) before they
+	are sent, so the comms stack can be exercised under WiFi-like conditions on loopback.
+
+	Runs on its own thread: either in-process (start/stop) or from the spooler_emulator executable.
+*/
+
+#define EMULATOR_MAX_PENDING 256	//replies in flight on the emulated link
+#define EMULATOR_FRAME_SIZE 64
+
+struct EmulatorLinkConfig
+{
+	uint32_t latency_us;	//one-way delay added to every reply
+	uint32_t jitter_us;	//uniform extra delay, 0..jitter_us
+	float loss;	//probability a request is dropped, 0..1
+	float reorder;	//probability a reply is held back behind the next one, 0..1
+};
+
+struct EmulatorPlantConfig
+{
+	double inertia;	//spool + rotor inertia, kg m^2
+	double damping;	//viscous friction, N m s/rad
+	double torque_per_count;	//N m per command_word count
+	double iq_tau_s;	//current loop time constant
+	double line_stiffness;	//N m/rad coupling motors 0 and 1 as the two ends of one line, 0 for independent spools
+	double step_s;	//fixed integration step
+};
+
+class ActuatorEmulator
+{
+public:
+	EmulatorLinkConfig link;
+	EmulatorPlantConfig plant;
+
+	ActuatorEmulator();
+	~ActuatorEmulator();
+
+	ActuatorEmulator(const ActuatorEmulator&) = delete;
+	ActuatorEmulator& operator=(const ActuatorEmulator&) = delete;
+
+	// Bind an emulated motor with DARTT address addr on bind_ip:port. Call before start.
+	bool add_motor(unsigned char addr, const char* bind_ip, uint16_t port);
+
+	void seed(uint32_t s);
+	bool start(void);
+	void stop(void);
+
+	// Service sockets, advance the plant and release due replies, waiting at most timeout_us.
+	// start() calls this in a loop; call it directly to run the emulator on your own thread.
+	void poll(uint32_t timeout_us);
+
+	uint64_t requests_received(void) const { return stat_requests; }
+	uint64_t replies_sent(void) const { return stat_replies; }
+	uint64_t requests_dropped(void) const { return stat_dropped; }
+
+private:
+	struct EmulatedMotor
+	{
+		unsigned char address;
+		dartt_mctl_params_t mem;	//register image served over DARTT
+		TcsSocket socket;
+
+		double theta_frac;	//sub-tick angle not yet folded into unwrapped_angle, ticks
+		double omega;	//rad/s
+		double iq;	//command_word units
+	};
+
+	struct PendingReply
+	{
+		bool used;
+		int motor;
+		int64_t due_us;
+		struct TcsAddress dest;
+		unsigned char buf[EMULATOR_FRAME_SIZE];
+		size_t len;
+	};
+
+	std::vector<EmulatedMotor> motors;
+	PendingReply pending[EMULATOR_MAX_PENDING];
+	struct TcsPool* pool;
+	std::vector<TcsPollEvent> events;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	std::mt19937 rng;
+
+	int64_t t0_us;	//wall clock origin
+	int64_t sim_us;	//plant time, advanced in fixed steps
+
+	uint64_t stat_requests;
+	uint64_t stat_replies;
+	uint64_t stat_dropped;
+
+	int64_t now_us(void) const;
+	void run(void);
+	void step_plant(double dt);
+	void advance_plant(int64_t to_us);
+	void handle_datagram(int m, const unsigned char* data, size_t len, const struct TcsAddress* src);
+	void handle_frame(int m, unsigned char* frame, size_t len, const struct TcsAddress* src);
+	void queue_reply(int m, const unsigned char* buf, size_t len, const struct TcsAddress* dest);
+	void flush_due(void);
+};
+
+#endif // ACTUATOR_EMULATOR_H
@@ -0,0 +1,223 @@
+#ifndef CABLE_SIM_H
+#define CABLE_SIM_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <Eigen/Dense>
+#include "dartt_mctl_params.h"
+#include "pctl_emu.h"
+
+/*
+	Plant model standing in for the actuators and the robot they drive, so SpoolerRobot and
+	the controller can run with no hardware (SpoolerRobot::sim, main --sim, spooler_sim).
+
+	N spools wind cables that meet at one point mass in the vertical plane. Each spool is a
+	first-order current loop into rotor + spool inertia with viscous friction; each cable is
+	a spring-damper that can only pull; the mass hangs under gravity. The plant is driven
+	and read through one dartt_mctl_params_t register image per spool, like the firmware:
+		in:  command_word (iq target, or a theta_rem_m target in PCTL_IQ mode, run through
+		     mctl_iq with pctl_step), control_mode, mctl_iq
+		out: theta_rem_m / unwrap_state.unwrapped_angle (14 bit ticks), iq (command units),
+		     dtheta_fixedpoint_rad_p_sec (rad/s * 16), tick (ms)
+	Positive command winds the spool in. Integration is semi-implicit Euler at a fixed step
+	with no wall clock and no randomness, so the same commands give the same telemetry bit
+	for bit, and advance() runs as fast as the host allows.
+*/
+
+// What SpoolerRobot needs from a simulator, independent of the spool count
+class RobotSim
+{
+public:
+	virtual ~RobotSim() = default;
+
+	virtual int num_spools(void) const = 0;
+	// Register image of spool i: write command_word (and mode/gains) here, read telemetry back
+	virtual dartt_mctl_params_t& regs(int i) = 0;
+	// Advance by dt in whole fixed steps; the remainder carries into the next call
+	virtual void advance(double dt) = 0;
+	// As Motor::write_zero_offset: theta_rem_m reads 0 at the current angle
+	virtual void zero(int i) = 0;
+	virtual double time_s(void) const = 0;
+	virtual Eigen::Vector2d mass_position(void) const = 0;
+};
+
+template <int N>
+struct CableSimConfig
+{
+	Eigen::Matrix<double, 2, N> anchor;	//cable exit point of each spool, m
+	Eigen::Vector2d mass_start;	//mass position at t = 0; every cable starts just taut
+	double mass;	//kg
+	double gravity;	//m/s^2, along -y
+	double mass_damping;	//N s/m, air drag and sway losses
+	double cable_stiffness;	//N/m, each cable
+	double cable_damping;	//N s/m, along each cable
+	double spool_radius;	//m
+	double inertia;	//spool + rotor, kg m^2
+	double damping;	//spool viscous friction, N m s/rad
+	double torque_per_count;	//N m per iq count
+	double iq_tau_s;	//current loop time constant
+	double step_s;	//fixed integration step
+};
+
+/*
+	Spools evenly spaced along y = 0 over span metres, mass starting 0.3 m from the first
+	spool and 0.2 m below the line. With N = 2 this is the two-spool line main.cpp drives,
+	scaled so the controller's 100..600 count tensions hold the mass up with a little sag.
+*/
+template <int N>
+CableSimConfig<N> cable_sim_default_config(double span = 4.2)
+{
+	static_assert(N >= 2, "at least two cables");
+	CableSimConfig<N> c;
+	for (int i = 0; i < N; i++)
+	{
+		c.anchor(0, i) = span * (double)i / (double)(N - 1);
+		c.anchor(1, i) = 0.0;
+	}
+	c.mass_start = Eigen::Vector2d(0.3, -0.2);
+	c.mass = 0.2;
+	c.gravity = 9.81;
+	c.mass_damping = 0.5;
+	c.cable_stiffness = 5000.0;
+	c.cable_damping = 5.0;
+	c.spool_radius = 0.01;
+	c.inertia = 2e-5;
+	c.damping = 1e-4;
+	c.torque_per_count = 1e-3;
+	c.iq_tau_s = 0.5e-3;
+	c.step_s = 1e-4;
+	return c;
+}
+
+template <int N>
+class CableSim : public RobotSim
+{
+public:
+	typedef Eigen::Matrix<double, N, 1> VecN;
+	typedef Eigen::Matrix<double, 2, N> Mat2N;
+
+	static constexpr double TICKS_PER_RAD = (double)(1 << 14);	//theta_rem_m scale
+	static constexpr double DTHETA_SCALE = 16.0;	//dtheta_fixedpoint_rad_p_sec = rad/s * 16
+
+	CableSimConfig<N> cfg;
+
+	// Spool state, rad and rad/s (winding in is positive), and the iq each spool is delivering
+	VecN theta;
+	VecN omega;
+	VecN iq;
+	VecN tension;	//N, from the last step
+	Eigen::Vector2d pos;
+	Eigen::Vector2d vel;
+
+	explicit CableSim(const CableSimConfig<N>& c = cable_sim_default_config<N>())
+	{
+		reset(c);
+	}
+
+	// Back to t = 0 with a new configuration; register images are cleared
+	void reset(const CableSimConfig<N>& c)
+	{
+		cfg = c;
+		theta.setZero();
+		omega.setZero();
+		iq.setZero();
+		tension.setZero();
+		pos = cfg.mass_start;
+		vel.setZero();
+		rest_len = (cfg.anchor.colwise() - pos).colwise().norm().transpose();
+		zero_ticks.setZero();
+		steps = 0;
+		carry_s = 0.0;
+		memset(mem, 0, sizeof(mem));
+	}
+
+	int num_spools(void) const override { return N; }
+	dartt_mctl_params_t& regs(int i) override { return mem[i]; }
+	double time_s(void) const override { return (double)steps * cfg.step_s; }
+	Eigen::Vector2d mass_position(void) const override { return pos; }
+
+	void zero(int i) override
+	{
+		zero_ticks[i] += (int64_t)mem[i].theta_rem_m;
+		publish();
+	}
+
+	void advance(double dt) override
+	{
+		carry_s += dt;
+		while (carry_s >= cfg.step_s * (1.0 - 1e-9))	//so 1 ms is always 10 steps of 0.1 ms, despite rounding
+		{
+			step();
+			carry_s -= cfg.step_s;
+		}
+	}
+
+	// One fixed step, then the register images are refreshed
+	void step(void)
+	{
+		const double h = cfg.step_s;
+		const double r = cfg.spool_radius;
+
+		//cables: stretch beyond the free length (rest length minus what the spool has wound in)
+		Mat2N d = cfg.anchor.colwise() - pos;
+		VecN dist = d.colwise().norm().transpose();
+		Mat2N u = (d.array().rowwise() / dist.transpose().array()).matrix();	//unit vectors, mass -> anchor
+		VecN stretch = dist - (rest_len - r * theta);
+		VecN stretch_rate = r * omega - u.transpose() * vel;
+		VecN pull = cfg.cable_stiffness * stretch + cfg.cable_damping * stretch_rate;
+		tension = (stretch.array() > 0.0).select(pull.array().max(0.0), 0.0).matrix();	//slack cables and dampers do not push
+
+		//spools: the device's current loop, then torque into inertia
+		VecN target;
+		for (int i = 0; i < N; i++)
+		{
+			target[i] = (double)iq_target(mem[i]);
+		}
+		iq += (target - iq) * (h / cfg.iq_tau_s);
+		VecN torque = cfg.torque_per_count * iq - r * tension - cfg.damping * omega;
+		omega += torque * (h / cfg.inertia);
+		theta += omega * h;
+
+		//mass
+		Eigen::Vector2d force = u * tension - cfg.mass_damping * vel;
+		force.y() -= cfg.mass * cfg.gravity;
+		vel += force * (h / cfg.mass);
+		pos += vel * h;
+
+		steps++;
+		publish();
+	}
+
+private:
+	VecN rest_len;	//cable length at theta = 0
+	Eigen::Matrix<int64_t, N, 1> zero_ticks;
+	int64_t steps;
+	double carry_s;
+	dartt_mctl_params_t mem[N];
+
+	// FOC_MODE: command_word is the iq target. PCTL_IQ: a position target through the device's PI/PD.
+	static int32_t iq_target(dartt_mctl_params_t& m)
+	{
+		if (m.control_mode == PCTL_IQ)
+		{
+			return pctl_step(&m.mctl_iq, m.command_word - m.theta_rem_m, m.dtheta_fixedpoint_rad_p_sec);
+		}
+		return m.command_word;
+	}
+
+	void publish(void)
+	{
+		for (int i = 0; i < N; i++)
+		{
+			int64_t ticks = (int64_t)std::floor(theta[i] * TICKS_PER_RAD) - zero_ticks[i];
+			mem[i].theta_rem_m = (int32_t)ticks;
+			mem[i].unwrap_state.unwrapped_angle = (int32_t)ticks;
+			mem[i].iq = (int32_t)iq[i];
+			mem[i].dtheta_fixedpoint_rad_p_sec = (int32_t)(omega[i] * DTHETA_SCALE);
+			mem[i].tick = (uint32_t)(((double)steps * cfg.step_s) * 1000.0);
+		}
+	}
+};
+
+#endif // CABLE_SIM_H
@@ -0,0 +1,213 @@
+#include "comms_stats.h"
+#include <cstring>
+#include <bit>
+
+void LatencyHistogram::clear(void)
+{
+	memset(counts, 0, sizeof(counts));
+	total = 0;
+	sum_us = 0;
+	min_us = UINT32_MAX;
+	max_us = 0;
+}
+
+/*
+	Values below 8us get a bucket each. Above that, each power of two is split into
+	LATENCY_SUB_BUCKETS linear steps using the 3 bits below the leading one.
+*/
+int LatencyHistogram::bucket_of(uint32_t us)
+{
+	if (us < LATENCY_SUB_BUCKETS)
+	{
+		return (int)us;
+	}
+	int octave = std::bit_width(us) - 1;	//>= 3
+	int sub = (int)((us >> (octave - 3)) & (LATENCY_SUB_BUCKETS - 1));
+	int b = (octave - 2) * LATENCY_SUB_BUCKETS + sub;
+	if (b >= LATENCY_BUCKETS)
+	{
+		b = LATENCY_BUCKETS - 1;
+	}
+	return b;
+}
+
+uint32_t LatencyHistogram::bucket_upper_us(int b)
+{
+	if (b < LATENCY_SUB_BUCKETS)
+	{
+		return (uint32_t)b;
+	}
+	int octave = b / LATENCY_SUB_BUCKETS + 2;
+	int sub = b % LATENCY_SUB_BUCKETS;
+	uint32_t lower = (uint32_t)(LATENCY_SUB_BUCKETS + sub) << (octave - 3);
+	return lower + (1u << (octave - 3)) - 1;
+}
+
+void LatencyHistogram::record(uint32_t us)
+{
+	counts[bucket_of(us)]++;
+	total++;
+	sum_us += us;
+	if (us < min_us)
+	{
+		min_us = us;
+	}
+	if (us > max_us)
+	{
+		max_us = us;
+	}
+}
+
+uint32_t LatencyHistogram::percentile(double p) const
+{
+	if (total == 0)
+	{
+		return 0;
+	}
+	uint64_t rank = (uint64_t)(p * (double)total);
+	if (rank >= total)
+	{
+		rank = total - 1;
+	}
+	uint64_t cum = 0;
+	for (int b = 0; b < LATENCY_BUCKETS; b++)
+	{
+		cum += counts[b];
+		if (cum > rank)
+		{
+			uint32_t upper = bucket_upper_us(b);
+			return upper < max_us ? upper : max_us;
+		}
+	}
+	return max_us;
+}
+
+double LatencyHistogram::mean(void) const
+{
+	if (total == 0)
+	{
+		return 0.0;
+	}
+	return (double)sum_us / (double)total;
+}
+
+void LatencyHistogram::halve(void)
+{
+	total = 0;
+	for (int b = 0; b < LATENCY_BUCKETS; b++)
+	{
+		counts[b] >>= 1;
+		total += counts[b];
+	}
+	sum_us >>= 1;
+}
+
+void AdaptiveTimeout::init(uint32_t default_timeout_us, uint32_t min_timeout_us, uint32_t max_timeout_us)
+{
+	recent.clear();
+	quantile = 0.99f;
+	margin = 1.5f;
+	min_us = min_timeout_us;
+	max_us = max_timeout_us;
+	default_us = default_timeout_us;
+	min_samples = 200;
+	decay_samples = 2000;
+	since_decay = 0;
+	timeout_us = default_timeout_us;
+}
+
+void AdaptiveTimeout::record(uint32_t rtt_us)
+{
+	recent.record(rtt_us);
+	if (++since_decay >= decay_samples)
+	{
+		recent.halve();
+		since_decay = 0;
+	}
+	if (recent.total < min_samples)
+	{
+		timeout_us = default_us;
+		return;
+	}
+	double t = (double)recent.percentile(quantile) * (double)margin;
+	if (t < (double)min_us)
+	{
+		t = (double)min_us;
+	}
+	if (t > (double)max_us)
+	{
+		t = (double)max_us;
+	}
+	timeout_us = (uint32_t)t;
+}
+
+uint32_t AdaptiveTimeout::timeout_ms(void) const
+{
+	return (timeout_us + 999) / 1000;
+}
+
+void MotorCommsStats::clear(void)
+{
+	rtt.clear();
+	transactions = 0;
+	timeouts = 0;
+	cobs_failures = 0;
+	short_reads = 0;
+	stale_replies = 0;
+	duplicate_replies = 0;
+	send_failures = 0;
+	write_failures = 0;
+	retries = 0;
+	timeout_us = 0;
+}
+
+void comms_stats_print(FILE* f, const MotorCommsStats* stats, int num_motors)
+{
+	for (int i = 0; i < num_motors; i++)
+	{
+		const MotorCommsStats& s = stats[i];
+		fprintf(f, "motor %d: timeout %u us, %llu tx, rtt p50 %u us p99 %u us p999 %u us max %u us, "
+			"timeouts %llu, cobs %llu, short %llu, stale %llu, dup %llu, send fail %llu, write fail %llu, retries %llu\n",
+			i, s.timeout_us, (unsigned long long)s.transactions,
+			s.rtt.percentile(0.5), s.rtt.percentile(0.99), s.rtt.percentile(0.999), s.rtt.max_us,
+			(unsigned long long)s.timeouts, (unsigned long long)s.cobs_failures,
+			(unsigned long long)s.short_reads, (unsigned long long)s.stale_replies,
+			(unsigned long long)s.duplicate_replies, (unsigned long long)s.send_failures,
+			(unsigned long long)s.write_failures, (unsigned long long)s.retries);
+	}
+}
+
+bool comms_stats_dump_csv(const char* path, const MotorCommsStats* stats, int num_motors)
+{
+	FILE* f = fopen(path, "w");
+	if (f == NULL)
+	{
+		printf("Failed to open %s for writing\n", path);
+		return false;
+	}
+	fprintf(f, "motor,timeout_us,transactions,timeouts,cobs_failures,short_reads,stale_replies,duplicate_replies,send_failures,write_failures,retries,rtt_p50_us,rtt_p99_us,rtt_p999_us,rtt_max_us\n");
+	for (int i = 0; i < num_motors; i++)
+	{
+		const MotorCommsStats& s = stats[i];
+		fprintf(f, "%d,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%u,%u,%u,%u\n", i, s.timeout_us,
+			(unsigned long long)s.transactions, (unsigned long long)s.timeouts,
+			(unsigned long long)s.cobs_failures, (unsigned long long)s.short_reads,
+			(unsigned long long)s.stale_replies, (unsigned long long)s.duplicate_replies,
+			(unsigned long long)s.send_failures, (unsigned long long)s.write_failures,
+			(unsigned long long)s.retries,
+			s.rtt.percentile(0.5), s.rtt.percentile(0.99), s.rtt.percentile(0.999), s.rtt.max_us);
+	}
+	fprintf(f, "\nmotor,bucket_upper_us,count\n");
+	for (int i = 0; i < num_motors; i++)
+	{
+		for (int b = 0; b < LATENCY_BUCKETS; b++)
+		{
+			if (stats[i].rtt.counts[b] != 0)
+			{
+				fprintf(f, "%d,%u,%llu\n", i, LatencyHistogram::bucket_upper_us(b), (unsigned long long)stats[i].rtt.counts[b]);
+			}
+		}
+	}
+	fclose(f);
+	return true;
+}
@@ -0,0 +1,86 @@
+#ifndef COMMS_STATS_H
+#define COMMS_STATS_H
+
+#include <cstdint>
+#include <cstdio>
+
+/*
+	Log-linear latency histogram: 8 sub-buckets per power of two from 1us up to
+	2^(LATENCY_OCTAVES + 2) us (~67 s; anything longer is counted in the top bucket),
+	so relative resolution is ~12% everywhere. Fixed storage, no allocation, O(1) record.
+*/
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_OCTAVES 24
+#define LATENCY_BUCKETS (LATENCY_SUB_BUCKETS * LATENCY_OCTAVES)
+
+struct LatencyHistogram
+{
+	uint64_t counts[LATENCY_BUCKETS];
+	uint64_t total;
+	uint64_t sum_us;
+	uint32_t min_us;
+	uint32_t max_us;
+
+	void clear(void);
+	void record(uint32_t us);
+	uint32_t percentile(double p) const;	//p in 0..1, returns the bucket upper bound in us
+	double mean(void) const;
+	void halve(void);	//age the distribution: halve every count, keep min/max
+
+	static int bucket_of(uint32_t us);
+	static uint32_t bucket_upper_us(int b);
+};
+
+/*
+	Per-motor transaction accounting for the cycle path (SpoolerRobot::read/exchange).
+*/
+struct MotorCommsStats
+{
+	LatencyHistogram rtt;	//request sent -> reply received
+	uint64_t transactions;	//requests sent
+	uint64_t timeouts;	//no reply before the cycle deadline
+	uint64_t cobs_failures;	//reply arrived but failed COBS decode
+	uint64_t short_reads;	//reply decoded but dartt rejected it (short, bad CRC, wrong address)
+	uint64_t stale_replies;	//late replies to an earlier request, drained and dropped
+	uint64_t duplicate_replies;	//replies with no request outstanding, drained and dropped
+	uint64_t send_failures;	//request could not be sent
+	uint64_t write_failures;	//blocking command writes (SpoolerRobot::write) that failed
+	uint64_t retries;	//extra attempts made by retrying callers (zeroing during calibration)
+	uint32_t timeout_us;	//reply timeout in force at the last cycle (AdaptiveTimeout)
+
+	void clear(void);
+};
+
+/*
+	Per-motor reply timeout from the recent RTT distribution: quantile of a decaying histogram
+	times margin, clamped to [min_us, max_us]. Late replies that missed their timeout are fed in
+	as well (UdpState::late_rtt_max_us), so the tail a short timeout cuts off still pulls the
+	estimate back up; only those matched to the request they answer count, timed from that
+	request's send to the kernel's receive stamp. Late replies without a stamp (off Linux),
+	lost requests and duplicates never produce a sample and so do not inflate it.
+*/
+struct AdaptiveTimeout
+{
+	LatencyHistogram recent;
+	float quantile;
+	float margin;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t default_us;	//used until min_samples RTTs have been seen
+	uint32_t min_samples;
+	uint32_t decay_samples;	//halve the histogram every this many samples so old conditions age out
+	uint32_t since_decay;
+	uint32_t timeout_us;	//current value
+
+	void init(uint32_t default_timeout_us, uint32_t min_timeout_us, uint32_t max_timeout_us);
+	void record(uint32_t rtt_us);
+	uint32_t timeout_ms(void) const;	//rounded up, for the millisecond-granularity socket timeouts
+};
+
+// Human-readable summary, one line per motor
+void comms_stats_print(FILE* f, const MotorCommsStats* stats, int num_motors);
+
+// Per-motor counters plus every non-empty RTT bucket, as CSV
+bool comms_stats_dump_csv(const char* path, const MotorCommsStats* stats, int num_motors);
+
+#endif // COMMS_STATS_H
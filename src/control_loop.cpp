@@ -0,0 +1,359 @@
+#include "control_loop.h"
+#include "spooler_robot.h"
+#include "dartt_init.h"
+#include "ui.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+typedef std::chrono::steady_clock control_clock;
+
+double thresh_dbl(double in, double hi, double lo)
+{
+	if(in > hi)
+	{
+		return hi;
+	}
+	else if(in < lo)
+	{
+		return lo;
+	}
+	return in;
+}
+
+void compute_tensions(SpoolerRobot& robot, const ControlInput& in, bool comms_good)
+{
+	double t1 = 0, t2 = 0;
+	bool do_pctl = false;
+
+	if (comms_good)
+	{
+		double xpos = in.xpos;
+
+		if(in.mode == FORCE_MODE)
+		{
+			do_pctl = false;
+		}
+		else
+		{
+			do_pctl = true;
+		}
+
+		if(do_pctl)
+		{
+			robot.targ = thresh_dbl(robot.targ, 0, robot.rom_degrees);
+			if(in.mode == PCTL_CURSOR && in.clicked)
+			{
+				robot.targ = ((xpos+1.f)/2.f)*robot.rom_degrees;
+			}
+			float velocity = (robot.dp[0] - robot.dp[1]);
+			float f = robot.k*(robot.targ - robot.p[0]) - robot.kd * velocity;
+			if(robot.use_tension_solver)
+			{
+				//motor 0 pulls +, motor 1 pulls -; infeasible f comes back clamped to the limits
+				Eigen::Matrix<double, 1, 2> A(1.0, -1.0);
+				Eigen::Matrix<double, 1, 1> w(f);
+				Eigen::Vector2d ts;
+				robot.line_tensions.set_limits(100.0, robot.tmax);
+				robot.line_tensions.solve(A, w, ts);
+				t1 = ts[0];
+				t2 = ts[1];
+			}
+			else if(f > 0)
+			{
+				t1 = f;
+				t2 = 100;
+				// t2 = 300 + robot.dp[1];
+			}
+			else if(f < 0)
+			{
+				t2 = -f;
+				t1 = 100;
+				// t1 = 300 + robot.dp[0];
+			}
+			else
+			{
+				t1 = 200;
+				t2 = 200;
+			}
+
+		}
+		else if(in.clicked)
+		{
+			if(xpos >  0.1)
+			{
+				t1 = xpos*robot.tmax;
+				t2 = 100;
+			}
+			else if (xpos < -0.1)
+			{
+				t2 = -xpos*robot.tmax;
+				t1 = 100;
+			}
+			else
+			{
+				t1 = 200;
+				t2 = 200;
+			}
+		}
+		t1 = thresh_dbl(t1, robot.tmax, 100.);
+		t2 = thresh_dbl(t2, robot.tmax, 100.);
+	}
+	robot.t[0] = t1;
+	robot.t[1] = t2;
+}
+
+/*
+	Sleep until shortly before the deadline, then spin the rest. OS sleep granularity
+	is typically 50us-1ms+, which is a large fraction of a kHz period; the spin covers it.
+*/
+static void sleep_until_hybrid(control_clock::time_point deadline, uint32_t spin_us)
+{
+	control_clock::time_point spin_start = deadline - std::chrono::microseconds(spin_us);
+	if (control_clock::now() < spin_start)
+	{
+		std::this_thread::sleep_until(spin_start);
+	}
+	while (control_clock::now() < deadline)
+	{
+		std::this_thread::yield();
+	}
+}
+
+ControlLoop::ControlLoop(SpoolerRobot& r)
+	: rate_hz(1000.f)
+	, spin_us(200)
+	, stats_publish_cycles(100)
+	, fused_exchange(true)
+	, robot(r)
+	, thread()
+	, running(false)
+	, input_buf()
+	, snapshot_buf()
+	, stats_buf()
+	, seen_targ_seq(0)
+	, seen_oscillate_seq(0)
+	, seen_calibrate_seq(0)
+	, seen_stats_reset_seq(0)
+	, seen_reconnect_seq()
+{
+}
+
+ControlLoop::~ControlLoop()
+{
+	stop();
+}
+
+void ControlLoop::init_input(ControlInput& in) const
+{
+	memset(&in, 0, sizeof(in));
+	in.mode = FORCE_MODE;
+	in.k = robot.k;
+	in.kd = robot.kd;
+	in.tmax = robot.tmax;
+	in.targ = robot.targ;
+	for (int i = 0; i < (int)robot.motors.size() && i < MAX_MOTORS; i++)
+	{
+		snprintf(in.ip[i], sizeof(in.ip[i]), "%s", robot.motors[i].socket.ip);
+		in.port[i] = robot.motors[i].socket.port;
+	}
+}
+
+bool ControlLoop::start(void)
+{
+	if (running.load())
+	{
+		return true;
+	}
+	if (robot.motors.size() > MAX_MOTORS || rate_hz <= 0.f)
+	{
+		printf("Control loop: bad configuration (%d motors, %f Hz)\n", (int)robot.motors.size(), rate_hz);
+		return false;
+	}
+
+	//always start from a valid input block, so the first cycle does not command zeros
+	init_input(input_buf.write_slot());
+	input_buf.publish();
+	seen_targ_seq = 0;
+	seen_oscillate_seq = 0;
+	seen_calibrate_seq = 0;
+	seen_stats_reset_seq = 0;
+	memset(seen_reconnect_seq, 0, sizeof(seen_reconnect_seq));
+
+	publish(false, 0.0, 0, 0, 0.f, false);
+	publish_stats();
+	running.store(true);
+	thread = std::thread(&ControlLoop::run, this);
+	return true;
+}
+
+void ControlLoop::stop(void)
+{
+	running.store(false);
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+}
+
+void ControlLoop::submit(const ControlInput& in)
+{
+	input_buf.write_slot() = in;
+	input_buf.publish();
+}
+
+const RobotSnapshot& ControlLoop::latest(void)
+{
+	snapshot_buf.update();
+	return snapshot_buf.read();
+}
+
+const CommsStatsSnapshot& ControlLoop::latest_stats(void)
+{
+	stats_buf.update();
+	return stats_buf.read();
+}
+
+void ControlLoop::apply_input(const ControlInput& in)
+{
+	robot.k = in.k;
+	robot.kd = in.kd;
+	robot.tmax = in.tmax;
+	robot.input_mode = in.mode;
+	robot.input_clicked = in.clicked;
+	robot.input_xpos = in.xpos;
+
+	if (in.targ_seq != seen_targ_seq)
+	{
+		seen_targ_seq = in.targ_seq;
+		robot.targ = in.targ;
+		robot.input_targ_set = true;
+	}
+	if (in.oscillate_toggle_seq != seen_oscillate_seq)
+	{
+		seen_oscillate_seq = in.oscillate_toggle_seq;
+		robot.do_oscillation = !robot.do_oscillation;
+	}
+	for (int i = 0; i < (int)robot.motors.size(); i++)
+	{
+		if (in.reconnect_seq[i] != seen_reconnect_seq[i])
+		{
+			seen_reconnect_seq[i] = in.reconnect_seq[i];
+			UdpState& s = robot.motors[i].socket;
+			snprintf(s.ip, sizeof(s.ip), "%s", in.ip[i]);
+			s.port = in.port[i];
+			udp_connect(&s);
+		}
+	}
+	if (in.stats_reset_seq != seen_stats_reset_seq)
+	{
+		seen_stats_reset_seq = in.stats_reset_seq;
+		for (int i = 0; i < (int)robot.motors.size(); i++)
+		{
+			robot.motors[i].stats.clear();
+		}
+	}
+	if (in.calibrate_seq != seen_calibrate_seq)
+	{
+		seen_calibrate_seq = in.calibrate_seq;
+		publish(false, 0.0, 0, 0, 0.f, true);
+		robot.calibrate();	//blocking, several seconds. The GUI keeps rendering meanwhile
+	}
+}
+
+void ControlLoop::publish_stats(void)
+{
+	CommsStatsSnapshot& s = stats_buf.write_slot();
+	s.num_motors = (int)robot.motors.size();
+	for (int i = 0; i < s.num_motors; i++)
+	{
+		s.motors[i] = robot.motors[i].stats;
+	}
+	stats_buf.publish();
+}
+
+void ControlLoop::publish(bool comms_good, double time_sec, uint64_t cycle_count, uint64_t overrun_count, float cycle_us, bool calibrating)
+{
+	RobotSnapshot& s = snapshot_buf.write_slot();
+	s.num_motors = (int)robot.motors.size();
+	for (int i = 0; i < s.num_motors; i++)
+	{
+		s.p[i] = (float)robot.p[i];
+		s.iq[i] = robot.iq[i];
+		s.dp[i] = robot.dp[i];
+		s.t[i] = (float)robot.t[i];
+		s.connected[i] = robot.motors[i].socket.connected;
+	}
+	s.targ = robot.targ;
+	s.rom_degrees = robot.rom_degrees;
+	s.do_oscillation = robot.do_oscillation;
+	s.calibrating = calibrating;
+	s.comms_good = comms_good;
+	s.time_sec = time_sec;
+	s.cycle_count = cycle_count;
+	s.overrun_count = overrun_count;
+	s.cycle_us = cycle_us;
+	s.plot_drops = robot.plot_feed_drops;
+	snapshot_buf.publish();
+}
+
+void ControlLoop::run(void)
+{
+	const control_clock::duration period = std::chrono::duration_cast<control_clock::duration>(std::chrono::duration<double>(1.0 / rate_hz));
+	const control_clock::time_point t0 = control_clock::now();
+	control_clock::time_point next = t0;
+	uint64_t cycle_count = 0;
+	uint64_t overrun_count = 0;
+
+	while (running.load(std::memory_order_relaxed))
+	{
+		control_clock::time_point cycle_start = control_clock::now();
+
+		input_buf.update();
+		const ControlInput& in = input_buf.read();
+		apply_input(in);
+
+		bool comms_good;
+		if (fused_exchange)
+		{
+			// --- Write previous command + read, one round-trip ---
+			comms_good = robot.exchange();
+
+			// --- Controller (sent with the next exchange) ---
+			compute_tensions(robot, in, comms_good);
+		}
+		else
+		{
+			// --- Read ---
+			comms_good = robot.read();
+
+			// --- Controller ---
+			compute_tensions(robot, in, comms_good);
+
+			// --- Write ---
+			robot.write();
+		}
+
+		control_clock::time_point now = control_clock::now();
+		double time_sec = std::chrono::duration<double>(now - t0).count();
+		robot.follow_trajectory(time_sec);
+
+		cycle_count++;
+		float cycle_us = std::chrono::duration<float, std::micro>(now - cycle_start).count();
+
+		next += period;
+		if (now > next)
+		{
+			//missed the deadline - resynchronize instead of bursting to catch up
+			overrun_count++;
+			next = now;
+		}
+		publish(comms_good, time_sec, cycle_count, overrun_count, cycle_us, false);
+		if (stats_publish_cycles != 0 && (cycle_count % stats_publish_cycles) == 0)
+		{
+			publish_stats();
+		}
+
+		sleep_until_hybrid(next, spin_us);
+	}
+}
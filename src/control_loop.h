@@ -0,0 +1,131 @@
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include "triple_buffer.h"
+#include "comms_stats.h"
+
+#define MAX_MOTORS 8
+
+class SpoolerRobot;
+
+/*
+	GUI -> control thread. The GUI fills a complete copy every frame.
+	One-shot actions are edge-triggered by bumping a *_seq counter; the control
+	thread acts whenever it sees a counter it has not seen before.
+*/
+struct ControlInput
+{
+	int mode;
+	bool clicked;
+	double xpos;	//cursor x, -1..1 across the window
+
+	float k;
+	float kd;
+	float tmax;
+
+	float targ;	//only applied when targ_seq changes - the controller also moves targ
+	uint32_t targ_seq;
+	uint32_t oscillate_toggle_seq;
+	uint32_t calibrate_seq;
+	uint32_t stats_reset_seq;
+
+	char ip[MAX_MOTORS][64];
+	uint16_t port[MAX_MOTORS];
+	uint32_t reconnect_seq[MAX_MOTORS];
+};
+
+/*
+	Control thread -> GUI. Published once per control cycle.
+*/
+struct RobotSnapshot
+{
+	int num_motors;
+	float p[MAX_MOTORS];
+	float iq[MAX_MOTORS];
+	float dp[MAX_MOTORS];
+	float t[MAX_MOTORS];
+	bool connected[MAX_MOTORS];
+
+	float targ;
+	float rom_degrees;
+	bool do_oscillation;
+	bool calibrating;
+	bool comms_good;
+
+	double time_sec;	//control thread clock at the end of the cycle
+	uint64_t cycle_count;
+	uint64_t overrun_count;	//cycles that finished past their deadline
+	float cycle_us;	//compute + I/O time of the last cycle
+	uint64_t plot_drops;	//samples the plot feed had no room for
+};
+
+/*
+	Control thread -> GUI. Per-motor comms accounting, published every stats_publish_cycles.
+*/
+struct CommsStatsSnapshot
+{
+	int num_motors;
+	MotorCommsStats motors[MAX_MOTORS];
+};
+
+/*
+	Runs SpoolerRobot read -> controller -> write on its own thread at a fixed rate,
+	independent of the render loop. The robot is owned by this thread while it runs;
+	the GUI only talks to it through the two triple buffers.
+*/
+class ControlLoop
+{
+public:
+	float rate_hz;	//control rate
+	uint32_t spin_us;	//wake this long before each deadline and spin the remainder, for tighter timing than sleep alone
+	uint32_t stats_publish_cycles;	//comms stats are ~1.6KB per motor, so hand them to the GUI less often than the snapshot
+	bool fused_exchange;	//one write+read round-trip per cycle (command goes out one period after it is computed), instead of read then write
+
+	ControlLoop(SpoolerRobot& robot);
+	~ControlLoop();
+
+	ControlLoop(const ControlLoop&) = delete;
+	ControlLoop& operator=(const ControlLoop&) = delete;
+
+	// Fill an input block from the robot's current settings (call before start)
+	void init_input(ControlInput& in) const;
+
+	bool start(void);
+	void stop(void);
+
+	// GUI side
+	void submit(const ControlInput& in);
+	const RobotSnapshot& latest(void);
+	const CommsStatsSnapshot& latest_stats(void);
+
+private:
+	SpoolerRobot& robot;
+	std::thread thread;
+	std::atomic<bool> running;
+
+	TripleBuffer<ControlInput> input_buf;
+	TripleBuffer<RobotSnapshot> snapshot_buf;
+	TripleBuffer<CommsStatsSnapshot> stats_buf;
+
+	//last seen GUI event counters (control thread only)
+	uint32_t seen_targ_seq;
+	uint32_t seen_oscillate_seq;
+	uint32_t seen_calibrate_seq;
+	uint32_t seen_stats_reset_seq;
+	uint32_t seen_reconnect_seq[MAX_MOTORS];
+
+	void run(void);
+	void apply_input(const ControlInput& in);
+	void publish_stats(void);
+	void publish(bool comms_good, double time_sec, uint64_t cycle_count, uint64_t overrun_count, float cycle_us, bool calibrating);
+};
+
+double thresh_dbl(double in, double hi, double lo);
+
+// The tension law: position or force mode from the GUI input, writes robot.t
+void compute_tensions(SpoolerRobot& robot, const ControlInput& in, bool comms_good);
+
+#endif // CONTROL_LOOP_H
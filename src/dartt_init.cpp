@@ -1,5 +1,75 @@
 #include "dartt_init.h"
+#include "packet_capture.h"
 #include <cstdio>
+#include <cstring>
+#include <chrono>
+#ifdef __linux__
+#include <sys/socket.h>
+#include <errno.h>
+#endif
+
+// Record into udp_capture if one is open. ts_ns of 0 means now.
+static void capture(const UdpState* s, capture_dir_t dir, capture_layer_t layer, const unsigned char* data, size_t len, int64_t ts_ns)
+{
+	if (udp_capture == nullptr)
+	{
+		return;
+	}
+	udp_capture->record(dir, layer, s->peer_addr, s->port, s->local_port, data, len, ts_ns != 0 ? ts_ns : capture_realtime_ns());
+}
+
+/*
+	Receive one datagram into rx_cobs_mem. While a capture is open on Linux, go through recvmsg
+	so the kernel receive time (SO_TIMESTAMPNS, enabled in udp_connect) comes back with it;
+	the same path is taken for nonblocking reads, which udp_drain_late times by it. Otherwise
+	kernel_ts_ns is left 0. With nonblocking set, return a timeout at once instead of
+	waiting out the socket's receive timeout when nothing is queued.
+*/
+static TcsResult receive_datagram(UdpState* s, size_t* received, int64_t* kernel_ts_ns, bool nonblocking)
+{
+	*kernel_ts_ns = 0;
+#ifdef __linux__
+	if (udp_capture != nullptr || nonblocking)
+	{
+		struct iovec iov;
+		iov.iov_base = s->rx_cobs_mem;
+		iov.iov_len = sizeof(s->rx_cobs_mem);
+		alignas(struct cmsghdr) char ctrl[CMSG_SPACE(sizeof(struct timespec))];
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = ctrl;
+		msg.msg_controllen = sizeof(ctrl);
+		ssize_t n = recvmsg(s->socket, &msg, nonblocking ? MSG_DONTWAIT : 0);
+		if (n < 0)
+		{
+			*received = 0;
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? TCS_ERROR_TIMED_OUT : TCS_ERROR_UNKNOWN;
+		}
+		*received = (size_t)n;
+		for (struct cmsghdr* c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c))
+		{
+			if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+			{
+				struct timespec ts;
+				memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+				*kernel_ts_ns = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+			}
+		}
+		return TCS_SUCCESS;
+	}
+#endif
+	struct TcsAddress src;
+	if (nonblocking)
+	{
+		tcs_opt_nonblocking_set(s->socket, true);
+		TcsResult res = tcs_receive_from(s->socket, s->rx_cobs_mem, sizeof(s->rx_cobs_mem), TCS_FLAG_NONE, &src, received);
+		tcs_opt_nonblocking_set(s->socket, false);
+		return res;
+	}
+	return tcs_receive_from(s->socket, s->rx_cobs_mem, sizeof(s->rx_cobs_mem), TCS_FLAG_NONE, &src, received);
+}
 
 int tx_blocking(unsigned char addr, dartt_buffer_t * b, void * user_context, uint32_t timeout)
 {
@@ -11,6 +81,11 @@ int tx_blocking(unsigned char addr, dartt_buffer_t * b, void * user_context, uin
 		.length = b->len,
 		.encoded_state = COBS_DECODED
 	};
+	if (udp_state->mode == UDP_MODE_REPLAY)
+	{
+		return DARTT_PROTOCOL_SUCCESS;	//request already went out during the fan-out pass
+	}
+	capture(udp_state, CAPTURE_TX, CAPTURE_FRAME, b->buf, b->len, 0);	//encoding is in place, so take the frame first
 	int rc = cobs_encode_single_buffer(&cb);
 	if (rc != 0)
 	{
@@ -20,8 +95,22 @@ int tx_blocking(unsigned char addr, dartt_buffer_t * b, void * user_context, uin
 	{
 		return -1;
 	}	
+	if (udp_state->mode == UDP_MODE_STAGE)
+	{
+		//COBS frames are self-delimiting, so staged frames can simply be concatenated
+		if (udp_state->tx_staged_len + cb.length > sizeof(udp_state->tx_cobs_mem))
+		{
+			return -1;
+		}
+		memcpy(udp_state->tx_cobs_mem + udp_state->tx_staged_len, cb.buf, cb.length);
+		udp_state->tx_staged_len += cb.length;
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+	udp_drain_late(udp_state);	//anything queued now predates this request
 	size_t bytes_sent = 0;
+	udp_state->tx_time_ns = udp_now_ns();
 	TcsResult res = tcs_send(udp_state->socket, cb.buf, cb.length, TCS_FLAG_NONE, &bytes_sent);
+	capture(udp_state, CAPTURE_TX, CAPTURE_WIRE, cb.buf, cb.length, 0);
 	rc = (res == TCS_SUCCESS && bytes_sent == cb.length) ? (int)cb.length : -1;
 	if(rc == (int)cb.length)
 	{
@@ -33,66 +122,249 @@ int tx_blocking(unsigned char addr, dartt_buffer_t * b, void * user_context, uin
 	}
 }
 
-int rx_blocking(dartt_buffer_t * buf, void * user_context, uint32_t timeout)
+static int decode_rx(UdpState* udp_state, size_t encoded_len, dartt_buffer_t * buf)
 {
-	UdpState* udp_state = (UdpState*)(user_context);
-
 	cobs_buf_t cb_enc =
 	{
 		.buf = udp_state->rx_cobs_mem,
 		.size = sizeof(udp_state->rx_cobs_mem),
+		.length = encoded_len
+	};
+	cobs_buf_t cb_dec =
+	{
+		.buf = buf->buf,
+		.size = buf->size,
 		.length = 0
 	};
+	int rc = cobs_decode_double_buffer(&cb_enc, &cb_dec);
+	udp_state->rx_status = rc;
+	buf->len = cb_dec.length;	//critical - we are aliasing this read buffer in sync, but must update the length to the cobs decoded value
+
+	if (rc != COBS_SUCCESS)
+	{
+		return rc;
+	}
+	else
+	{
+		capture(udp_state, CAPTURE_RX, CAPTURE_FRAME, buf->buf, buf->len, 0);
+		return DARTT_PROTOCOL_SUCCESS;
+	}
+}
+
+int rx_blocking(dartt_buffer_t * buf, void * user_context, uint32_t timeout)
+{
+	UdpState* udp_state = (UdpState*)(user_context);
+
+	if (udp_state->mode == UDP_MODE_STAGE)
+	{
+		return -7;	//reply is gathered by the caller, report it as not-yet-arrived
+	}
+	if (udp_state->mode == UDP_MODE_REPLAY)
+	{
+		if (udp_state->rx_pending_len == 0)
+		{
+			return -7;
+		}
+		size_t len = udp_state->rx_pending_len;
+		udp_state->rx_pending_len = 0;
+		return decode_rx(udp_state, len, buf);
+	}
 
-	int rc;
 	if (!udp_state->connected)
 	{
 		return -1;
 	}
-	struct TcsAddress src;
-	size_t bytes_received = 0;
-	tcs_opt_receive_timeout_set(udp_state->socket, timeout);
-	TcsResult res = tcs_receive_from(udp_state->socket, cb_enc.buf, cb_enc.size, TCS_FLAG_NONE, &src, &bytes_received);
-	if (res == TCS_SUCCESS)
+
+	//dartt only asks for a reply after a request that wants one, so the request tx just sent is it
+	udp_expect_reply(udp_state);
+
+	//duplicates may arrive ahead of the reply - keep reading within the same timeout
+	int64_t deadline_ns = udp_now_ns() + (int64_t)timeout * 1000000;
+	while (true)
 	{
-		rc = (int)bytes_received;
+		int64_t remaining_ns = deadline_ns - udp_now_ns();
+		if (remaining_ns <= 0)
+		{
+			return -7;
+		}
+		int timeout_ms = (int)((remaining_ns + 999999) / 1000000);
+		if (udp_state->rx_timeout_ms != timeout_ms)	//skip the setsockopt when the timeout has not changed
+		{
+			tcs_opt_receive_timeout_set(udp_state->socket, timeout_ms);
+			udp_state->rx_timeout_ms = timeout_ms;
+		}
+		size_t bytes_received = 0;
+		int64_t kernel_ts_ns = 0;
+		TcsResult res = receive_datagram(udp_state, &bytes_received, &kernel_ts_ns, false);
+		if (res != TCS_SUCCESS)
+		{
+			return -7;
+		}
+		udp_state->rx_time_ns = udp_now_ns();
+		capture(udp_state, CAPTURE_RX, CAPTURE_WIRE, udp_state->rx_cobs_mem, bytes_received, kernel_ts_ns);
+		if (udp_accept_reply(udp_state))
+		{
+			return decode_rx(udp_state, bytes_received, buf);
+		}
 	}
-	else
+}
+
+// Monotonic timestamp shared by the transports, for RTT measurement
+int64_t udp_now_ns(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+	Send everything staged on this socket as one datagram, after draining late replies to the
+	previous request. Sets awaiting_reply on success.
+*/
+bool udp_send_staged(UdpState* state)
+{
+	if (!state->connected || state->tx_staged_len == 0)
+	{
+		state->tx_staged_len = 0;
+		return false;
+	}
+	udp_drain_late(state);
+	size_t bytes_sent = 0;
+	state->tx_time_ns = udp_now_ns();
+	TcsResult res = tcs_send(state->socket, state->tx_cobs_mem, state->tx_staged_len, TCS_FLAG_NONE, &bytes_sent);
+	capture(state, CAPTURE_TX, CAPTURE_WIRE, state->tx_cobs_mem, state->tx_staged_len, 0);
+	bool ok = (res == TCS_SUCCESS && bytes_sent == state->tx_staged_len);
+	state->tx_staged_len = 0;
+	state->rx_pending_len = 0;
+	state->awaiting_reply = ok;
+	if (ok)
 	{
-		rc = -2;
+		udp_expect_reply(state);
 	}
+	return ok;
+}
 
-	if (rc >= 0)
+/*
+	Pull one datagram off a socket that the caller already knows is readable, and stash it
+	for a later UDP_MODE_REPLAY parse. Returns true if a reply was stashed; duplicate
+	datagrams are counted and discarded, leaving awaiting_reply set.
+*/
+bool udp_gather_reply(UdpState* state)
+{
+	if (!state->connected)
 	{
-		cb_enc.length = rc;	//load encoded length (raw buffer)
+		return false;
 	}
-	else if (rc == -2)
+	size_t bytes_received = 0;
+	int64_t kernel_ts_ns = 0;
+	TcsResult res = receive_datagram(state, &bytes_received, &kernel_ts_ns, false);
+	if (res != TCS_SUCCESS || bytes_received == 0)
 	{
-		return -7;
+		return false;
 	}
-	else
+	int64_t rx_time_ns = udp_now_ns();
+	capture(state, CAPTURE_RX, CAPTURE_WIRE, state->rx_cobs_mem, bytes_received, kernel_ts_ns);
+	if (!udp_accept_reply(state))
 	{
-		return -1;
+		return false;
 	}
+	state->rx_time_ns = rx_time_ns;
+	state->rx_pending_len = bytes_received;
+	state->awaiting_reply = false;
+	return true;
+}
 
-	cobs_buf_t cb_dec =
+/*
+	Number the request that just went out (sent at tx_time_ns) as one that expects a reply.
+	Any older request still owed one is abandoned: its reply either was drained before this
+	send or is lost.
+*/
+void udp_expect_reply(UdpState* state)
+{
+	state->tx_seq++;
+	state->rx_seq = state->tx_seq - 1;
+	state->seq_tx_ns = state->tx_time_ns;
+}
+
+/*
+	Take a datagram received after the newest request went out. Returns true if it is the
+	first one since then, i.e. the reply to that request; anything after it is counted as a
+	duplicate for the caller to drop.
+*/
+bool udp_accept_reply(UdpState* state)
+{
+	if (state->rx_seq == state->tx_seq)
 	{
-		.buf = buf->buf,
-		.size = buf->size,
-		.length = 0
-	};
-	rc = cobs_decode_double_buffer(&cb_enc, &cb_dec);
-	buf->len = cb_dec.length;	//critical - we are aliasing this read buffer in sync, but must update the length to the cobs decoded value
+		state->duplicate_replies++;
+		return false;
+	}
+	state->rx_seq = state->tx_seq;
+	return true;
+}
 
-	if (rc != COBS_SUCCESS)
+/*
+	Kernel receive time (SO_TIMESTAMPNS, CLOCK_REALTIME) moved onto the udp_now_ns() clock,
+	or 0 if the kernel did not stamp the datagram.
+*/
+int64_t udp_arrival_ns(int64_t kernel_ts_ns)
+{
+	if (kernel_ts_ns == 0)
 	{
-		return rc;
+		return 0;
 	}
-	else
+	return udp_now_ns() - (capture_realtime_ns() - kernel_ts_ns);
+}
+
+/*
+	Count a datagram drained before the next request goes out. If the newest request is still
+	owed a reply and went out within UDP_REPLY_HORIZON_MS this is it, arriving after its
+	deadline (stale); otherwise it is a duplicate. arrival_ns is when it reached the socket
+	(udp_arrival_ns), not when it was drained, which is always about a control period after
+	the send; only with it is the RTT kept in late_rtt_max_us. 0 counts the reply as stale
+	without an RTT.
+*/
+void udp_drop_late_reply(UdpState* state, int64_t arrival_ns)
+{
+	const int64_t horizon_ns = (int64_t)UDP_REPLY_HORIZON_MS * 1000000;
+	int64_t t_ns = (arrival_ns != 0) ? arrival_ns : udp_now_ns();
+	if (state->rx_seq == state->tx_seq || t_ns - state->seq_tx_ns > horizon_ns)
 	{
-		return DARTT_PROTOCOL_SUCCESS;
+		state->duplicate_replies++;
+		return;
+	}
+	state->rx_seq = state->tx_seq;
+	state->stale_replies++;
+	if (arrival_ns == 0 || arrival_ns < state->seq_tx_ns)
+	{
+		return;	//no usable arrival time
+	}
+	uint32_t late_us = (uint32_t)((arrival_ns - state->seq_tx_ns) / 1000);	//measured from its own request's send
+	if (late_us > state->late_rtt_max_us)
+	{
+		state->late_rtt_max_us = late_us;
+	}
+}
+
+/*
+	Read everything already queued on the socket without blocking and drop it through
+	udp_drop_late_reply. Called just before a new request is sent.
+*/
+void udp_drain_late(UdpState* state)
+{
+	if (!state->connected)
+	{
+		return;
+	}
+	while (true)
+	{
+		size_t bytes_received = 0;
+		int64_t kernel_ts_ns = 0;
+		TcsResult res = receive_datagram(state, &bytes_received, &kernel_ts_ns, true);
+		if (res != TCS_SUCCESS || bytes_received == 0)
+		{
+			return;
+		}
+		capture(state, CAPTURE_RX, CAPTURE_WIRE, state->rx_cobs_mem, bytes_received, kernel_ts_ns);
+		udp_drop_late_reply(state, udp_arrival_ns(kernel_ts_ns));
 	}
-    
 }
 
 bool udp_connect(UdpState* state)
@@ -128,7 +400,25 @@ bool udp_connect(UdpState* state)
 		return false;
 	}
 
+	state->peer_addr = remote_addr.data.ip4.address;
+	struct TcsAddress local_addr = TCS_ADDRESS_NONE;
+	state->local_port = (tcs_address_socket_local(state->socket, &local_addr) == TCS_SUCCESS) ? local_addr.data.ip4.port : 0;
+#ifdef __linux__
+	{
+		//kernel receive times: late replies are timed by them (udp_drain_late), and captures record them
+		int one = 1;
+		setsockopt(state->socket, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one));
+	}
+#endif
+
 	state->connected = true;
+	state->awaiting_reply = false;
+	state->rx_pending_len = 0;
+	state->tx_staged_len = 0;
+	state->rx_timeout_ms = -1;
+	state->rx_status = COBS_SUCCESS;
+	state->tx_seq = 0;	//fresh socket, nothing can be in flight to it
+	state->rx_seq = 0;
 	printf("UDP: connected. Targeting %s:%u\n", state->ip, state->port);
 	return true;
 }
@@ -9,6 +9,32 @@
 #define SERIAL_BUFFER_SIZE 32
 #define NUM_BYTES_COBS_OVERHEAD	2	//we have to tell dartt our serial buffers are smaller than they are, so the COBS layer has room to operate. This allows for functional multiple message handling with write_multi and read_multi for large configs
 
+/*
+	Transfer mode of the tx/rx callbacks. BLOCKING is the normal request/reply behavior.
+	The split modes let a caller fan requests out to many sockets and gather the replies
+	itself, then hand the gathered reply back to dartt for parsing:
+		STAGE - tx COBS-encodes and appends the frame to tx_cobs_mem without sending, so several
+			frames can share one datagram; rx returns a timeout without touching the socket.
+			The caller sends with udp_send_staged() or a batch transport.
+		REPLAY - tx is a no-op (request already sent), rx decodes the reply stashed in rx_cobs_mem
+*/
+typedef enum {UDP_MODE_BLOCKING, UDP_MODE_STAGE, UDP_MODE_REPLAY} udp_mode_t;
+
+/*
+	Host-side request sequencing. DARTT frames carry no transaction ID and the firmware
+	echoes nothing back, so every request that expects a reply is numbered as it goes out,
+	and sending one abandons any older request still owed a reply. Before a new request is
+	sent, whatever is already queued on the socket is drained: it arrived after the previous
+	request's deadline, so it is a late reply to that request (stale) or an extra datagram
+	with nothing outstanding (duplicate), and is dropped either way. After the send, the first
+	datagram is taken as the reply to the new request and any further ones are duplicates.
+	A late reply still in flight at the moment of the send cannot be told apart from the new
+	request's reply without a tag in the frame; it is taken as current for that one cycle.
+	Late replies more than UDP_REPLY_HORIZON_MS after their request are presumed to belong to
+	no request we still track.
+*/
+#define UDP_REPLY_HORIZON_MS 100
+
 struct UdpState 
 {
 	TcsSocket socket;
@@ -16,6 +42,27 @@ struct UdpState
 	unsigned char rx_cobs_mem[64];
 	uint16_t port;
 	bool connected;
+
+	udp_mode_t mode;
+	bool awaiting_reply;	//set when a staged request went out and no reply has been gathered yet
+	size_t rx_pending_len;	//encoded length of a gathered reply held in rx_cobs_mem, 0 if none
+	unsigned char tx_cobs_mem[64];
+	size_t tx_staged_len;	//encoded length of the STAGE frames waiting in tx_cobs_mem, 0 if none
+	int rx_timeout_ms;	//receive timeout currently applied to the socket, -1 if unknown
+
+	int64_t tx_time_ns;	//when the last staged datagram went out (udp_now_ns)
+	int64_t rx_time_ns;	//when the last gathered reply arrived
+	int rx_status;	//COBS result of the last decode, COBS_SUCCESS or the decode error
+
+	uint32_t tx_seq;	//requests sent that expect a reply
+	uint32_t rx_seq;	//newest request that has been answered or abandoned; equal to tx_seq when nothing is owed
+	int64_t seq_tx_ns;	//send time of request tx_seq
+	uint32_t stale_replies;	//dropped late replies to the previous request, since the owner last collected them
+	uint32_t duplicate_replies;	//dropped replies with no request outstanding, likewise
+	uint32_t late_rtt_max_us;	//longest RTT among those stale replies, each from its own request's send, 0 if none
+
+	uint32_t peer_addr;	//resolved IPv4 of ip, host order, for packet capture
+	uint16_t local_port;	//our end of the connection, for packet capture
 };
 
 
@@ -28,5 +75,13 @@ bool udp_connect(UdpState* state);
 void udp_disconnect(UdpState* state);
 int tx_blocking(unsigned char addr, dartt_buffer_t * b, void * user_context, uint32_t timeout);
 int rx_blocking(dartt_buffer_t * buf, void * user_context, uint32_t timeout);
+int64_t udp_now_ns(void);
+bool udp_send_staged(UdpState* state);
+bool udp_gather_reply(UdpState* state);
+void udp_expect_reply(UdpState* state);
+bool udp_accept_reply(UdpState* state);
+int64_t udp_arrival_ns(int64_t kernel_ts_ns);
+void udp_drop_late_reply(UdpState* state, int64_t arrival_ns);
+void udp_drain_late(UdpState* state);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+/*
+	spooler_emulator: serve emulated DARTT actuators over UDP on this machine.
+
+	usage: spooler_emulator [options]
+		--motors N        number of motors (default 2). Addresses count down from N-1, matching main.cpp (0x1, 0x0)
+		--ip A            bind address (default 127.0.0.1)
+		--port P          first port; motor i listens on P+i (default 5400)
+		--latency-us U    reply latency
+		--jitter-us J     extra uniform reply latency 0..J
+		--loss X          request loss probability 0..1
+		--reorder X       probability a reply is overtaken by the next one 0..1
+		--line-k K        couple motors 0 and 1 as one line with stiffness K (N m/rad)
+		--seed S          link impairment RNG seed
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <atomic>
+
+#define TINYCSOCKET_IMPLEMENTATION
+#include "tinycsocket.h"
+
+#include "actuator_emulator.h"
+
+static std::atomic<bool> g_running(true);
+
+static void on_signal(int)
+{
+	g_running.store(false);
+}
+
+int main(int argc, char* argv[])
+{
+	int num_motors = 2;
+	const char* ip = "127.0.0.1";
+	int port = 5400;
+	uint32_t seed = 1;
+
+	ActuatorEmulator emu;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* a = argv[i];
+		const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+		if (v == nullptr)
+		{
+			printf("missing value for %s\n", a);
+			return -1;
+		}
+		if (strcmp(a, "--motors") == 0) num_motors = atoi(v);
+		else if (strcmp(a, "--ip") == 0) ip = v;
+		else if (strcmp(a, "--port") == 0) port = atoi(v);
+		else if (strcmp(a, "--latency-us") == 0) emu.link.latency_us = (uint32_t)atoi(v);
+		else if (strcmp(a, "--jitter-us") == 0) emu.link.jitter_us = (uint32_t)atoi(v);
+		else if (strcmp(a, "--loss") == 0) emu.link.loss = (float)atof(v);
+		else if (strcmp(a, "--reorder") == 0) emu.link.reorder = (float)atof(v);
+		else if (strcmp(a, "--line-k") == 0) emu.plant.line_stiffness = atof(v);
+		else if (strcmp(a, "--seed") == 0) seed = (uint32_t)strtoul(v, nullptr, 10);
+		else
+		{
+			printf("unknown option %s\n", a);
+			return -1;
+		}
+		i++;
+	}
+	if (num_motors < 1 || port < 1 || port + num_motors > 65535)
+	{
+		printf("bad motor count / port\n");
+		return -1;
+	}
+
+	if (tcs_lib_init() != TCS_SUCCESS)
+	{
+		printf("Failed to initialize tinycsocket\n");
+		return -1;
+	}
+
+	emu.seed(seed);
+	for (int i = 0; i < num_motors; i++)
+	{
+		if (!emu.add_motor((unsigned char)(num_motors - 1 - i), ip, (uint16_t)(port + i)))
+		{
+			return -1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	printf("Emulating %d motors (latency %u us, jitter %u us, loss %.3f, reorder %.3f). Ctrl-C to stop.\n",
+		num_motors, emu.link.latency_us, emu.link.jitter_us, (double)emu.link.loss, (double)emu.link.reorder);
+
+	//run on this thread rather than start(), so Ctrl-C is handled here
+	while (g_running.load())
+	{
+		emu.poll(1000);
+	}
+
+	printf("requests %llu, replies %llu, dropped %llu\n",
+		(unsigned long long)emu.requests_received(),
+		(unsigned long long)emu.replies_sent(),
+		(unsigned long long)emu.requests_dropped());
+	tcs_lib_free();
+	return 0;
+}
@@ -0,0 +1,278 @@
+#ifndef FIXED_Q_H
+#define FIXED_Q_H
+
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+#include <type_traits>
+#include "pctl.h"
+
+/*
+	Compile-time Q-format fixed point, for host code that does the firmware's integer math.
+
+	Q<I, F> holds a value with I integer bits and F fractional bits (plus sign) in an int32,
+	raw / 2^F. Every shift is a template constant, so there is no shift-by-variable as with the
+	runtime radix in i32_t. Operations come in explicit flavours:
+		+ - (operators)          wrap within I + F + 1 bits, two's complement, never UB
+		sat_add, sat_sub         clamp to the format's range
+		q_mul_wrap / q_mul_sat   64-bit product, rescaled to the requested output format
+		convert<Q2>(out)         checked rescale, false if the value does not fit
+		Q::constant(v)           consteval; a constant that does not fit is a compile error
+
+	WireQ<Q> and FixedPI2<Qkp, Qki> have exactly the layout of i32_t and fixed_PI_2_params_t
+	(checked below), with the radix field filled in from the type, so they can be bit_cast to
+	and from what goes over DARTT.
+*/
+
+// Called only from the consteval paths; being non-constexpr turns the call into a compile error.
+inline void q_constant_out_of_range(void) {}
+
+template <int I, int F>
+class Q
+{
+public:
+	static_assert(I >= 0 && F >= 0 && I + F <= 31, "Q<I, F> must fit in an int32 with its sign bit");
+
+	static constexpr int INT_BITS = I;
+	static constexpr int FRAC = F;
+	static constexpr int32_t RAW_MAX = (int32_t)(((int64_t)1 << (I + F)) - 1);
+	static constexpr int32_t RAW_MIN = (int32_t)(-((int64_t)1 << (I + F)));
+
+	int32_t raw;
+
+	constexpr Q() : raw(0) {}
+
+	static constexpr Q from_raw(int32_t r)
+	{
+		Q q;
+		q.raw = wrap(r);
+		return q;
+	}
+
+	static constexpr Q from_raw_sat(int64_t r)
+	{
+		Q q;
+		q.raw = sat(r);
+		return q;
+	}
+
+	// false (and out untouched) if r is outside the format
+	static constexpr bool from_raw_checked(int64_t r, Q& out)
+	{
+		if (r < RAW_MIN || r > RAW_MAX)
+		{
+			return false;
+		}
+		out.raw = (int32_t)r;
+		return true;
+	}
+
+	static consteval Q constant(double v)
+	{
+		double scaled = v * (double)((int64_t)1 << F);
+		double rounded = scaled < 0 ? scaled - 0.5 : scaled + 0.5;
+		if (rounded < (double)RAW_MIN - 0.5 || rounded >= (double)RAW_MAX + 1.0)
+		{
+			q_constant_out_of_range();
+		}
+		Q q;
+		q.raw = (int32_t)(int64_t)rounded;
+		return q;
+	}
+
+	// Runtime conversion from floating point, saturating
+	static Q from_double(double v)
+	{
+		double scaled = v * (double)((int64_t)1 << F);
+		if (scaled >= (double)RAW_MAX)
+		{
+			return from_raw(RAW_MAX);
+		}
+		if (scaled <= (double)RAW_MIN)
+		{
+			return from_raw(RAW_MIN);
+		}
+		return from_raw((int32_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5));
+	}
+
+	constexpr double to_double() const
+	{
+		return (double)raw / (double)((int64_t)1 << F);
+	}
+
+	// Integer part, rounded toward negative infinity like the firmware's >> radix
+	constexpr int32_t to_int() const
+	{
+		return raw >> F;
+	}
+
+	constexpr Q operator+(Q b) const { return from_raw((int32_t)((uint32_t)raw + (uint32_t)b.raw)); }
+	constexpr Q operator-(Q b) const { return from_raw((int32_t)((uint32_t)raw - (uint32_t)b.raw)); }
+	constexpr Q operator-() const { return from_raw((int32_t)(0u - (uint32_t)raw)); }
+	constexpr Q& operator+=(Q b) { *this = *this + b; return *this; }
+	constexpr Q& operator-=(Q b) { *this = *this - b; return *this; }
+
+	constexpr Q sat_add(Q b) const { return from_raw_sat((int64_t)raw + b.raw); }
+	constexpr Q sat_sub(Q b) const { return from_raw_sat((int64_t)raw - b.raw); }
+
+	constexpr bool operator==(const Q& b) const { return raw == b.raw; }
+	constexpr bool operator<(const Q& b) const { return raw < b.raw; }
+
+	// Shift by a compile-time amount, i.e. multiply by 2^N, saturating
+	template <int N>
+	constexpr Q shift_sat() const
+	{
+		if constexpr (N >= 0)
+			return from_raw_sat((int64_t)raw << N);
+		else
+			return from_raw_sat((int64_t)raw >> -N);
+	}
+
+	// Rescale to another format. Truncates toward negative infinity when dropping bits.
+	template <class Q2>
+	constexpr bool convert(Q2& out) const
+	{
+		return Q2::from_raw_checked(rescale_raw<F, Q2::FRAC>(raw), out);
+	}
+
+	template <class Q2>
+	constexpr Q2 convert_sat() const
+	{
+		return Q2::from_raw_sat(rescale_raw<F, Q2::FRAC>(raw));
+	}
+
+	// raw value in FROM fractional bits -> TO fractional bits, exact in int64 for any int32 input
+	template <int FROM, int TO>
+	static constexpr int64_t rescale_raw(int64_t r)
+	{
+		if constexpr (TO >= FROM)
+			return r << (TO - FROM);
+		else
+			return r >> (FROM - TO);
+	}
+
+private:
+	static constexpr int32_t wrap(int32_t r)
+	{
+		if constexpr (I + F == 31)
+		{
+			return r;
+		}
+		else
+		{
+			constexpr int S = 31 - I - F;
+			return (int32_t)((uint32_t)r << S) >> S;
+		}
+	}
+
+	static constexpr int32_t sat(int64_t r)
+	{
+		return r > RAW_MAX ? RAW_MAX : (r < RAW_MIN ? RAW_MIN : (int32_t)r);
+	}
+};
+
+// a * b rescaled to QOut; all shifts are constants. _sat clamps, _wrap keeps the low bits.
+template <class QOut, int IA, int FA, int IB, int FB>
+constexpr QOut q_mul_sat(Q<IA, FA> a, Q<IB, FB> b)
+{
+	int64_t p = (int64_t)a.raw * (int64_t)b.raw;
+	return QOut::from_raw_sat(Q<IA, FA>::template rescale_raw<FA + FB, QOut::FRAC>(p));
+}
+
+template <class QOut, int IA, int FA, int IB, int FB>
+constexpr QOut q_mul_wrap(Q<IA, FA> a, Q<IB, FB> b)
+{
+	int64_t p = (int64_t)a.raw * (int64_t)b.raw;
+	return QOut::from_raw((int32_t)Q<IA, FA>::template rescale_raw<FA + FB, QOut::FRAC>(p));
+}
+
+// Plain integer times a gain, result as an integer: (x * g) >> F, like the firmware's gain multiply
+template <int I, int F>
+constexpr int32_t q_scale(int32_t x, Q<I, F> g)
+{
+	return (int32_t)(((int64_t)x * g.raw) >> F);
+}
+
+/*
+	i32_t with the radix fixed by the type. radix is still stored, because it is on the wire.
+*/
+template <class QT>
+struct WireQ
+{
+	QT value;
+	int32_t radix = QT::FRAC;
+
+	constexpr i32_t to_i32(void) const
+	{
+		return i32_t{value.raw, QT::FRAC};
+	}
+
+	// From what a motor reports: rescaled if the radix differs, false if it does not fit
+	constexpr bool from_i32(const i32_t& w)
+	{
+		if (w.radix < 0 || w.radix > 31)
+		{
+			return false;
+		}
+		int64_t r = w.i32;
+		if (w.radix < QT::FRAC)
+			r <<= (QT::FRAC - w.radix);	//only on a radix mismatch
+		else
+			r >>= (w.radix - QT::FRAC);
+		if (!QT::from_raw_checked(r, value))
+		{
+			return false;
+		}
+		radix = QT::FRAC;
+		return true;
+	}
+};
+
+/*
+	fixed_PI_2_params_t with typed gains.
+*/
+template <class QKp, class QKi>
+struct FixedPI2
+{
+	WireQ<QKp> kp;
+	WireQ<QKi> ki;
+	int32_t x_integral_div;
+	int32_t x;
+	int32_t x_sat;
+	uint8_t out_rshift;
+
+	fixed_PI_2_params_t to_params(void) const
+	{
+		return std::bit_cast<fixed_PI_2_params_t>(*this);
+	}
+
+	// false if either gain does not fit the typed format
+	bool from_params(const fixed_PI_2_params_t& p)
+	{
+		FixedPI2 t = *this;
+		if (!t.kp.from_i32(p.kp) || !t.ki.from_i32(p.ki))
+		{
+			return false;
+		}
+		t.x_integral_div = p.x_integral_div;
+		t.x = p.x;
+		t.x_sat = p.x_sat;
+		t.out_rshift = p.out_rshift;
+		*this = t;
+		return true;
+	}
+};
+
+// Wire layout checks, for a representative instantiation
+typedef WireQ<Q<15, 16>> wire_q_check_t;
+typedef FixedPI2<Q<15, 16>, Q<15, 16>> fixed_pi2_check_t;
+static_assert(std::is_standard_layout_v<wire_q_check_t> && std::is_trivially_copyable_v<wire_q_check_t>);
+static_assert(sizeof(wire_q_check_t) == sizeof(i32_t));
+static_assert(offsetof(wire_q_check_t, radix) == offsetof(i32_t, radix));
+static_assert(sizeof(fixed_pi2_check_t) == sizeof(fixed_PI_2_params_t));
+static_assert(offsetof(fixed_pi2_check_t, ki) == offsetof(fixed_PI_2_params_t, ki));
+static_assert(offsetof(fixed_pi2_check_t, x_integral_div) == offsetof(fixed_PI_2_params_t, x_integral_div));
+static_assert(offsetof(fixed_pi2_check_t, x_sat) == offsetof(fixed_PI_2_params_t, x_sat));
+static_assert(offsetof(fixed_pi2_check_t, out_rshift) == offsetof(fixed_PI_2_params_t, out_rshift));
+
+#endif // FIXED_Q_H
@@ -0,0 +1,253 @@
+#ifndef HISTORY_PYRAMID_H
+#define HISTORY_PYRAMID_H
+
+#include <cstddef>
+#include <cstdint>
+#include "ring_buffer.h"
+
+#define HISTORY_LEVELS 8
+
+// Summary of a run of consecutive samples
+struct HistoryBin
+{
+	double t_first;	//time of the first and last sample in the run
+	double t_last;
+	float min;
+	float max;
+	double sum;
+	uint32_t count;
+
+	float mean(void) const { return (count > 0) ? (float)(sum / count) : 0.f; }
+};
+
+/*
+	Multi-resolution history of one channel, for looking at seconds or a day of data at the
+	same cost per frame. Level 0 holds one bin per sample, level k one bin per fanout^k
+	samples (min, max, sum and count, so the mean). push() brings the newest bin of every
+	level up to date, O(HISTORY_LEVELS) per sample with nothing allocated.
+
+	configure() splits a fixed memory budget evenly over the levels. Each level is a ring, so
+	once full it evicts its own oldest bins: the fine levels keep only the recent past and
+	each coarser one reaches fanout times further back. At 1 kHz, 8 MB and fanout 8, level 0
+	holds about 26 s, level 3 about 3.7 h and level 7 well over a year.
+
+	Bins keep double times, but the plotter feeds them its float seconds, so a time is only as
+	fine as the float spacing at that point of the run: 1 ms after about 2.3 h, 8 ms after a
+	day, 2 s after a year. That is far below a coarse bin's span, but past a few hours
+	neighbouring level 0 samples can share a time.
+
+	query() summarises [t0, t1] into a number of columns from the finest level that both
+	reaches back to t0 (or as far back as anything does) and has at most
+	HISTORY_BINS_PER_COLUMN bins per column in the range, so a frame touches O(columns) bins
+	whatever the zoom. Times must not decrease; clear() when they do.
+*/
+#define HISTORY_BINS_PER_COLUMN 4
+
+class HistoryPyramid
+{
+public:
+	HistoryPyramid()
+		: levels()
+		, fanout(8)
+		, fill()
+	{
+		clear();
+	}
+
+	// Allocates budget_bytes / HISTORY_LEVELS bytes of bins per level; 0 turns the history off
+	void configure(size_t budget_bytes, uint32_t level_fanout = 8)
+	{
+		fanout = (level_fanout < 2) ? 2 : level_fanout;
+		size_t bins = budget_bytes / (HISTORY_LEVELS * sizeof(HistoryBin));
+		for (int k = 0; k < HISTORY_LEVELS; k++)
+		{
+			levels[k].set_capacity(bins);
+		}
+		clear();
+	}
+
+	bool enabled(void) const
+	{
+		return levels[0].capacity() > 0;
+	}
+
+	void clear(void)
+	{
+		for (int k = 0; k < HISTORY_LEVELS; k++)
+		{
+			levels[k].clear();
+			fill[k] = 0;
+		}
+	}
+
+	void push(double t, float v)
+	{
+		if (!enabled())
+		{
+			return;
+		}
+		uint64_t width = 1;	//samples per bin at level k
+		for (int k = 0; k < HISTORY_LEVELS; k++)
+		{
+			RingBuffer<HistoryBin>& ring = levels[k];
+			if (fill[k] == 0)
+			{
+				HistoryBin b;
+				b.t_first = t;
+				b.t_last = t;
+				b.min = v;
+				b.max = v;
+				b.sum = v;
+				b.count = 1;
+				ring.push(b);
+			}
+			else
+			{
+				HistoryBin& b = ring[ring.size() - 1];
+				b.t_last = t;
+				if (v < b.min)
+					b.min = v;
+				if (v > b.max)
+					b.max = v;
+				b.sum += v;
+				b.count++;
+			}
+			fill[k]++;
+			if (fill[k] == width)
+			{
+				fill[k] = 0;
+			}
+			width *= fanout;
+		}
+	}
+
+	const RingBuffer<HistoryBin>& level(int k) const
+	{
+		return levels[k];
+	}
+
+	uint32_t level_fanout(void) const
+	{
+		return fanout;
+	}
+
+	/*
+		Summarise [t0, t1] into columns bins in out (equal slices of time; count 0 where a
+		slice has no data). Returns the level read, or -1 if there is nothing in range.
+	*/
+	int query(double t0, double t1, int columns, HistoryBin* out) const
+	{
+		for (int c = 0; c < columns; c++)
+		{
+			out[c].t_first = 0.0;
+			out[c].t_last = 0.0;
+			out[c].min = 0.f;
+			out[c].max = 0.f;
+			out[c].sum = 0.0;
+			out[c].count = 0;
+		}
+		if (columns <= 0 || !(t1 > t0) || levels[0].empty())
+		{
+			return -1;
+		}
+
+		//the coarsest level reaches furthest back; no level can do better than that
+		double oldest = levels[0].front().t_first;
+		for (int k = 1; k < HISTORY_LEVELS; k++)
+		{
+			if (!levels[k].empty() && levels[k].front().t_first < oldest)
+				oldest = levels[k].front().t_first;
+		}
+		double reach = (t0 > oldest) ? t0 : oldest;
+
+		int k = 0;
+		size_t i0 = 0;
+		size_t i1 = 0;
+		for (; k < HISTORY_LEVELS; k++)
+		{
+			const RingBuffer<HistoryBin>& ring = levels[k];
+			if (ring.empty() || ring.front().t_first > reach)
+			{
+				continue;
+			}
+			i0 = first_ending_after(ring, t0);
+			i1 = first_starting_after(ring, t1);
+			if (i1 - i0 <= (size_t)columns * HISTORY_BINS_PER_COLUMN || k == HISTORY_LEVELS - 1)
+			{
+				break;
+			}
+		}
+		if (k == HISTORY_LEVELS || i1 <= i0)
+		{
+			return -1;
+		}
+
+		const RingBuffer<HistoryBin>& ring = levels[k];
+		double per_col = (double)columns / (t1 - t0);
+		for (size_t i = i0; i < i1; i++)
+		{
+			const HistoryBin& b = ring[i];
+			double mid = 0.5 * (b.t_first + b.t_last);
+			int c = (int)((mid - t0) * per_col);
+			if (c < 0)
+				c = 0;
+			else if (c >= columns)
+				c = columns - 1;
+			HistoryBin& o = out[c];
+			if (o.count == 0)
+			{
+				o = b;
+			}
+			else
+			{
+				o.t_last = b.t_last;
+				if (b.min < o.min)
+					o.min = b.min;
+				if (b.max > o.max)
+					o.max = b.max;
+				o.sum += b.sum;
+				o.count += b.count;
+			}
+		}
+		return k;
+	}
+
+private:
+	RingBuffer<HistoryBin> levels[HISTORY_LEVELS];
+	uint32_t fanout;
+	uint64_t fill[HISTORY_LEVELS];	//samples in the newest bin of each level
+
+	// index of the first bin with t_last >= t
+	static size_t first_ending_after(const RingBuffer<HistoryBin>& ring, double t)
+	{
+		size_t lo = 0;
+		size_t hi = ring.size();
+		while (lo < hi)
+		{
+			size_t mid = lo + (hi - lo) / 2;
+			if (ring[mid].t_last < t)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	// index of the first bin with t_first > t
+	static size_t first_starting_after(const RingBuffer<HistoryBin>& ring, double t)
+	{
+		size_t lo = 0;
+		size_t hi = ring.size();
+		while (lo < hi)
+		{
+			size_t mid = lo + (hi - lo) / 2;
+			if (ring[mid].t_first <= t)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+};
+
+#endif // HISTORY_PYRAMID_H
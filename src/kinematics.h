@@ -0,0 +1,233 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <cmath>
+#include <Eigen/Dense>
+
+/*
+	Kinematics of a point-mass cable robot: N cables from fixed anchors (the spool exit
+	points) to one end effector, in the plane (D = 2) or in space (D = 3). The two-spool
+	line main.cpp drives is D = 2, N = 2.
+
+		lengths_from_angles   spool angles (SpoolerRobot::p, degrees) -> cable lengths
+		inverse               end-effector position -> cable lengths, |anchor_i - x|
+		forward               cable lengths -> position, damped Gauss-Newton from the last solution
+		update                refresh the cached structure matrix and Jacobian at a position
+
+	The structure matrix A (D x N, column i = unit vector from the end effector towards
+	anchor i, so A t is the force the cables apply) and the length Jacobian dl/dx = -A^T
+	are members, refreshed in place: forward() leaves them at the pose it converged to, so a
+	cycle that runs forward kinematics gets them for its tension solve at no extra cost, and
+	update() skips the work when the pose has not moved. A refresh is a full recompute of
+	every column, not an incremental correction: each column depends on the pose through its
+	own distance, so there is nothing cheaper than the O(D N) rebuild that stays exact.
+	Everything is fixed size and nothing allocates, so it can run in the control thread.
+*/
+
+template <int D, int N>
+class CableKinematics
+{
+public:
+	static_assert(D == 2 || D == 3, "planar or spatial");
+	static_assert(N >= D, "at least as many cables as position coordinates");
+
+	typedef Eigen::Matrix<double, D, 1> Pos;
+	typedef Eigen::Matrix<double, N, 1> Lengths;
+	typedef Eigen::Matrix<double, D, N> StructMat;
+	typedef Eigen::Matrix<double, N, D> Jacobian;
+
+	static constexpr double RAD_PER_DEG = 3.14159265358979323846 / 180.0;
+
+	Eigen::Matrix<double, D, N> anchor;	//m
+	double spool_radius;	//m
+	Lengths length_zero;	//cable length at spool angle 0, i.e. where calibrate() zeroed
+	Lengths wind_sign;	//+1 where a positive spool angle winds cable in (shortens it), -1 otherwise
+
+	// N == D only: unit normal of the line (plane) through the anchors, pointing to the side
+	// the end effector is on. The lengths fit its mirror image across that line equally
+	// well, so forward() reflects onto this side. Set by set_geometry from zero_pose; zero
+	// to accept either side.
+	Pos side;
+
+	int max_iterations;	//Gauss-Newton steps per forward()
+	double tol;	//m, forward() stops once a step is shorter than this
+
+	int iterations;	//steps taken by the last forward()
+	double residual;	//rms |anchor_i - x| - l_i at the last forward() result, m
+
+	CableKinematics()
+		: spool_radius(0.01)
+		, max_iterations(20)
+		, tol(1e-9)
+		, iterations(0)
+		, residual(0.0)
+	{
+		anchor.setZero();
+		length_zero.setZero();
+		wind_sign.setOnes();
+		side.setZero();
+		x.setZero();
+		set_pose(x);
+	}
+
+	// Anchors and spool radius, with every spool at angle 0 while the end effector is at zero_pose.
+	// zero_pose also seeds forward().
+	void set_geometry(const Eigen::Matrix<double, D, N>& anchors, double radius, const Pos& zero_pose)
+	{
+		anchor = anchors;
+		spool_radius = radius;
+		length_zero = (anchor.colwise() - zero_pose).colwise().norm().transpose();
+		side.setZero();
+		if constexpr (N == D)
+		{
+			Pos n = anchor_normal();
+			double h = n.dot(zero_pose - anchor.col(0));
+			if (h != 0.0)
+				side = (h > 0.0) ? n : Pos(-n);
+		}
+		seed(zero_pose);
+	}
+
+	// Start the next forward() from x0, e.g. to pick the branch when N == D
+	void seed(const Pos& x0)
+	{
+		set_pose(x0);
+	}
+
+	void lengths_from_angles(const double* p_deg, Lengths& l) const
+	{
+		for (int i = 0; i < N; i++)
+		{
+			l[i] = length_zero[i] - wind_sign[i] * spool_radius * p_deg[i] * RAD_PER_DEG;
+		}
+	}
+
+	void inverse(const Pos& pos, Lengths& l) const
+	{
+		l = (anchor.colwise() - pos).colwise().norm().transpose();
+	}
+
+	// Cached structure matrix and Jacobian at pos
+	void update(const Pos& pos)
+	{
+		if (pos != x)
+		{
+			set_pose(pos);
+		}
+	}
+
+	const Pos& position(void) const { return x; }
+	const StructMat& structure(void) const { return A; }
+	const Jacobian& jacobian(void) const { return J; }
+	const Lengths& distances(void) const { return dist; }	//|anchor_i - position()|
+
+	/*
+		Gauss-Newton on r(x) = |anchor_i - x| - l_i, whose Jacobian is -A^T:
+			(A A^T + lambda I) dx = A r
+		damped Levenberg-Marquardt style: a step is only taken if it lowers |r|, otherwise
+		lambda grows and the step shrinks towards steepest descent, so it stays bounded where
+		the cables line up (on the line between two anchors A A^T is singular). With N > D,
+		or with cables stretched past their wound length, the lengths need not agree exactly;
+		the result is then the least-squares position and residual says how far off they
+		were. Returns false if it did not converge within max_iterations (x is left at the
+		best iterate).
+	*/
+	bool forward(const Lengths& l, Pos& pos)
+	{
+		iterations = 0;
+		bool converged = false;
+		if (side.squaredNorm() > 0.0)
+		{
+			//on the anchor line every cable direction is in it, and so is every step: step off first
+			double h = side.dot(x - anchor.col(0));
+			if (h < 1e-6)
+				set_pose(x + side * (1e-6 - h));
+		}
+		double cost = (dist - l).squaredNorm();
+		double lambda = 1e-9;
+		while (iterations < max_iterations)
+		{
+			iterations++;
+			Eigen::Matrix<double, D, D> K = A * A.transpose();
+			K.diagonal().array() += lambda;
+			Pos dx = K.ldlt().solve(A * (dist - l));
+			if (!dx.allFinite())
+			{
+				break;
+			}
+			Pos xt = x + dx;
+			double trial = ((anchor.colwise() - xt).colwise().norm().transpose() - l).squaredNorm();
+			if (trial <= cost)
+			{
+				set_pose(xt);
+				cost = trial;
+				lambda = std::fmax(lambda * 0.25, 1e-9);
+				if (dx.norm() < tol)
+				{
+					converged = true;
+					break;
+				}
+			}
+			else
+			{
+				lambda = std::fmax(lambda * 8.0, 1e-6);
+				if (dx.norm() < tol)
+				{
+					converged = true;	//cannot improve on a step this short
+					break;
+				}
+			}
+		}
+		if (side.squaredNorm() > 0.0)
+		{
+			double h = side.dot(x - anchor.col(0));
+			if (h < 0.0)
+				set_pose(x - 2.0 * h * side);	//mirror image: same lengths
+		}
+		residual = std::sqrt(cost / N);
+		pos = x;
+		return converged;
+	}
+
+private:
+	Pos x;	//pose the cached terms below belong to
+	Eigen::Matrix<double, D, N> d;	//anchor_i - x
+	Lengths dist;
+	StructMat A;
+	Jacobian J;
+
+	// Unit normal of the line (D = 2) or plane (D = 3) through the first D anchors
+	Pos anchor_normal(void) const
+	{
+		Pos n;
+		if constexpr (D == 2)
+		{
+			Pos e = anchor.col(1) - anchor.col(0);
+			n << -e.y(), e.x();
+		}
+		else
+		{
+			Eigen::Vector3d e1 = anchor.col(1) - anchor.col(0);
+			Eigen::Vector3d e2 = anchor.col(2) - anchor.col(0);
+			n = e1.cross(e2);
+		}
+		double len = n.norm();
+		return (len > 0.0) ? Pos(n / len) : Pos(Pos::Zero());
+	}
+
+	// Recompute d, dist, A and J from scratch at pos
+	void set_pose(const Pos& pos)
+	{
+		x = pos;
+		d = anchor.colwise() - x;
+		dist = d.colwise().norm().transpose();
+		for (int i = 0; i < N; i++)
+		{
+			double inv = (dist[i] > 0.0) ? 1.0 / dist[i] : 0.0;	//at an anchor the direction is undefined
+			A.col(i) = d.col(i) * inv;
+		}
+		J = -A.transpose();
+	}
+};
+
+#endif // KINEMATICS_H
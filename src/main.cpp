@@ -45,9 +45,15 @@
 
 #include <algorithm>
 #include <string>
+#include <cstring>
 #include "dartt_mctl_params.h"
 #include "motor.h"
 #include "spooler_robot.h"
+#include "control_loop.h"
+#include "actuator_emulator.h"
+#include "cable_sim.h"
+#include "packet_capture.h"
+#include "plot_feed.h"
 
 // Helper: case-insensitive extension check
 static bool ends_with_ci(const std::string& str, const std::string& suffix) 
@@ -62,23 +68,35 @@ static bool ends_with_ci(const std::string& str, const std::string& suffix)
 }
 
 
-double thresh_dbl(double in, double hi, double lo)
+int main(int argc, char* argv[])
 {
-	if(in > hi)
-	{
-		return hi;
-	}
-	else if(in < lo)
+	// --emulate: serve in-process emulated actuators on localhost and connect to those instead
+	// --sim: no sockets at all; the robot drives the cable_sim.h plant directly
+	// --capture <file.pcapng>: record all actuator traffic for Wireshark
+	// --record <file.tlm>: log every control cycle's raw telemetry (see telemetry_recorder.h)
+	bool emulate = false;
+	bool simulate = false;
+	const char* capture_path = nullptr;
+	const char* record_path = nullptr;
+	for (int i = 1; i < argc; i++)
 	{
-		return lo;
+		if (strcmp(argv[i], "--emulate") == 0)
+		{
+			emulate = true;
+		}
+		else if (strcmp(argv[i], "--sim") == 0)
+		{
+			simulate = true;
+		}
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			capture_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+		{
+			record_path = argv[++i];
+		}
 	}
-	return in;
-}
-
-int main(int argc, char* argv[])
-{
-	(void)argc;
-	(void)argv;
 
 	// Drag-and-drop state
 
@@ -160,36 +178,87 @@ int main(int argc, char* argv[])
 		printf("Initialize tinycsocket library success\n");
 	}
 
+	//open before any motor connects, so every socket gets kernel receive timestamps
+	PacketCapture capture;
+	if (capture_path != nullptr && capture.open(capture_path))
+	{
+		udp_capture = &capture;
+	}
+
+	ActuatorEmulator emulator;
+	CableSim<2> plant;
 	SpoolerRobot robot;
 	robot.motors.reserve(2);
-	robot.add_motor(0x1, "192.168.0.25", 5400);
-	robot.add_motor(0x0, "192.168.0.26", 5400);
+	if (simulate)
+	{
+		robot.add_offline_motor(0x1);
+		robot.add_offline_motor(0x0);
+		robot.sim = &plant;
+	}
+	else if (emulate)
+	{
+		emulator.plant.line_stiffness = 0.5;
+		emulator.add_motor(0x1, "127.0.0.1", 5400);
+		emulator.add_motor(0x0, "127.0.0.1", 5401);
+		emulator.start();
+		robot.add_motor(0x1, "127.0.0.1", 5400);
+		robot.add_motor(0x0, "127.0.0.1", 5401);
+	}
+	else
+	{
+		robot.add_motor(0x1, "192.168.0.25", 5400);
+		robot.add_motor(0x0, "192.168.0.26", 5400);
+	}
+	TelemetryRecorder recorder;
+	if (record_path != nullptr && recorder.open(record_path, (int)robot.motors.size()))
+	{
+		robot.recorder = &recorder;
+	}
 	robot.targ = -10e3;
 	robot.k = 0.5;
 	robot.kd = 3.0;
 	robot.tmax = 600;
-	robot.prev_time = 0;
 	robot.rom_degrees = -21000;
+	robot.do_oscillation = false;
+
+	//every parsed reply goes to the plot with its receive time, at the control rate
+	PlotFeed plot_feed;
+	plot_feed.init(PLOT_FEED_CAPACITY);
+	robot.plot_feed = &plot_feed;
+	int64_t plot_t0_ns = udp_now_ns();	//plot time zero: float x resolution is under 1 ms for the first 2.3 h, about 8 ms after a day
+
+	ControlLoop control(robot);
+	control.rate_hz = 1000.f;
+	control.spin_us = 200;
+	robot.sim_cycle_s = 1.0 / control.rate_hz;	//paced by the control thread, so the plant runs in real time
+	ControlInput input;
+	control.init_input(input);
+	if (!control.start())
+	{
+		printf("Failed to start control loop\n");
+		return -1;
+	}
+	RobotSnapshot snap = control.latest();	//GUI-side copy of the robot state; the plotter reads plot_feed
 
 
+	//one timebase per motor (each reply has its own receive time), with its p, iq and dp columns
 	int num_motors = (int)robot.motors.size();
+	std::vector<PlotTimebase> motor_tb(num_motors);
 	plot.lines.resize(num_motors);
 	for (int i = 0; i < num_motors; i++)
 	{
-		plot.lines[i].xsource = &plot.sys_sec;
-		plot.lines[i].ysource = &robot.iq[i];
+		motor_tb[i] = plot.channels.add_timebase((size_t)(10.f * control.rate_hz));	//10 s of samples, fed from plot_feed
+		plot.channels.add_channel(motor_tb[i]);	//p
+		PlotChannel iq = plot.channels.add_channel(motor_tb[i]);
+		plot.channels.add_channel(motor_tb[i]);	//dp
+		plot.lines[i].channel = iq;
 		plot.lines[i].color   = template_colors[(i+1) % (sizeof(template_colors)/sizeof(rgb_t))];
+		plot.lines[i].history.configure(8u << 20);	//8 MB per channel: 26 s at full rate in level 0, years in the top level
 	}
-	int numkeys = 0;
-	const uint8_t * keys = SDL_GetKeyboardState(&numkeys);
 
 	// Main loop
 	bool running = true;
-	bool do_pctl = false;
-	uint8_t prev_space_state = 0;
 	
-	int mode = FORCE_MODE;
-	bool clicked = false;
 	while (running)
 	{
 		// Poll events
@@ -209,11 +278,11 @@ int main(int argc, char* argv[])
 			}
 			if(event.type == SDL_MOUSEBUTTONDOWN || event.type == SDL_FINGERDOWN)
 			{
-				clicked = true;
+				input.clicked = true;
 			}
 			if(event.type == SDL_MOUSEBUTTONUP || event.type == SDL_FINGERUP)
 			{
-				clicked = false;
+				input.clicked = false;
 			}
 		}
 
@@ -222,109 +291,40 @@ int main(int argc, char* argv[])
 		ImGui_ImplSDL2_NewFrame();
 		ImGui::NewFrame();
 
-		// --- Read ---
-		bool comms_good = robot.read();
-
-		// --- Controller (mouse → tensions) ---
-		double t1 = 0, t2 = 0;
-		
-		if (comms_good)
-		{
-			int mouse_x, mouse_y;
-			SDL_GetMouseState(&mouse_x, &mouse_y);
-			int w, h;
-			SDL_GetWindowSize(window, &w, &h);
-			
-			double xpos = ((float)mouse_x - w/2.f) / (w/2.f);
-
-			SDL_PumpEvents();	//needed for keystrokes
-			if(mode == FORCE_MODE)
-			{
-				do_pctl = false;
-			}
-			else
-			{
-				do_pctl = true;
-			}
-			
-			if(do_pctl)
-			{
-				robot.targ = thresh_dbl(robot.targ, 0, robot.rom_degrees);
-				if(mode == PCTL_CURSOR && clicked)
-				{
-					robot.targ = ((xpos+1.f)/2.f)*robot.rom_degrees;
-				}
-				float velocity = (robot.dp[0] - robot.dp[1]);
-				float f = robot.k*(robot.targ - robot.p[0]) - robot.kd * velocity;
-				if(f > 0)
-				{
-					t1 = f;
-					t2 = 100;
-					// t2 = 300 + robot.dp[1];
-				}
-				else if(f < 0)
-				{
-					t2 = -f;
-					t1 = 100;
-					// t1 = 300 + robot.dp[0];
-				}
-				else
-				{
-					t1 = 200;
-					t2 = 200;
-				}
+		// --- Latest state from the control thread ---
+		snap = control.latest();
 
-			}
-			else if(clicked)
-			{
-				if(xpos >  0.1) 
-				{ 
-					t1 = xpos*robot.tmax;  
-					t2 = 100; 
-				}
-				else if (xpos < -0.1) 
-				{ 
-					t2 = -xpos*robot.tmax; 
-					t1 = 100; 
-				}
-				else
-				{ 
-					t1 = 200;
-					t2 = 200; 
-				}
-			}
-			t1 = thresh_dbl(t1, robot.tmax, 100.);
-			t2 = thresh_dbl(t2, robot.tmax, 100.);
-		}
-		robot.t[0] = t1;
-		robot.t[1] = t2;
-
-		// --- Write ---
-		robot.write();
+		// --- Cursor → control input ---
+		int mouse_x, mouse_y;
+		SDL_GetMouseState(&mouse_x, &mouse_y);
+		int w, h;
+		SDL_GetWindowSize(window, &w, &h);
+		input.xpos = ((float)mouse_x - w/2.f) / (w/2.f);
 
 		SDL_GetWindowSize(window, &plot.window_width, &plot.window_height);
 		for (int i = 0; i < (int)plot.lines.size(); i++)
 		{
-			plot.lines[i].yscale  =  (float)plot.window_height / (robot.tmax*1.1f);
+			plot.lines[i].yscale  =  (float)plot.window_height / (input.tmax*1.1f);
 			plot.lines[i].yoffset = -(float)plot.window_height / 3.f;
 		}
-		plot.sys_sec = (float)(((double)SDL_GetTicks64())/1000.);
 
-		//add new frame of data to each line, as determined by UI
-		for(int i = 0; i < plot.lines.size(); i++)
-		{
-			plot.lines[i].enqueue_data(plot.window_width);
-		}
-		
-		
-		if(robot.do_oscillation)
+		//every sample the control thread received since the last frame, at its own receive time
+		PlotSample ps;
+		while (plot_feed.pop(ps))
 		{
-			robot.oscillate(plot.sys_sec);
+			if (ps.motor < 0 || ps.motor >= num_motors)
+				continue;
+			plot.sys_sec = (float)((double)(ps.t_ns - plot_t0_ns) * 1e-9);
+			float row[3] = {ps.p, ps.iq, ps.dp};
+			plot.channels.append(motor_tb[ps.motor], plot.sys_sec, row);
 		}
 
 		// Render
-		render_socket_ui(robot);
-		render_telemetry_ui(robot, mode);
+		render_socket_ui(snap, input);
+		render_telemetry_ui(snap, input);
+		render_comms_ui(control.latest_stats(), input);
+		render_plot_ui(plot);
+		control.submit(input);
 		ImGui::Render();
 		int display_w, display_h;
 		SDL_GL_GetDrawableSize(window, &display_w, &display_h);
@@ -337,6 +337,35 @@ int main(int argc, char* argv[])
 		SDL_GL_SwapWindow(window);
 	}
 
+	control.stop();
+	emulator.stop();
+
+	//control thread has exited, so the robot's counters are final and safe to read here
+	static CommsStatsSnapshot final_stats;
+	final_stats.num_motors = (int)robot.motors.size();
+	for (int i = 0; i < final_stats.num_motors && i < MAX_MOTORS; i++)
+	{
+		final_stats.motors[i] = robot.motors[i].stats;
+	}
+	comms_stats_print(stdout, final_stats.motors, final_stats.num_motors);
+	comms_stats_dump_csv("comms_stats.csv", final_stats.motors, final_stats.num_motors);
+
+	if (robot.recorder != nullptr)
+	{
+		robot.recorder = nullptr;
+		recorder.close();
+		printf("Recorder: %llu rows written, %llu dropped\n",
+			(unsigned long long)recorder.rows_written(), (unsigned long long)recorder.rows_dropped());
+	}
+
+	if (udp_capture != nullptr)
+	{
+		udp_capture = nullptr;
+		capture.close();
+		printf("Capture: %llu packets written, %llu dropped\n",
+			(unsigned long long)capture.packets_written(), (unsigned long long)capture.packets_dropped());
+	}
+
 	// Save UI settings back to config
 	// save_dartt_config("config.json", config);
 
@@ -31,6 +31,28 @@ Motor::Motor(unsigned char addr)
 	ds.blocking_rx_callback = &rx_blocking;
 	ds.user_context_rx = (void*)(&socket);
 	ds.timeout_ms = 10;
+
+	socket.socket = TCS_SOCKET_INVALID;
+	socket.connected = false;
+	socket.mode = UDP_MODE_BLOCKING;
+	socket.awaiting_reply = false;
+	socket.rx_pending_len = 0;
+	socket.tx_staged_len = 0;
+	socket.rx_timeout_ms = -1;
+	socket.tx_time_ns = 0;
+	socket.rx_time_ns = 0;
+	socket.rx_status = 0;
+	socket.tx_seq = 0;
+	socket.rx_seq = 0;
+	socket.seq_tx_ns = 0;
+	socket.stale_replies = 0;
+	socket.duplicate_replies = 0;
+	socket.late_rtt_max_us = 0;
+	socket.peer_addr = 0;
+	socket.local_port = 0;
+
+	stats.clear();
+	timeout.init(ds.timeout_ms * 1000, 1000, 50000);
 }
 
 
@@ -43,7 +65,7 @@ Motor::~Motor()
 
 Motor::Motor(Motor&& other) noexcept
     : dp_ctl(other.dp_ctl), dp_periph(other.dp_periph),
-      ds(other.ds), socket(other.socket)
+      ds(other.ds), socket(other.socket), stats(other.stats), timeout(other.timeout)
 {
     ds.ctl_base.buf    = (unsigned char*)(&dp_ctl);
     ds.periph_base.buf = (unsigned char*)(&dp_periph);
@@ -65,7 +87,7 @@ Motor& Motor::operator=(Motor&& other) noexcept
     delete[] ds.rx_buf.buf;
     udp_disconnect(&socket);
     dp_ctl = other.dp_ctl; dp_periph = other.dp_periph;
-    ds = other.ds; socket = other.socket;
+    ds = other.ds; socket = other.socket; stats = other.stats; timeout = other.timeout;
     ds.ctl_base.buf    = (unsigned char*)(&dp_ctl);
     ds.periph_base.buf = (unsigned char*)(&dp_periph);
     ds.user_context_tx = (void*)(&socket);
@@ -6,6 +6,7 @@
 #include "dartt_sync.h"
 #include "tinycsocket.h"
 #include "dartt_init.h"
+#include "comms_stats.h"
 
 class Motor
 {
@@ -14,6 +15,8 @@ public:
 	dartt_mctl_params_t dp_periph;
 	dartt_sync_t ds;
 	UdpState socket;
+	MotorCommsStats stats;	//cycle-path transaction accounting, see SpoolerRobot::transact
+	AdaptiveTimeout timeout;	//reply timeout learned from this motor's RTTs; drives ds.timeout_ms
 
 	Motor(unsigned char addr);
 	~Motor();
@@ -0,0 +1,298 @@
+#include "packet_capture.h"
+#include <cstring>
+#include <chrono>
+
+PacketCapture* udp_capture = nullptr;
+
+//pcapng block types and options
+#define PCAPNG_SHB 0x0A0D0D0Au
+#define PCAPNG_IDB 0x00000001u
+#define PCAPNG_EPB 0x00000006u
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4Du
+#define PCAPNG_OPT_END 0
+#define PCAPNG_OPT_SHB_USERAPPL 4
+#define PCAPNG_OPT_IF_NAME 2
+#define PCAPNG_OPT_IF_TSRESOL 9
+#define PCAPNG_OPT_EPB_FLAGS 2
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_USER0 147
+
+#define IPV4_UDP_HEADER_LEN 28
+
+int64_t capture_realtime_ns(void)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+PacketCapture::PacketCapture()
+	: f(NULL)
+	, ring()
+	, head(0)
+	, tail(0)
+	, dropped(0)
+	, written(0)
+	, writer()
+	, running(false)
+{
+}
+
+PacketCapture::~PacketCapture()
+{
+	close();
+}
+
+bool PacketCapture::open(const char* path)
+{
+	if (f != NULL)
+	{
+		return true;
+	}
+	f = fopen(path, "wb");
+	if (f == NULL)
+	{
+		printf("Capture: failed to open %s\n", path);
+		return false;
+	}
+	ring.resize(CAPTURE_RING_SLOTS);	//all the memory the capture will ever use, up front
+	head.store(0);
+	tail.store(0);
+	dropped.store(0);
+	written.store(0);
+	write_headers();
+	running.store(true);
+	writer = std::thread(&PacketCapture::run, this);
+	printf("Capture: writing %s\n", path);
+	return true;
+}
+
+void PacketCapture::close(void)
+{
+	running.store(false);
+	if (writer.joinable())
+	{
+		writer.join();
+	}
+	if (f != NULL)
+	{
+		drain();
+		fclose(f);
+		f = NULL;
+	}
+}
+
+bool PacketCapture::is_open(void) const
+{
+	return f != NULL;
+}
+
+uint64_t PacketCapture::packets_written(void) const
+{
+	return written.load();
+}
+
+uint64_t PacketCapture::packets_dropped(void) const
+{
+	return dropped.load();
+}
+
+void PacketCapture::record(capture_dir_t dir, capture_layer_t layer, uint32_t peer_addr, uint16_t peer_port,
+	uint16_t local_port, const unsigned char* data, size_t len, int64_t ts_ns)
+{
+	if (ring.empty())
+	{
+		return;
+	}
+	uint32_t h = head.load(std::memory_order_relaxed);
+	if (h - tail.load(std::memory_order_acquire) >= (uint32_t)ring.size())
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	CaptureRecord& r = ring[h & (CAPTURE_RING_SLOTS - 1)];
+	if (len > CAPTURE_SLOT_DATA)
+	{
+		len = CAPTURE_SLOT_DATA;
+	}
+	r.ts_ns = ts_ns;
+	r.peer_addr = peer_addr;
+	r.peer_port = peer_port;
+	r.local_port = local_port;
+	r.len = (uint16_t)len;
+	r.dir = (uint8_t)dir;
+	r.layer = (uint8_t)layer;
+	memcpy(r.data, data, len);
+	head.store(h + 1, std::memory_order_release);
+}
+
+void PacketCapture::run(void)
+{
+	while (running.load())
+	{
+		drain();
+		fflush(f);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+}
+
+void PacketCapture::drain(void)
+{
+	uint32_t t = tail.load(std::memory_order_relaxed);
+	uint32_t h = head.load(std::memory_order_acquire);
+	while (t != h)
+	{
+		write_record(ring[t & (CAPTURE_RING_SLOTS - 1)]);
+		t++;
+		tail.store(t, std::memory_order_release);	//hand the slot back as soon as it is on its way to disk
+	}
+}
+
+static void put_u16(unsigned char* p, uint16_t v)
+{
+	memcpy(p, &v, 2);
+}
+
+static void put_u32(unsigned char* p, uint32_t v)
+{
+	memcpy(p, &v, 4);
+}
+
+static void put_be16(unsigned char* p, uint16_t v)
+{
+	p[0] = (unsigned char)(v >> 8);
+	p[1] = (unsigned char)v;
+}
+
+static void put_be32(unsigned char* p, uint32_t v)
+{
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+//string option padded to 32 bits; returns bytes written
+static size_t put_string_opt(unsigned char* p, uint16_t code, const char* s)
+{
+	size_t len = strlen(s);
+	size_t padded = (len + 3) & ~(size_t)3;
+	put_u16(p, code);
+	put_u16(p + 2, (uint16_t)len);
+	memset(p + 4, 0, padded);
+	memcpy(p + 4, s, len);
+	return 4 + padded;
+}
+
+static void write_idb(FILE* f, uint16_t linktype, const char* name)
+{
+	unsigned char b[64];
+	size_t n = 0;
+	put_u32(b + n, PCAPNG_IDB); n += 4;
+	n += 4;	//length, filled in below
+	put_u16(b + n, linktype); n += 2;
+	put_u16(b + n, 0); n += 2;
+	put_u32(b + n, 0); n += 4;	//no snaplen limit
+	n += put_string_opt(b + n, PCAPNG_OPT_IF_NAME, name);
+	put_u16(b + n, PCAPNG_OPT_IF_TSRESOL); put_u16(b + n + 2, 1);
+	b[n + 4] = 9; b[n + 5] = 0; b[n + 6] = 0; b[n + 7] = 0;	//10^-9 s
+	n += 8;
+	put_u32(b + n, PCAPNG_OPT_END); n += 4;
+	n += 4;
+	put_u32(b + 4, (uint32_t)n);
+	put_u32(b + n - 4, (uint32_t)n);
+	fwrite(b, 1, n, f);
+}
+
+void PacketCapture::write_headers(void)
+{
+	unsigned char b[64];
+	size_t n = 0;
+	put_u32(b + n, PCAPNG_SHB); n += 4;
+	n += 4;
+	put_u32(b + n, PCAPNG_BYTE_ORDER_MAGIC); n += 4;
+	put_u16(b + n, 1); put_u16(b + n + 2, 0); n += 4;	//version 1.0
+	uint64_t section_len = UINT64_MAX;	//unknown
+	memcpy(b + n, &section_len, 8); n += 8;
+	n += put_string_opt(b + n, PCAPNG_OPT_SHB_USERAPPL, "spooler-controller");
+	put_u32(b + n, PCAPNG_OPT_END); n += 4;
+	n += 4;
+	put_u32(b + 4, (uint32_t)n);
+	put_u32(b + n - 4, (uint32_t)n);
+	fwrite(b, 1, n, f);
+
+	write_idb(f, LINKTYPE_IPV4, "udp");	//interface 0, CAPTURE_WIRE
+	write_idb(f, LINKTYPE_USER0, "dartt");	//interface 1, CAPTURE_FRAME
+}
+
+static uint16_t ipv4_checksum(const unsigned char* h)
+{
+	uint32_t sum = 0;
+	for (int i = 0; i < 20; i += 2)
+	{
+		sum += ((uint32_t)h[i] << 8) | h[i + 1];
+	}
+	while (sum >> 16)
+	{
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+	return (uint16_t)~sum;
+}
+
+void PacketCapture::write_record(const CaptureRecord& r)
+{
+	unsigned char pkt[IPV4_UDP_HEADER_LEN + CAPTURE_SLOT_DATA];
+	size_t pkt_len = 0;
+	if (r.layer == CAPTURE_WIRE)
+	{
+		//synthesized IPv4 + UDP header. The local address is not tracked, so that end shows as 0.0.0.0
+		uint32_t src = (r.dir == CAPTURE_TX) ? 0 : r.peer_addr;
+		uint32_t dst = (r.dir == CAPTURE_TX) ? r.peer_addr : 0;
+		uint16_t sport = (r.dir == CAPTURE_TX) ? r.local_port : r.peer_port;
+		uint16_t dport = (r.dir == CAPTURE_TX) ? r.peer_port : r.local_port;
+		unsigned char* ip = pkt;
+		memset(ip, 0, IPV4_UDP_HEADER_LEN);
+		ip[0] = 0x45;
+		put_be16(ip + 2, (uint16_t)(IPV4_UDP_HEADER_LEN + r.len));
+		ip[6] = 0x40;	//don't fragment
+		ip[8] = 64;
+		ip[9] = 17;	//UDP
+		put_be32(ip + 12, src);
+		put_be32(ip + 16, dst);
+		put_be16(ip + 10, ipv4_checksum(ip));
+		unsigned char* udp = pkt + 20;
+		put_be16(udp, sport);
+		put_be16(udp + 2, dport);
+		put_be16(udp + 4, (uint16_t)(8 + r.len));	//checksum left 0, which IPv4 allows
+		memcpy(pkt + IPV4_UDP_HEADER_LEN, r.data, r.len);
+		pkt_len = IPV4_UDP_HEADER_LEN + r.len;
+	}
+	else
+	{
+		memcpy(pkt, r.data, r.len);
+		pkt_len = r.len;
+	}
+
+	size_t padded = (pkt_len + 3) & ~(size_t)3;
+	uint32_t block_len = (uint32_t)(28 + padded + 12 + 4);	//header, data, epb_flags + end, trailing length
+	unsigned char hdr[28];
+	put_u32(hdr, PCAPNG_EPB);
+	put_u32(hdr + 4, block_len);
+	put_u32(hdr + 8, r.layer == CAPTURE_WIRE ? 0 : 1);
+	put_u32(hdr + 12, (uint32_t)((uint64_t)r.ts_ns >> 32));
+	put_u32(hdr + 16, (uint32_t)((uint64_t)r.ts_ns));
+	put_u32(hdr + 20, (uint32_t)pkt_len);
+	put_u32(hdr + 24, (uint32_t)pkt_len);
+	fwrite(hdr, 1, sizeof(hdr), f);
+
+	memset(pkt + pkt_len, 0, padded - pkt_len);
+	fwrite(pkt, 1, padded, f);
+
+	unsigned char tail_b[16];
+	put_u16(tail_b, PCAPNG_OPT_EPB_FLAGS);
+	put_u16(tail_b + 2, 4);
+	put_u32(tail_b + 4, r.dir == CAPTURE_RX ? 1u : 2u);	//bits 0-1: 1 inbound, 2 outbound
+	put_u32(tail_b + 8, PCAPNG_OPT_END);
+	put_u32(tail_b + 12, block_len);
+	fwrite(tail_b, 1, sizeof(tail_b), f);
+
+	written.fetch_add(1, std::memory_order_relaxed);
+}
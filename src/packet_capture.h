@@ -0,0 +1,87 @@
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*
+	Opt-in capture of the DARTT traffic to a pcapng file that opens in Wireshark.
+
+	Two interfaces are written:
+		0 "udp"   - every datagram as it went on the wire (COBS encoded), wrapped in a
+		            synthesized IPv4/UDP header so Wireshark shows peers, ports and timing
+		1 "dartt" - every DARTT frame before COBS encoding (tx) and after decoding (rx),
+		            as LINKTYPE_USER0
+	Direction is carried in the epb_flags option. Timestamps are ns since the epoch: the kernel
+	receive time (SO_TIMESTAMPNS) where the transport has it, otherwise the time of the call.
+
+	record() copies into a preallocated ring and never blocks; a writer thread drains the ring to
+	disk. One producer only - all robot socket traffic runs on the control thread. If the writer
+	falls behind, records are dropped and counted rather than stalling the caller.
+*/
+#define CAPTURE_SLOT_DATA 128	//largest datagram we send or receive is 64 bytes
+#define CAPTURE_RING_SLOTS 8192	//power of two
+
+typedef enum {CAPTURE_TX, CAPTURE_RX} capture_dir_t;
+typedef enum {CAPTURE_WIRE, CAPTURE_FRAME} capture_layer_t;
+
+struct CaptureRecord
+{
+	int64_t ts_ns;
+	uint32_t peer_addr;	//IPv4, host order
+	uint16_t peer_port;
+	uint16_t local_port;
+	uint16_t len;
+	uint8_t dir;	//capture_dir_t
+	uint8_t layer;	//capture_layer_t
+	unsigned char data[CAPTURE_SLOT_DATA];
+};
+
+class PacketCapture
+{
+public:
+	PacketCapture();
+	~PacketCapture();
+
+	PacketCapture(const PacketCapture&) = delete;
+	PacketCapture& operator=(const PacketCapture&) = delete;
+
+	// Create the file, write the pcapng headers and start the writer thread
+	bool open(const char* path);
+	// Stop the writer after it has drained everything recorded so far, and close the file
+	void close(void);
+	bool is_open(void) const;
+
+	void record(capture_dir_t dir, capture_layer_t layer, uint32_t peer_addr, uint16_t peer_port,
+		uint16_t local_port, const unsigned char* data, size_t len, int64_t ts_ns);
+
+	uint64_t packets_written(void) const;
+	uint64_t packets_dropped(void) const;
+
+private:
+	FILE* f;
+	std::vector<CaptureRecord> ring;
+	std::atomic<uint32_t> head;	//next slot the producer fills
+	std::atomic<uint32_t> tail;	//next slot the writer drains
+	std::atomic<uint64_t> dropped;
+	std::atomic<uint64_t> written;
+	std::thread writer;
+	std::atomic<bool> running;
+
+	void run(void);
+	void drain(void);
+	void write_headers(void);
+	void write_record(const CaptureRecord& r);
+};
+
+// When set to an open capture, the UdpState transports and UdpBatchTransport record into it
+extern PacketCapture* udp_capture;
+
+// Wall-clock ns since the epoch, for records without a kernel timestamp
+int64_t capture_realtime_ns(void);
+
+#endif // PACKET_CAPTURE_H
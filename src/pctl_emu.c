@@ -0,0 +1,66 @@
+#include "pctl_emu.h"
+
+static inline int32_t sat_i64(int64_t v, int32_t lim)
+{
+	if (v > lim)
+		return lim;
+	if (v < -(int64_t)lim)
+		return -lim;
+	return (int32_t)v;
+}
+
+/*
+	radix and out_rshift come off the wire unchecked; shifting a 64-bit value by a negative
+	amount or by 64 or more is undefined, so they are clamped to [0, 63].
+*/
+static inline int shift_amount(int32_t s)
+{
+	if (s < 0)
+		return 0;
+	if (s > 63)
+		return 63;
+	return (int)s;
+}
+
+static inline int32_t mul_radix(i32_t g, int32_t v)
+{
+	return (int32_t)(((int64_t)g.i32 * v) >> shift_amount(g.radix));
+}
+
+/*
+	Shared by both PI flavours: x is the integrator, updated in place.
+	x_sat < 0 would make the clamp meaningless, so it is taken as 0 (integrator off).
+*/
+static inline int32_t pi_update(i32_t kp, i32_t ki, int32_t x_integral_div, int32_t x_sat, uint8_t out_rshift, int32_t err, int32_t * x)
+{
+	int32_t lim = x_sat > 0 ? x_sat : 0;
+	int32_t xi = sat_i64((int64_t)(*x) + err, lim);
+	*x = xi;
+	int32_t div = x_integral_div > 0 ? x_integral_div : 1;
+	int64_t out = (int64_t)mul_radix(kp, err) + mul_radix(ki, xi / div);
+	return (int32_t)(out >> shift_amount(out_rshift));
+}
+
+int32_t fixed_pi_2_step(fixed_PI_2_params_t * p, int32_t err)
+{
+	return pi_update(p->kp, p->ki, p->x_integral_div, p->x_sat, p->out_rshift, err, &p->x);
+}
+
+int32_t fixed_pi_step(const fixed_PI_params_t * p, int32_t err, int32_t * x)
+{
+	return pi_update(p->kp, p->ki, p->x_integral_div, p->x_sat, p->out_rshift, err, x);
+}
+
+int32_t pctl_step(pctl_params_t * p, int32_t err, int32_t dtheta)
+{
+	int64_t out = (int64_t)fixed_pi_2_step(&p->kpki, err) - mul_radix(p->kd, dtheta);
+	return sat_i64(out, p->out_sat > 0 ? p->out_sat : 0);
+}
+
+void pctl_run(pctl_params_t * p, const int32_t * err, const int32_t * dtheta, int32_t * out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = pctl_step(p, err[i], dtheta[i]);
+	}
+}
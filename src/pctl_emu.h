@@ -0,0 +1,44 @@
+#ifndef PCTL_EMU_H
+#define PCTL_EMU_H
+#include <stdint.h>
+#include <stddef.h>
+#include "pctl.h"
+#include "profiles.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+	Host-side model of the device's fixed-point PI/PD updates, operating directly on the
+	structs that go over DARTT (mctl_iq/mctl_vq, fds_mp.iq_pi/id_pi), so a gain set read
+	from or about to be written to a motor can be stepped offline.
+
+	Integer-only. The update law below was reconstructed from the parameter structs without
+	the firmware source, so its order of operations (and with it the rounding) is unverified
+	against the device; do not rely on it being bit-exact:
+		x   += err, clamped to +-x_sat             (integrator, in error units)
+		out  = (kp * err) >> kp.radix
+		     + (ki * (x / x_integral_div)) >> ki.radix
+		out >>= out_rshift
+	pctl adds the damping term -(kd * dtheta) >> kd.radix and clamps to +-out_sat.
+	Products are formed in 64 bits, shifts are arithmetic (floor) and / truncates toward
+	zero, as on the Cortex-M. x_integral_div <= 0 is treated as 1 instead of faulting, and
+	radix/out_rshift outside [0, 63] are clamped into it rather than shifting out of range.
+*/
+
+// One PI update; the integrator is p->x, as on the device
+int32_t fixed_pi_2_step(fixed_PI_2_params_t * p, int32_t err);
+// Same update for fixed_PI_params_t, whose integrator lives outside the struct
+int32_t fixed_pi_step(const fixed_PI_params_t * p, int32_t err, int32_t * x);
+// Full position loop: PI on err, damping on the measured rate dtheta, clamped to out_sat
+int32_t pctl_step(pctl_params_t * p, int32_t err, int32_t dtheta);
+
+// Step pctl over recorded sequences, e.g. to compare gain sets on logged data. out may alias err.
+void pctl_run(pctl_params_t * p, const int32_t * err, const int32_t * dtheta, int32_t * out, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PCTL_EMU_H
@@ -0,0 +1,172 @@
+#ifndef PLOT_CHANNELS_H
+#define PLOT_CHANNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ring_buffer.h"
+
+// Handle to a timebase: one shared time column in a PlotChannels store
+struct PlotTimebase
+{
+	int32_t index = -1;
+
+	bool valid(void) const { return index >= 0; }
+};
+
+// Handle to a channel: one value column on a timebase
+struct PlotChannel
+{
+	int32_t timebase = -1;
+	int32_t column = -1;
+
+	bool valid(void) const { return timebase >= 0 && column >= 0; }
+};
+
+/*
+	Columnar sample store for the plotter. A timebase is one time column plus one value
+	column per channel, all RingBuffer<float> of the same capacity that are pushed, resized
+	and cleared together, so row i is slot t.slot(i) in every column of it. Channels that are
+	sampled together (the p, iq and dp of one motor's reply) share a timebase and store their
+	timestamp once: 4 bytes per value plus 4 per row, instead of an 8 byte (t, v) point per
+	value. Each column is contiguous, so it can be scaled or uploaded in one pass.
+
+	Handles are indices, so they stay valid as the store grows, and they are checked: a
+	stale or default handle reads as an empty column rather than through a dangling pointer.
+	Adding timebases or channels allocates; append() does not.
+*/
+class PlotChannels
+{
+public:
+	PlotTimebase add_timebase(size_t capacity)
+	{
+		bases.emplace_back();
+		bases.back().t.set_capacity(capacity);
+		PlotTimebase tb;
+		tb.index = (int32_t)bases.size() - 1;
+		return tb;
+	}
+
+	// New value column on tb. The timebase is cleared so every column stays row-aligned.
+	PlotChannel add_channel(PlotTimebase tb)
+	{
+		PlotChannel ch;
+		if (!has(tb))
+		{
+			return ch;
+		}
+		Timebase& b = bases[tb.index];
+		b.v.emplace_back();
+		b.v.back().set_capacity(b.t.capacity());
+		clear(tb);
+		ch.timebase = tb.index;
+		ch.column = (int32_t)b.v.size() - 1;
+		return ch;
+	}
+
+	// Resize every column of tb, keeping the newest rows
+	void set_capacity(PlotTimebase tb, size_t n)
+	{
+		if (!has(tb))
+		{
+			return;
+		}
+		Timebase& b = bases[tb.index];
+		b.t.set_capacity(n);
+		for (RingBuffer<float>& v : b.v)
+		{
+			v.set_capacity(n);
+		}
+	}
+
+	void clear(PlotTimebase tb)
+	{
+		if (!has(tb))
+		{
+			return;
+		}
+		Timebase& b = bases[tb.index];
+		b.t.clear();
+		for (RingBuffer<float>& v : b.v)
+		{
+			v.clear();
+		}
+	}
+
+	/*
+		One row: time t and one value per channel of tb, in add_channel order. When full the
+		oldest row is dropped. A time earlier than the newest row clears tb first, as a Line
+		does when its time source goes backwards.
+	*/
+	void append(PlotTimebase tb, float t, const float* values)
+	{
+		if (!has(tb))
+		{
+			return;
+		}
+		Timebase& b = bases[tb.index];
+		if (!b.t.empty() && t < b.t.back())
+		{
+			clear(tb);
+		}
+		b.t.push(t);
+		for (size_t c = 0; c < b.v.size(); c++)
+		{
+			b.v[c].push(values[c]);
+		}
+	}
+
+	size_t num_timebases(void) const
+	{
+		return bases.size();
+	}
+
+	int num_channels(PlotTimebase tb) const
+	{
+		return has(tb) ? (int)bases[tb.index].v.size() : 0;
+	}
+
+	PlotTimebase timebase_of(PlotChannel ch) const
+	{
+		PlotTimebase tb;
+		tb.index = ch.timebase;
+		return tb;
+	}
+
+	bool has(PlotTimebase tb) const
+	{
+		return tb.index >= 0 && tb.index < (int32_t)bases.size();
+	}
+
+	bool has(PlotChannel ch) const
+	{
+		return ch.timebase >= 0 && ch.timebase < (int32_t)bases.size()
+			&& ch.column >= 0 && ch.column < (int32_t)bases[ch.timebase].v.size();
+	}
+
+	const RingBuffer<float>& time(PlotTimebase tb) const
+	{
+		return has(tb) ? bases[tb.index].t : empty;
+	}
+
+	const RingBuffer<float>& time(PlotChannel ch) const
+	{
+		return time(timebase_of(ch));
+	}
+
+	const RingBuffer<float>& values(PlotChannel ch) const
+	{
+		return has(ch) ? bases[ch.timebase].v[ch.column] : empty;
+	}
+
+private:
+	struct Timebase
+	{
+		RingBuffer<float> t;
+		std::vector<RingBuffer<float>> v;
+	};
+	std::vector<Timebase> bases;
+	RingBuffer<float> empty;
+};
+
+#endif // PLOT_CHANNELS_H
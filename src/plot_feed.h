@@ -0,0 +1,26 @@
+#ifndef PLOT_FEED_H
+#define PLOT_FEED_H
+
+#include <cstdint>
+#include "spsc_queue.h"
+
+/*
+	One motor's telemetry as it arrived, for the plotter. The control thread pushes one per
+	answered motor per cycle (SpoolerRobot::plot_feed), stamped with the reply's receive time,
+	and the GUI drains everything queued since its last frame, so the plot runs at the
+	control rate instead of being resampled at vsync.
+*/
+struct PlotSample
+{
+	int64_t t_ns;	//udp_now_ns() clock: when the reply was received (when the plant step returned, in simulation)
+	int32_t motor;
+	float p;	//degrees
+	float iq;
+	float dp;
+};
+
+// Control thread -> GUI. 16384 samples is 8 s of two motors at 1 kHz, far more than a frame.
+#define PLOT_FEED_CAPACITY 16384
+typedef SpscQueue<PlotSample> PlotFeed;
+
+#endif // PLOT_FEED_H
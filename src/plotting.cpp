@@ -15,20 +15,50 @@
 #ifndef GL_LINE_STRIP
 #define GL_LINE_STRIP 0x0003
 #endif
+#ifndef GL_DYNAMIC_DRAW
+#define GL_DYNAMIC_DRAW 0x88E8
+#endif
+#ifndef APIENTRY
+#define APIENTRY
+#endif
 
 #include <vector>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <cmath>
 #include "plotting.h"
 
 // ============================================================================
-// Vertex format: position (float x2) + color (ubyte x4)
+// GL entry points not in the imgui loader: fetched through it at init on desktop
 // ============================================================================
-struct PlotVertex
+#if defined(__ANDROID__) || defined(IMGUI_IMPL_OPENGL_ES3)
+#define plot_glDrawArrays glDrawArrays
+#define plot_glBufferSubData glBufferSubData
+#define plot_glUniform2f glUniform2f
+#define plot_glUniform4f glUniform4f
+static bool load_plot_gl(void)
+{
+	return true;
+}
+#else
+typedef void (APIENTRY *plot_glDrawArrays_t)(GLenum mode, GLint first, GLsizei count);
+typedef void (APIENTRY *plot_glBufferSubData_t)(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+typedef void (APIENTRY *plot_glUniform2f_t)(GLint location, GLfloat v0, GLfloat v1);
+typedef void (APIENTRY *plot_glUniform4f_t)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+static plot_glDrawArrays_t plot_glDrawArrays = nullptr;
+static plot_glBufferSubData_t plot_glBufferSubData = nullptr;
+static plot_glUniform2f_t plot_glUniform2f = nullptr;
+static plot_glUniform4f_t plot_glUniform4f = nullptr;
+static bool load_plot_gl(void)
 {
-	float x, y;
-	uint8_t r, g, b, a;
-};
+	plot_glDrawArrays = (plot_glDrawArrays_t)imgl3wGetProcAddress("glDrawArrays");
+	plot_glBufferSubData = (plot_glBufferSubData_t)imgl3wGetProcAddress("glBufferSubData");
+	plot_glUniform2f = (plot_glUniform2f_t)imgl3wGetProcAddress("glUniform2f");
+	plot_glUniform4f = (plot_glUniform4f_t)imgl3wGetProcAddress("glUniform4f");
+	return plot_glDrawArrays && plot_glBufferSubData && plot_glUniform2f && plot_glUniform4f;
+}
+#endif
 
 // ============================================================================
 // Shader sources
@@ -36,21 +66,31 @@ struct PlotVertex
 #if defined(__ANDROID__) || defined(IMGUI_IMPL_OPENGL_ES3)
 #define GLSL_VERSION "#version 300 es\n"
 #define GLSL_PRECISION "precision mediump float;\n"
+#define GLSL_VERT_PRECISION "precision highp float;\n"
 #else
 #define GLSL_VERSION "#version 130\n"
 #define GLSL_PRECISION ""
+#define GLSL_VERT_PRECISION ""
 #endif
 
+// (a_x, a_y) is a raw sample, read either from an fpoint_t buffer (stride 8) or from two
+// sample columns (stride 4). pixel = floor((sample - u_origin) * u_scale + u_offset), kept
+// one pixel inside the window, which is what build_vertices does on the CPU. Subtracting the
+// origin first keeps float precision when the timestamps are large.
 static const char* g_vert_src =
 	GLSL_VERSION
-	GLSL_PRECISION
-	"in vec2 a_pos;\n"
-	"in vec4 a_color;\n"
-	"out vec4 v_color;\n"
+	GLSL_VERT_PRECISION
+	"in float a_x;\n"
+	"in float a_y;\n"
 	"uniform mat4 u_proj;\n"
+	"uniform vec2 u_origin;\n"
+	"uniform vec2 u_scale;\n"
+	"uniform vec2 u_offset;\n"
+	"uniform vec2 u_window;\n"
 	"void main() {\n"
-	"  gl_Position = u_proj * vec4(a_pos, 0.0, 1.0);\n"
-	"  v_color = a_color;\n"
+	"  vec2 p = floor((vec2(a_x, a_y) - u_origin) * u_scale + u_offset);\n"
+	"  p = clamp(p, vec2(1.0), u_window - vec2(1.0));\n"
+	"  gl_Position = u_proj * vec4(p, 0.0, 1.0);\n"
 	"}\n";
 
 static const char* g_frag_src =
@@ -59,12 +99,12 @@ static const char* g_frag_src =
 #if defined(__ANDROID__) || defined(IMGUI_IMPL_OPENGL_ES3)
 	"out vec4 fragColor;\n"
 #endif
-	"in vec4 v_color;\n"
+	"uniform vec4 u_color;\n"
 	"void main() {\n"
 #if defined(__ANDROID__) || defined(IMGUI_IMPL_OPENGL_ES3)
-	"  fragColor = v_color;\n"
+	"  fragColor = u_color;\n"
 #else
-	"  gl_FragColor = v_color;\n"
+	"  gl_FragColor = u_color;\n"
 #endif
 	"}\n";
 
@@ -110,14 +150,22 @@ fpoint_t::fpoint_t(float x_val, float y_val)
 Line::Line()
 	: points()
 	, color()
-	, xsource(NULL)
-	, ysource(NULL)
+	, channel()
+	, x_channel()
 	, mode(TIME_MODE)
 	, xscale(1.f)
 	, xoffset(0.f)
 	, yscale(1.f)
 	, yoffset(0.f)
 	, enqueue_cap(2000)
+	, columns()
+	, col_bucket(0)
+	, history()
+	, col_fill(0)
+	, col_lo()
+	, col_hi()
+	, seen_pushed(0)
+	, seen_generation(UINT64_MAX)
 {
 	color.r = 0;
 	color.g = 0;
@@ -126,21 +174,30 @@ Line::Line()
 }
 
 Line::Line(int capacity)
-	: points(capacity)
+	: points()
 	, color()
-	, xsource(NULL)
-	, ysource(NULL)
+	, channel()
+	, x_channel()
 	, mode(TIME_MODE)
 	, xscale(1.f)
 	, xoffset(0.f)
 	, yscale(1.f)
 	, yoffset(0.f)
-	, enqueue_cap(2000)
+	, enqueue_cap((uint32_t)capacity)
+	, columns()
+	, col_bucket(0)
+	, history()
+	, col_fill(0)
+	, col_lo()
+	, col_hi()
+	, seen_pushed(0)
+	, seen_generation(UINT64_MAX)
 {
 	color.r = 0;
 	color.g = 0;
 	color.b = 0;
 	color.a = 0xFF;
+	points.set_capacity(enqueue_cap);
 }
 
 // ============================================================================
@@ -151,12 +208,24 @@ Plotter::Plotter()
 	, window_height(0)
 	, num_widths(1)
 	, lines()
+	, channels()
 	, sys_sec(0.0f)
-	, m_vbo(0)
-	, m_ebo(0)
+	, view_seconds(0.0f)
+	, view_mean(false)
+	, m_line_gpu()
+	, m_column_gpu()
+	, m_views()
+	, m_view_bins()
 	, m_vao(0)
 	, m_shader(0)
+	, m_a_x(-1)
+	, m_a_y(-1)
 	, m_u_proj(-1)
+	, m_u_origin(-1)
+	, m_u_scale(-1)
+	, m_u_offset(-1)
+	, m_u_window(-1)
+	, m_u_color(-1)
 	, m_gl_ready(false)
 {
 }
@@ -168,6 +237,12 @@ Plotter::~Plotter()
 
 bool Plotter::init_gl_resources()
 {
+	if (!load_plot_gl())
+	{
+		printf("Plotter: missing GL entry points\n");
+		return false;
+	}
+
 	// Compile shaders
 	GLuint vs = compile_shader(GL_VERTEX_SHADER, g_vert_src);
 	GLuint fs = compile_shader(GL_FRAGMENT_SHADER, g_frag_src);
@@ -195,30 +270,22 @@ bool Plotter::init_gl_resources()
 		return false;
 	}
 
+	m_a_x = glGetAttribLocation(m_shader, "a_x");
+	m_a_y = glGetAttribLocation(m_shader, "a_y");
 	m_u_proj = glGetUniformLocation(m_shader, "u_proj");
-	GLint a_pos_loc = glGetAttribLocation(m_shader, "a_pos");
-	GLint a_color_loc = glGetAttribLocation(m_shader, "a_color");
-
-	// Create VAO, VBO, EBO
+	m_u_origin = glGetUniformLocation(m_shader, "u_origin");
+	m_u_scale = glGetUniformLocation(m_shader, "u_scale");
+	m_u_offset = glGetUniformLocation(m_shader, "u_offset");
+	m_u_window = glGetUniformLocation(m_shader, "u_window");
+	m_u_color = glGetUniformLocation(m_shader, "u_color");
+
+	// One VAO; each draw points a_x and a_y at the buffers it reads. The buffers themselves
+	// are made on first render, per line and per sample column.
 	glGenVertexArrays(1, &m_vao);
-	glGenBuffers(1, &m_vbo);
-	glGenBuffers(1, &m_ebo);
-
 	glBindVertexArray(m_vao);
-
-	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-	// attr 0: a_pos — 2 floats at offset 0
-	glVertexAttribPointer(a_pos_loc, 2, GL_FLOAT, GL_FALSE, sizeof(PlotVertex), (void*)0);
-	glEnableVertexAttribArray(a_pos_loc);
-	// attr 1: a_color — 4 ubytes normalized at offset 8
-	glVertexAttribPointer(a_color_loc, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PlotVertex), (void*)(2 * sizeof(float)));
-	glEnableVertexAttribArray(a_color_loc);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-
+	glEnableVertexAttribArray(m_a_x);
+	glEnableVertexAttribArray(m_a_y);
 	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 	m_gl_ready = true;
 	return true;
@@ -230,13 +297,34 @@ void Plotter::teardown_gl_resources()
 	{
 		return;
 	}
+	for (GpuRing& g : m_line_gpu)
+	{
+		release(g);
+	}
+	m_line_gpu.clear();
+	for (std::vector<GpuRing>& tb : m_column_gpu)
+	{
+		for (GpuRing& g : tb)
+		{
+			release(g);
+		}
+	}
+	m_column_gpu.clear();
 	if (m_vao) { glDeleteVertexArrays(1, &m_vao); m_vao = 0; }
-	if (m_vbo) { glDeleteBuffers(1, &m_vbo); m_vbo = 0; }
-	if (m_ebo) { glDeleteBuffers(1, &m_ebo); m_ebo = 0; }
 	if (m_shader) { glDeleteProgram(m_shader); m_shader = 0; }
 	m_gl_ready = false;
 }
 
+void Plotter::release(GpuRing& g)
+{
+	if (g.vbo) { glDeleteBuffers(1, &g.vbo); }
+	g.vbo = 0;
+	g.source = nullptr;
+	g.capacity = 0;
+	g.pushed = 0;
+	g.generation = 0;
+}
+
 bool Plotter::init(int width, int height)
 {
 	if (width <= 0 || height <= 0)
@@ -246,13 +334,9 @@ bool Plotter::init(int width, int height)
 
 	window_width = width;
 	window_height = height;
-	int line_capacity = 0;
-
 	// Initialize with one line
 	lines.resize(1);
-	lines[0].points.resize(line_capacity);
 	lines[0].points.clear();
-	lines[0].xsource = &sys_sec;
 	int color_idx = (lines.size() % NUM_COLORS);
 	lines[0].color = template_colors[color_idx];
 
@@ -280,12 +364,88 @@ int sat_pix_to_window(int val, int thresh)
 	return val;
 }
 
+SampleSource Plotter::samples_of(const Line& line) const
+{
+	SampleSource src;
+	src.points = nullptr;
+	src.xcol = nullptr;
+	src.ycol = nullptr;
+	if (!channels.has(line.channel))
+	{
+		src.points = &line.points;
+		return src;
+	}
+	src.ycol = &channels.values(line.channel);
+	if (line.mode == XY_MODE && channels.has(line.x_channel) && line.x_channel.timebase == line.channel.timebase)
+	{
+		src.xcol = &channels.values(line.x_channel);
+	}
+	else
+	{
+		src.xcol = &channels.time(line.channel);
+	}
+	return src;
+}
+
+void Plotter::update()
+{
+	for (Line& line : lines)
+	{
+		if (!channels.has(line.channel))
+		{
+			continue;
+		}
+		if (line.mode != TIME_MODE)
+		{
+			//rows that arrive meanwhile are folded in on return to time mode, as far as they are still held
+			if (line.col_bucket != 0)
+			{
+				line.columns.set_capacity(0);
+				line.col_bucket = 0;
+			}
+			continue;
+		}
+		const RingBuffer<float>& t = channels.time(line.channel);
+		bool reset = (t.generation() != line.seen_generation);
+		uint64_t n = t.pushed() - line.seen_pushed;
+		size_t fresh = (n < (uint64_t)t.size()) ? (size_t)n : t.size();
+		if (t.size() >= 2 && t.back() > t.front())
+		{
+			line.xscale = window_width / (t.back() - t.front());
+		}
+		line.fold(samples_of(line), fresh, reset, window_width);
+		line.seen_pushed = t.pushed();
+		line.seen_generation = t.generation();
+	}
+}
+
+Plotter::PlotTransform Plotter::transform_of(const Line& line, float x0) const
+{
+	PlotTransform tf;
+	tf.origin_y = 0.f;
+	tf.scale_x = line.xscale;
+	tf.scale_y = line.yscale;
+	tf.offset_y = line.yoffset + (float)window_height / 2.f;
+	if (line.mode == TIME_MODE)
+	{
+		tf.origin_x = x0;
+		tf.offset_x = 0.f;
+	}
+	else
+	{
+		tf.origin_x = 0.f;
+		tf.offset_x = line.xoffset + (float)window_width / 2.f;
+	}
+	return tf;
+}
+
 void Plotter::render()
 {
 	if (!m_gl_ready)
 	{
 		return;
 	}
+	update();
 
 	// Build orthographic projection matrix (column-major)
 	// Maps (0..window_width, 0..window_height) to clip space (-1..1)
@@ -302,90 +462,281 @@ void Plotter::render()
 	proj[13] = -(T + B) / (T - B);      // m[3][1]
 	proj[15] = 1.0f;                     // m[3][3]
 
+	//lines removed since the last frame give their buffers back
+	for (size_t i = lines.size(); i < m_line_gpu.size(); i++)
+	{
+		release(m_line_gpu[i]);
+	}
+	GpuRing blank = {0, nullptr, 0, 0, 0};
+	m_line_gpu.resize(lines.size(), blank);
+	m_views.resize(lines.size());
+	//one mirror per sample column, however many lines draw it, so each is uploaded once a frame
+	m_column_gpu.resize(channels.num_timebases());
+	for (size_t k = 0; k < m_column_gpu.size(); k++)
+	{
+		PlotTimebase tb;
+		tb.index = (int32_t)k;
+		m_column_gpu[k].resize(1 + channels.num_channels(tb), blank);
+	}
+
 	glUseProgram(m_shader);
 	glUniformMatrix4fv(m_u_proj, 1, GL_FALSE, proj);
+	plot_glUniform2f(m_u_window, (float)window_width, (float)window_height);
 	glBindVertexArray(m_vao);
 
-	// Temporary buffers for vertex + index data
-	static std::vector<PlotVertex> verts;
-	static std::vector<uint16_t> indices;
-
 	for (int i = 0; i < (int)lines.size(); i++)
 	{
-		Line* line = &lines[i];
-		int num_points = (int)line->points.size();
-
-		if (num_points < 2)
-		{
-			continue;
-		}
-
-		// Build vertex data
-		verts.resize(num_points);
-		indices.resize(num_points);
-		for (int j = 0; j < num_points; j++)
+		const Line& line = lines[i];
+		SampleSource src = samples_of(line);
+		bool history_view = (view_seconds > 0.f && line.mode == TIME_MODE && line.history.enabled());
+		size_t first = 0;
+		size_t n_first = 0;
+		size_t n_second = 0;
+		if (history_view || line.decimating() || src.points)
 		{
-			int x = 0;
-			int y = 0;
-			if (line->mode == TIME_MODE)
+			if (history_view)
 			{
-				x = (int)((line->points[j].x - line->points.front().x) * line->xscale);
-				y = (int)(line->points[j].y * line->yscale + line->yoffset + (float)window_height / 2.f);
+				build_history_view(line, m_views[i]);	//rebuilt every frame, so uploaded whole: O(window_width)
 			}
-			else
+			const RingBuffer<fpoint_t>& ring = history_view ? m_views[i] : (line.decimating() ? line.columns : line.points);
+			if (ring.capacity() == 0)
 			{
-				x = (int)(line->points[j].x * line->xscale + line->xoffset + (float)window_width / 2.f);
-				y = (int)(line->points[j].y * line->yscale + line->yoffset + (float)window_height / 2.f);
+				continue;
 			}
-			x = sat_pix_to_window(x, window_width);
-			y = sat_pix_to_window(y, window_width);
-
-			verts[j].x = (float)x;
-			verts[j].y = (float)y;
-			verts[j].r = line->color.r;
-			verts[j].g = line->color.g;
-			verts[j].b = line->color.b;
-			verts[j].a = line->color.a;
-
-			indices[j] = (uint16_t)j;
+			sync_ring(ring, (&ring == &line.columns) ? 2 : 0, m_line_gpu[i]);	//the newest column changes in place
+			glVertexAttribPointer(m_a_x, 1, GL_FLOAT, GL_FALSE, sizeof(fpoint_t), (void*)0);
+			glVertexAttribPointer(m_a_y, 1, GL_FLOAT, GL_FALSE, sizeof(fpoint_t), (void*)sizeof(float));
+			first = ring.slot(0);
+			ring.first_span(n_first);
+			ring.second_span(n_second);
+		}
+		else
+		{
+			//straight from the sample columns: the time (or x channel) column and the value column
+			std::vector<GpuRing>& gpu = m_column_gpu[line.channel.timebase];
+			if (src.ycol->capacity() == 0)
+			{
+				continue;
+			}
+			int xslot = (src.xcol == &channels.time(line.channel)) ? 0 : 1 + line.x_channel.column;
+			sync_ring(*src.xcol, 0, gpu[xslot]);
+			glVertexAttribPointer(m_a_x, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+			sync_ring(*src.ycol, 0, gpu[1 + line.channel.column]);
+			glVertexAttribPointer(m_a_y, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+			first = src.ycol->slot(0);
+			src.ycol->first_span(n_first);
+			src.ycol->second_span(n_second);
+		}
+		if (n_first + n_second < 2)
+		{
+			continue;
 		}
 
-		// Upload and draw
-		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-		glBufferData(GL_ARRAY_BUFFER, num_points * sizeof(PlotVertex), verts.data(), GL_STREAM_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, num_points * sizeof(uint16_t), indices.data(), GL_STREAM_DRAW);
-		glDrawElements(GL_LINE_STRIP, num_points, GL_UNSIGNED_SHORT, nullptr);
+		PlotTransform tf = transform_of(line, (src.size() > 0) ? src[0].x : 0.f);
+		if (history_view)
+		{
+			tf.origin_x = 0.f;	//x is already seconds into the window
+			tf.offset_x = 0.f;
+			tf.scale_x = (float)window_width / view_seconds;
+		}
+		plot_glUniform2f(m_u_origin, tf.origin_x, tf.origin_y);
+		plot_glUniform2f(m_u_offset, tf.offset_x, tf.offset_y);
+		plot_glUniform2f(m_u_scale, tf.scale_x, tf.scale_y);
+		plot_glUniform4f(m_u_color, line.color.r / 255.f, line.color.g / 255.f, line.color.b / 255.f, line.color.a / 255.f);
+		draw_strips(first, n_first, n_second);
 	}
 
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glUseProgram(0);
 }
 
+// A ring's strip from its oldest value at storage slot first: n_first values to the end of
+// the storage, then n_second from slot 0
+void Plotter::draw_strips(size_t first, size_t n_first, size_t n_second)
+{
+	if (n_second == 0)
+	{
+		plot_glDrawArrays(GL_LINE_STRIP, (GLint)first, (GLsizei)n_first);
+	}
+	else
+	{
+		//through the repeat of slot 0 at the end of the buffer, then on from slot 0
+		plot_glDrawArrays(GL_LINE_STRIP, (GLint)first, (GLsizei)(n_first + 1));
+		plot_glDrawArrays(GL_LINE_STRIP, 0, (GLsizei)n_second);
+	}
+}
 
-bool Line::enqueue_data(int screen_width)
+// Bring g up to date with ring and leave g's buffer bound: only the values pushed since the
+// last call, plus the newest tail values (which the owner may rewrite in place), are
+// uploaded, unless the ring was resized or cleared or g last mirrored a different ring
+template <typename T>
+void Plotter::sync_ring(const RingBuffer<T>& ring, size_t tail, GpuRing& g)
 {
-	if(xsource == NULL || ysource == NULL)
+	size_t cap = ring.capacity();
+	if (g.vbo == 0)
 	{
-		return false;	//fail due to bad pointer reference
+		glGenBuffers(1, &g.vbo);
+		g.capacity = 0;
 	}
-	//enqueue data
-	if(points.size() < enqueue_cap)	//cap on buffer width - may want to expand
+	glBindBuffer(GL_ARRAY_BUFFER, g.vbo);
+
+	size_t size = ring.size();
+	size_t fresh = size;
+	if (g.capacity != cap)
+	{
+		glBufferData(GL_ARRAY_BUFFER, (cap + 1) * sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+		g.capacity = cap;
+	}
+	else if (g.source == &ring && g.generation == ring.generation())
+	{
+		uint64_t n = ring.pushed() - g.pushed + tail;
+		fresh = (n < (uint64_t)size) ? (size_t)n : size;
+	}
+	if (fresh > 0)
+	{
+		upload_slots(ring, ring.slot(size - fresh), fresh);
+	}
+	g.source = &ring;
+	g.pushed = ring.pushed();
+	g.generation = ring.generation();
+}
+
+// n values starting at storage slot first, wrapping at the capacity
+template <typename T>
+void Plotter::upload_slots(const RingBuffer<T>& ring, size_t first, size_t n)
+{
+	const T* data = ring.data();
+	size_t cap = ring.capacity();
+	size_t run = std::min(n, cap - first);
+	plot_glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(first * sizeof(T)), (GLsizeiptr)(run * sizeof(T)), data + first);
+	if (run < n)
+	{
+		plot_glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)((n - run) * sizeof(T)), data);
+	}
+	if (first == 0 || run < n)
+	{
+		plot_glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(cap * sizeof(T)), sizeof(T), data);	//the repeat of slot 0
+	}
+}
+
+
+int Plotter::build_history_view(const Line& line, RingBuffer<fpoint_t>& out)
+{
+	int columns = (window_width > 0) ? window_width : 1;
+	size_t cap = (size_t)columns * 2;
+	if (out.capacity() != cap)
+	{
+		out.set_capacity(cap);
+	}
+	out.clear();
+	const RingBuffer<HistoryBin>& newest = line.history.level(0);
+	if (newest.empty() || view_seconds <= 0.f)
+	{
+		return -1;
+	}
+	m_view_bins.resize(columns);
+	double t1 = newest.back().t_last;
+	double t0 = t1 - (double)view_seconds;
+	int level = line.history.query(t0, t1, columns, m_view_bins.data());
+	for (int c = 0; c < columns; c++)
+	{
+		const HistoryBin& b = m_view_bins[c];
+		if (b.count == 0)
+		{
+			continue;
+		}
+		float x = (float)(0.5 * (b.t_first + b.t_last) - t0);
+		if (view_mean)
+		{
+			out.push(fpoint_t(x, b.mean()));
+		}
+		else
+		{
+			out.push(fpoint_t(x, b.min));
+			out.push(fpoint_t(x, b.max));
+		}
+	}
+	return level;
+}
+
+// n samples, x and y stride floats apart, to pixels. With stride 1 (sample columns) both
+// inputs are contiguous, so the loop vectorizes.
+static void transform_run(const float* xs, const float* ys, size_t stride, size_t n, float ox, float sx, float bx,
+	float sy, float by, int width, int height, rgb_t color, PlotVertex* out)
+{
+	for (size_t k = 0; k < n; k++)
 	{
-		points.push_back(fpoint_t(*xsource, *ysource));
+		int x = (int)floorf((xs[k * stride] - ox) * sx + bx);
+		int y = (int)floorf(ys[k * stride] * sy + by);
+		out[k].x = (float)sat_pix_to_window(x, width);
+		out[k].y = (float)sat_pix_to_window(y, height);
+		out[k].r = color.r;
+		out[k].g = color.g;
+		out[k].b = color.b;
+		out[k].a = color.a;
 	}
-	else if(points.size() > enqueue_cap)
+}
+
+void Plotter::build_vertices(const Line& line, std::vector<PlotVertex>& verts) const
+{
+	SampleSource src = samples_of(line);
+	if (src.size() == 0)
+	{
+		verts.clear();
+		return;
+	}
+	PlotTransform tf = transform_of(line, src[0].x);
+
+	// whichever rings are drawn read as two contiguous runs, oldest first, at the same slots
+	const float* xs = nullptr;
+	const float* ys = nullptr;
+	size_t stride = 1;
+	size_t first = 0;
+	size_t n_first = 0;
+	size_t n_second = 0;
+	if (line.decimating() || src.points)
 	{
-		points.resize(enqueue_cap);
+		const RingBuffer<fpoint_t>& ring = line.decimating() ? line.columns : line.points;
+		xs = &ring.data()->x;
+		ys = &ring.data()->y;
+		stride = 2;
+		first = ring.slot(0);
+		ring.first_span(n_first);
+		ring.second_span(n_second);
 	}
-	if(points.size() == enqueue_cap)
+	else
 	{
-		std::rotate(points.begin(), points.begin() + 1, points.end());
-		points.back() = fpoint_t(*xsource, *ysource);
+		xs = src.xcol->data();
+		ys = src.ycol->data();
+		first = src.ycol->slot(0);
+		src.ycol->first_span(n_first);
+		src.ycol->second_span(n_second);
 	}
 
+	verts.resize(n_first + n_second);
+	if (verts.empty())
+	{
+		return;
+	}
+	transform_run(xs + first * stride, ys + first * stride, stride, n_first, tf.origin_x, tf.scale_x, tf.offset_x,
+		tf.scale_y, tf.offset_y, window_width, window_height, line.color, verts.data());
+	transform_run(xs, ys, stride, n_second, tf.origin_x, tf.scale_x, tf.offset_x,
+		tf.scale_y, tf.offset_y, window_width, window_height, line.color, verts.data() + n_first);
+}
+
+void Line::push_sample(float x, float y, int screen_width)
+{
+	//enqueue data. The ring drops the oldest sample once full, so this is O(1) at any cap
+	if(points.capacity() != enqueue_cap)
+	{
+		points.set_capacity(enqueue_cap);
+	}
+	points.push(fpoint_t(x, y));
+
 	if(mode == TIME_MODE)
 	{
+		bool reset = false;
 		//THEN calculate xscale based on current buffer state
 		if(points.size() >= 2)
 		{
@@ -397,8 +748,108 @@ bool Line::enqueue_data(int screen_width)
 			else if(div < 0) //decreasing time
 			{
 				points.clear();	//this just sets size=0 - can preallocate and clear for speed
+				reset = true;
 			}
 		}
+		SampleSource src;
+		src.points = &points;
+		src.xcol = nullptr;
+		src.ycol = nullptr;
+		fold(src, 1, reset, screen_width);
+	}
+	else if(col_bucket != 0)
+	{
+		columns.set_capacity(0);
+		col_bucket = 0;
+	}
+}
+
+void Line::fold(const SampleSource& src, size_t fresh, bool reset, int screen_width)
+{
+	size_t n = src.size();
+	if(fresh > n)
+	{
+		fresh = n;
+	}
+	size_t cap = src.capacity();
+	uint32_t bucket = 0;
+	if(screen_width > 0)
+	{
+		bucket = (uint32_t)((cap + (size_t)screen_width - 1) / (size_t)screen_width);
+	}
+	if(bucket < 2)	//one sample per pixel or fewer: nothing to gain
+	{
+		if(col_bucket != 0)
+		{
+			columns.set_capacity(0);
+			col_bucket = 0;
+		}
+	}
+	else
+	{
+		//one pair per column, plus the partial column at each end
+		size_t col_cap = 2 * ((cap + bucket - 1) / bucket + 1);
+		if(reset || bucket != col_bucket || columns.capacity() != col_cap)
+		{
+			col_bucket = bucket;
+			columns.set_capacity(col_cap);
+			columns.clear();
+			col_fill = 0;
+			for(size_t i = 0; i < n; i++)
+			{
+				add_column_sample(src[i]);
+			}
+		}
+		else
+		{
+			for(size_t i = n - fresh; i < n; i++)
+			{
+				add_column_sample(src[i]);
+			}
+		}
+	}
+
+	//the history outlives the samples, except when they were cleared or resized
+	if(reset)
+	{
+		history.clear();
+		fresh = n;
+	}
+	for(size_t i = n - fresh; i < n; i++)
+	{
+		fpoint_t p = src[i];
+		history.push(p.x, p.y);
+	}
+}
+
+void Line::add_column_sample(const fpoint_t& p)
+{
+	if(col_fill == 0)
+	{
+		col_lo = p;
+		col_hi = p;
+		columns.push(p);
+		columns.push(p);
+	}
+	else
+	{
+		if(p.y < col_lo.y)
+		{
+			col_lo = p;
+		}
+		if(p.y > col_hi.y)
+		{
+			col_hi = p;
+		}
+		//keep the pair in time order, so the strip runs through them as they happened
+		size_t n = columns.size();
+		bool lo_first = (col_lo.x <= col_hi.x);
+		columns[n - 2] = lo_first ? col_lo : col_hi;
+		columns[n - 1] = lo_first ? col_hi : col_lo;
+	}
+	col_fill++;
+	if(col_fill == col_bucket)
+	{
+		col_fill = 0;
 	}
-	return true;
 }
@@ -4,6 +4,9 @@
 #include <vector>
 #include <cstdint>
 #include "colors.h"
+#include "ring_buffer.h"
+#include "history_pyramid.h"
+#include "plot_channels.h"
 
 // Forward-declare GL types to avoid pulling in GL headers here
 typedef unsigned int GLuint;
@@ -19,22 +22,43 @@ struct fpoint_t
 };
 
 
+// Screen-space vertex as build_vertices produces it: position (float x2) + color (ubyte x4).
+// render() uploads raw samples instead and does this transform in the vertex shader.
+struct PlotVertex
+{
+	float x, y;
+	uint8_t r, g, b, a;
+};
+
 typedef enum {TIME_MODE, XY_MODE}timemode_t;
 
+// A line's samples as (x, y) points, read from its own points or from two columns of a
+// PlotChannels timebase. Rows share slot numbers, so either form is read slot by slot.
+struct SampleSource
+{
+	const RingBuffer<fpoint_t>* points;
+	const RingBuffer<float>* xcol;
+	const RingBuffer<float>* ycol;
+
+	size_t size(void) const { return points ? points->size() : ycol->size(); }
+	size_t capacity(void) const { return points ? points->capacity() : ycol->capacity(); }
+	fpoint_t operator[](size_t i) const { return points ? (*points)[i] : fpoint_t((*xcol)[i], (*ycol)[i]); }
+};
+
 class Line
 {
 public:
-	std::vector<fpoint_t> points;
+	RingBuffer<fpoint_t> points;	//samples given with push_sample, oldest first; holds the last enqueue_cap
 	rgb_t color;
 
-
-
-	float * xsource;	//pointer to the x variable which we source for our data stream
-	float * ysource;	//pointer to the y variable which we source for our data stream
-
 	/*
-		Data is formatted and
+		Samples kept in Plotter::channels instead of points: channel is plotted against the
+		time column of its timebase in time mode, or against x_channel (on the same timebase)
+		in xy mode. Plotter::update folds new rows into the columns and history below.
 	*/
+	PlotChannel channel;
+	PlotChannel x_channel;
+
 	timemode_t mode;
 
 	//formula: display_value*xscale + xoffset (for xy mode)
@@ -47,14 +71,48 @@ public:
 	float yscale;	//scale the display_ value by one additional scalar  for plotting
 	float yoffset;
 
-	//queue size
+	//length of points in samples. Appending is O(1) at any size; changing it reallocates on the next push_sample
 	uint32_t enqueue_cap;
 
+	/*
+		Time mode, once the sample capacity exceeds the screen width: the history is also kept
+		as one min/max pair per column of col_bucket consecutive samples (ceil(capacity /
+		screen_width), so at most screen_width columns), the two points in the order they
+		occurred. render() draws these instead of the samples, so spikes survive and the
+		vertex count is bounded by the window width. Each new sample updates the newest column
+		in place or starts a new one; a change of capacity or width rebuilds them.
+		col_bucket is 0 while off.
+	*/
+	RingBuffer<fpoint_t> columns;
+	uint32_t col_bucket;
+
+	// Time mode: every sample also goes into this min/max/mean pyramid, once configured
+	// (history.configure(bytes)), so Plotter::view_seconds can zoom out past the sample capacity.
+	// It restarts if the line's samples are cleared or resized.
+	HistoryPyramid history;
+
 	Line();
 	Line(int capacity);
 
-	bool enqueue_data(int screen_width);
+	// Append one sample to points, e.g. drained from a PlotFeed with its own timestamp
+	void push_sample(float x, float y, int screen_width);
+
+	bool decimating(void) const { return mode == TIME_MODE && col_bucket != 0; }
+
+private:
+	friend class Plotter;
 
+	uint32_t col_fill;	//samples in the newest column
+	fpoint_t col_lo;	//its minimum and maximum
+	fpoint_t col_hi;
+
+	uint64_t seen_pushed;	//channel rows folded in so far
+	uint64_t seen_generation;
+
+	// Bring columns and history up to date with src, whose newest fresh samples are new;
+	// reset when src was cleared or resized since the last call
+	void fold(const SampleSource& src, size_t fresh, bool reset, int screen_width);
+	void add_column_sample(const fpoint_t& p);
 };
 
 class Plotter
@@ -66,6 +124,9 @@ public:
 	int num_widths;
 	std::vector<Line> lines;
 
+	// Sample columns for lines that use Line::channel
+	PlotChannels channels;
+
 	Plotter();
 	~Plotter();
 
@@ -74,21 +135,78 @@ public:
 
 	float sys_sec;	//global time
 
-	// Render all lines directly to OpenGL framebuffer
+	// Time-mode lines with a history show the last view_seconds of it (ending at their newest
+	// sample) instead of their samples, one column per pixel, from whichever pyramid level
+	// keeps that at O(window_width) work. 0 shows the samples as usual.
+	float view_seconds;
+	bool view_mean;	//draw each column's mean instead of its min/max
+
+	// Fold channel rows appended since the last call into their lines (decimated columns,
+	// history, time-mode xscale). render() calls it; no GL calls.
+	void update();
+
+	// Render all lines directly to OpenGL framebuffer. Sample columns and each line's own
+	// rings live in GPU buffers laid out slot for slot like their RingBuffers, so a frame
+	// uploads only what arrived since the last one; scaling, the time window and color are
+	// uniforms.
 	void render();
 
+	// Summarise line.history over the view window into out, as min/max pairs (or means) with
+	// x in seconds from the start of the window. Returns the pyramid level read, -1 if none.
+	int build_history_view(const Line& line, RingBuffer<fpoint_t>& out);
+
+	// The samples a line plots: its channel columns or its points
+	SampleSource samples_of(const Line& line) const;
+
+	// Screen-space vertices for one line as render() draws it outside a history view: the
+	// CPU equivalent of the vertex shader. No GL calls.
+	void build_vertices(const Line& line, std::vector<PlotVertex>& verts) const;
+
 	// Free GL resources (call before destroying GL context)
 	void teardown_gl_resources();
 
 private:
-	GLuint m_vbo;
-	GLuint m_ebo;
+	// GPU copy of one RingBuffer: capacity + 1 slots, the extra one repeating slot 0 so a
+	// strip can run off the end of the storage and back to the start unbroken
+	struct GpuRing
+	{
+		GLuint vbo;
+		const void* source;	//ring last uploaded from
+		size_t capacity;
+		uint64_t pushed;	//source->pushed() as of the last upload
+		uint64_t generation;	//source->generation() as of the last upload
+	};
+	std::vector<GpuRing> m_line_gpu;	//each line's own fpoint_t ring (points, columns or view), parallel to lines
+	std::vector<std::vector<GpuRing>> m_column_gpu;	//[timebase][0 = time, 1 + channel column]
+	std::vector<RingBuffer<fpoint_t>> m_views;	//history views, parallel to lines
+	std::vector<HistoryBin> m_view_bins;
+
+	// pixel = floor((sample - origin) * scale + offset)
+	struct PlotTransform
+	{
+		float origin_x, origin_y;
+		float scale_x, scale_y;
+		float offset_x, offset_y;
+	};
+
 	GLuint m_vao;
 	GLuint m_shader;
+	GLint m_a_x;
+	GLint m_a_y;
 	GLint m_u_proj;
+	GLint m_u_origin;
+	GLint m_u_scale;
+	GLint m_u_offset;
+	GLint m_u_window;
+	GLint m_u_color;
 	bool m_gl_ready;
 
 	bool init_gl_resources();
+	PlotTransform transform_of(const Line& line, float x0) const;
+	void release(GpuRing& g);
+	template <typename T> void sync_ring(const RingBuffer<T>& ring, size_t tail, GpuRing& g);
+	template <typename T> void upload_slots(const RingBuffer<T>& ring, size_t first, size_t n);
+	void draw_strips(size_t first, size_t n_first, size_t n_second);
 };
 
 #endif // PLOTTING_H
@@ -0,0 +1,185 @@
+/*
+	spooler_replay: run a recorded telemetry log (main --record) back through the controller.
+
+	usage: spooler_replay <log> [options]
+		--realtime        pace rows by their recorded timestamps instead of running flat out
+		--out FILE        write the replayed tension commands as CSV (default replay_commands.csv)
+
+	Each row is loaded into a SpoolerRobot as if read() had just returned it, along with the
+	controller inputs logged with it (including whether the tension solver split the force),
+	then compute_tensions (PD law + thresh_dbl clamping) and follow_trajectory() run exactly as
+	on the control thread. The command the replay would have sent is compared with the next
+	row's logged command, and targ after follow_trajectory() with the next row's logged targ.
+	follow_trajectory() is given the trajectory time logged with that next row (the control
+	thread's own clock), so the continuous profile is sampled at the same instant and targ
+	matches exactly. Rows logged during calibration, or where the GUI set targ, are not
+	compared.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+
+#define TINYCSOCKET_IMPLEMENTATION
+#include "tinycsocket.h"
+
+#include "spooler_robot.h"
+#include "control_loop.h"
+#include "telemetry_recorder.h"
+
+int main(int argc, char* argv[])
+{
+	const char* log_path = nullptr;
+	const char* out_path = "replay_commands.csv";
+	bool realtime = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--realtime") == 0)
+		{
+			realtime = true;
+		}
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			out_path = argv[++i];
+		}
+		else if (argv[i][0] != '-' && log_path == nullptr)
+		{
+			log_path = argv[i];
+		}
+		else
+		{
+			printf("unknown option %s\n", argv[i]);
+			return -1;
+		}
+	}
+	if (log_path == nullptr)
+	{
+		printf("usage: spooler_replay <log> [--realtime] [--out FILE]\n");
+		return -1;
+	}
+
+	TelemetryReader reader;
+	if (!reader.open(log_path))
+	{
+		return -1;
+	}
+	int n = reader.motor_count();
+	FILE* out = fopen(out_path, "w");
+	if (out == NULL)
+	{
+		printf("Failed to open %s for writing\n", out_path);
+		return -1;
+	}
+	fprintf(out, "row,t_s");
+	for (int i = 0; i < n; i++)
+	{
+		fprintf(out, ",cmd_log%d,cmd_replay%d", i, i);
+	}
+	fprintf(out, ",targ_log,targ_replay\n");
+
+	SpoolerRobot robot;
+	for (int i = 0; i < n; i++)
+	{
+		robot.add_offline_motor((unsigned char)(n - 1 - i));
+	}
+
+	TelemetryRow row, next;
+	if (!reader.next(row))
+	{
+		printf("%s has no rows\n", log_path);
+		return -1;
+	}
+	const int64_t t0_ns = row.ts_ns;
+	auto wall_start = std::chrono::steady_clock::now();
+
+	uint64_t rows = 0;
+	uint64_t compared = 0;
+	uint64_t cmd_mismatch = 0;
+	uint64_t targ_mismatch = 0;
+	int64_t max_cmd_diff = 0;
+	bool have_next = true;
+	while (have_next)
+	{
+		have_next = reader.next(next);
+
+		double t_s = (double)(row.ts_ns - t0_ns) * 1e-9;
+		if (realtime)
+		{
+			std::this_thread::sleep_until(wall_start + std::chrono::nanoseconds(row.ts_ns - t0_ns));
+		}
+
+		//same order as ControlLoop::run: inputs applied, telemetry read, controller, trajectory
+		robot.load_telemetry(row);
+		robot.k = row.k;
+		robot.kd = row.kd;
+		robot.tmax = row.tmax;
+		robot.targ = row.targ;
+		robot.rom_degrees = row.rom_degrees;
+		robot.do_oscillation = (row.do_oscillation != 0);
+		robot.use_tension_solver = (row.flags & TELEMETRY_FLAG_TENSION_SOLVER) != 0;
+		ControlInput in;
+		memset(&in, 0, sizeof(in));
+		in.mode = row.mode;
+		in.clicked = (row.clicked != 0);
+		in.xpos = row.xpos;
+		compute_tensions(robot, in, (row.flags & TELEMETRY_FLAG_COMMS_GOOD) != 0);
+		//sample at the instant the control thread did; logs without traj_t_s read it as 0 and fall back to the row time
+		robot.follow_trajectory((have_next && next.traj_t_s != 0.0) ? next.traj_t_s : t_s);
+		rows++;
+
+		if (!have_next)
+		{
+			break;
+		}
+		fprintf(out, "%llu,%.6f", (unsigned long long)rows - 1, t_s);
+		bool skip = ((row.flags | next.flags) & TELEMETRY_FLAG_CALIBRATING) != 0;
+		bool cmd_ok = true;
+		for (int i = 0; i < n; i++)
+		{
+			int32_t replayed = (int32_t)robot.t[i];
+			fprintf(out, ",%d,%d", next.command[i], replayed);
+			int64_t diff = (int64_t)replayed - next.command[i];
+			if (diff < 0)
+			{
+				diff = -diff;
+			}
+			if (!skip && diff != 0)
+			{
+				cmd_ok = false;
+				if (diff > max_cmd_diff)
+				{
+					max_cmd_diff = diff;
+				}
+			}
+		}
+		fprintf(out, ",%.3f,%.3f\n", (double)next.targ, (double)robot.targ);
+		if (skip)
+		{
+			row = next;
+			continue;
+		}
+		compared++;
+		if (!cmd_ok)
+		{
+			cmd_mismatch++;
+		}
+		if ((next.flags & TELEMETRY_FLAG_TARG_SET) == 0 && next.targ != robot.targ)
+		{
+			targ_mismatch++;
+		}
+		row = next;
+	}
+	fclose(out);
+
+	double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+	double log_s = (double)(row.ts_ns - t0_ns) * 1e-9;
+	printf("%llu rows, %.1f s of log replayed in %.3f s (%.0fx)\n",
+		(unsigned long long)rows, log_s, wall_s, wall_s > 0.0 ? log_s / wall_s : 0.0);
+	printf("compared %llu: command mismatches %llu (max diff %lld), targ mismatches %llu\n",
+		(unsigned long long)compared, (unsigned long long)cmd_mismatch, (long long)max_cmd_diff,
+		(unsigned long long)targ_mismatch);
+	printf("commands written to %s\n", out_path);
+	return (cmd_mismatch == 0) ? 0 : 1;
+}
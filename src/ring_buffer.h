@@ -0,0 +1,168 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+	Fixed-capacity history of T that drops its oldest value when full.
+	push() is O(1) and never allocates once the capacity is set; the contents are read
+	oldest first, either by index or as two contiguous spans (the part from the oldest value
+	to the end of storage, then the wrapped part from the start), so a consumer can copy or
+	upload them without walking the ring element by element.
+
+	A mirror of the ring (e.g. a GPU buffer laid out slot for slot) can stay in sync
+	incrementally: pushed() counts every push, so pushed() minus the count it last saw is how
+	many of the newest values are new, and slot() says where they live. generation() changes
+	whenever the layout does (set_capacity, clear), which means start over.
+
+	Single threaded - for handing values between threads see SpscQueue and TripleBuffer.
+*/
+template <typename T>
+class RingBuffer
+{
+public:
+	RingBuffer()
+		: slots()
+		, start(0)
+		, count(0)
+		, n_pushed(0)
+		, gen(0)
+	{
+	}
+
+	// Change the capacity, keeping the newest min(size(), n) values. Allocates.
+	void set_capacity(size_t n)
+	{
+		if (n == slots.size())
+		{
+			return;
+		}
+		std::vector<T> next(n);
+		size_t keep = (count < n) ? count : n;
+		for (size_t i = 0; i < keep; i++)
+		{
+			next[i] = (*this)[count - keep + i];
+		}
+		slots.swap(next);
+		start = 0;
+		count = keep;
+		gen++;
+	}
+
+	size_t capacity() const
+	{
+		return slots.size();
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	void clear()
+	{
+		start = 0;
+		count = 0;
+		gen++;
+	}
+
+	uint64_t pushed() const
+	{
+		return n_pushed;
+	}
+
+	uint64_t generation() const
+	{
+		return gen;
+	}
+
+	// Append v; when full, the oldest value is overwritten. No-op at capacity 0.
+	void push(const T& v)
+	{
+		size_t n = slots.size();
+		if (n == 0)
+		{
+			return;
+		}
+		n_pushed++;
+		if (count < n)
+		{
+			size_t i = start + count;
+			slots[i < n ? i : i - n] = v;
+			count++;
+		}
+		else
+		{
+			slots[start] = v;
+			start = (start + 1 == n) ? 0 : start + 1;
+		}
+	}
+
+	// i = 0 is the oldest value
+	const T& operator[](size_t i) const
+	{
+		return slots[slot(i)];
+	}
+
+	// Writable access to value i. Overwriting in place is not a push: a mirror tracking
+	// pushed() will not see it unless it re-reads that value itself.
+	T& operator[](size_t i)
+	{
+		return slots[slot(i)];
+	}
+
+	// Storage index of value i
+	size_t slot(size_t i) const
+	{
+		size_t j = start + i;
+		return j < slots.size() ? j : j - slots.size();
+	}
+
+	// Storage, capacity() values in slot order
+	const T* data() const
+	{
+		return slots.data();
+	}
+
+	const T& front() const
+	{
+		return slots[start];
+	}
+
+	const T& back() const
+	{
+		return (*this)[count - 1];
+	}
+
+	// Oldest values, up to the end of storage: n_first of them
+	const T* first_span(size_t& n_first) const
+	{
+		size_t to_end = slots.size() - start;
+		n_first = (count < to_end) ? count : to_end;
+		return slots.data() + start;
+	}
+
+	// The rest, wrapped to the start of storage: n_second of them (0 if the ring has not wrapped)
+	const T* second_span(size_t& n_second) const
+	{
+		size_t to_end = slots.size() - start;
+		n_second = (count > to_end) ? count - to_end : 0;
+		return slots.data();
+	}
+
+private:
+	std::vector<T> slots;
+	size_t start;	//index of the oldest value
+	size_t count;
+	uint64_t n_pushed;
+	uint64_t gen;
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,179 @@
+/*
+	spooler_sim: run the controller closed-loop against the cable-robot plant (cable_sim.h),
+	with no hardware or GUI, as fast as the host allows.
+
+	usage: spooler_sim [options]
+		--seconds S       simulated time to run (default 10)
+		--rate HZ         control rate (default 1000, as main.cpp)
+		--targ DEG        position target for motor 0 (default -10000)
+		--force X         force mode with the cursor held at X (-1..1) instead of position control
+		--oscillate       oscillate between the robot's osc_near and osc_far, as the GUI toggle does
+		--waypoints LIST  follow a spline through waypoints instead, LIST = dt:deg,dt:deg,...
+		                  (dt seconds from the previous point, the first from targ)
+		--solver          split tensions with the tension solver (SpoolerRobot::use_tension_solver)
+		--realtime        pace cycles at the control rate instead of running flat out
+		--out FILE        write the trajectory as CSV (default sim_trajectory.csv)
+
+	The robot tracks its end-effector position with forward kinematics (kinematics.h) from
+	the plant's geometry; the trajectory CSV has it next to the true mass position.
+
+	Each cycle is what ControlLoop::run does with fused_exchange: exchange() (which here
+	advances the plant one control period), compute_tensions, follow_trajectory. Gains and
+	limits are main.cpp's defaults. The run is deterministic, so two runs with the same
+	options write identical files.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define TINYCSOCKET_IMPLEMENTATION
+#include "tinycsocket.h"
+
+#include "spooler_robot.h"
+#include "control_loop.h"
+#include "cable_sim.h"
+#include "ui.h"
+
+int main(int argc, char* argv[])
+{
+	double seconds = 10.0;
+	double rate_hz = 1000.0;
+	double targ = -10e3;
+	double force_x = 0.0;
+	bool force_mode = false;
+	bool oscillate = false;
+	bool realtime = false;
+	bool solver = false;
+	const char* out_path = "sim_trajectory.csv";
+	std::vector<double> wp_dt;
+	std::vector<double> wp_p;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+			rate_hz = atof(argv[++i]);
+		else if (strcmp(argv[i], "--targ") == 0 && i + 1 < argc)
+			targ = atof(argv[++i]);
+		else if (strcmp(argv[i], "--force") == 0 && i + 1 < argc)
+		{
+			force_mode = true;
+			force_x = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--oscillate") == 0)
+			oscillate = true;
+		else if (strcmp(argv[i], "--waypoints") == 0 && i + 1 < argc)
+		{
+			const char* c = argv[++i];
+			while (*c != '\0')
+			{
+				char* end;
+				double dt = strtod(c, &end);
+				if (*end != ':')
+				{
+					printf("bad --waypoints list, expected dt:deg,dt:deg,...\n");
+					return -1;
+				}
+				double deg = strtod(end + 1, &end);
+				wp_dt.push_back(dt);
+				wp_p.push_back(deg);
+				c = (*end == ',') ? end + 1 : end;
+				if (*end != ',' && *end != '\0')
+				{
+					printf("bad --waypoints list, expected dt:deg,dt:deg,...\n");
+					return -1;
+				}
+			}
+		}
+		else if (strcmp(argv[i], "--solver") == 0)
+			solver = true;
+		else if (strcmp(argv[i], "--realtime") == 0)
+			realtime = true;
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+			out_path = argv[++i];
+		else
+		{
+			printf("unknown option %s\n", argv[i]);
+			return -1;
+		}
+	}
+	if (seconds <= 0.0 || rate_hz <= 0.0)
+	{
+		printf("--seconds and --rate must be positive\n");
+		return -1;
+	}
+	FILE* out = fopen(out_path, "w");
+	if (out == NULL)
+	{
+		printf("Failed to open %s for writing\n", out_path);
+		return -1;
+	}
+
+	CableSim<2> plant;
+	SpoolerRobot robot;
+	robot.add_offline_motor(0x1);	//same order as main.cpp
+	robot.add_offline_motor(0x0);
+	robot.sim = &plant;
+	robot.sim_cycle_s = 1.0 / rate_hz;
+	robot.targ = (float)targ;
+	robot.k = 0.5;
+	robot.kd = 3.0;
+	robot.tmax = 600;
+	robot.rom_degrees = -21000;
+	robot.do_oscillation = oscillate;
+	robot.use_tension_solver = solver;
+	robot.kin.set_geometry(plant.cfg.anchor, plant.cfg.spool_radius, plant.cfg.mass_start);
+	robot.track_pose = true;
+
+	ControlInput in;
+	memset(&in, 0, sizeof(in));
+	in.mode = force_mode ? FORCE_MODE : PCTL_TYPED;
+	in.clicked = force_mode;
+	in.xpos = force_x;
+
+	if (!wp_dt.empty())
+	{
+		robot.traj.reset(robot.targ);
+		if (!robot.traj.append_spline(wp_dt.data(), wp_p.data(), (int)wp_dt.size()))
+		{
+			printf("waypoint times must be positive\n");
+			return -1;
+		}
+		robot.start_trajectory(0.0);
+	}
+
+	fprintf(out, "t_s,targ,p0,p1,dp0,dp1,iq0,iq1,cmd0,cmd1,mass_x,mass_y,kin_x,kin_y\n");
+	uint64_t cycles = (uint64_t)(seconds * rate_hz + 0.5);
+	auto wall_start = std::chrono::steady_clock::now();
+	for (uint64_t c = 0; c < cycles; c++)
+	{
+		if (realtime)
+		{
+			std::this_thread::sleep_until(wall_start + std::chrono::duration<double>((double)c / rate_hz));
+		}
+		bool comms_good = robot.exchange();
+		compute_tensions(robot, in, comms_good);
+		double t_s = plant.time_s();
+		robot.follow_trajectory(t_s);
+		Eigen::Vector2d m = plant.mass_position();
+		fprintf(out, "%.4f,%.1f,%.2f,%.2f,%.2f,%.2f,%.0f,%.0f,%d,%d,%.5f,%.5f,%.5f,%.5f\n", t_s, (double)robot.targ,
+			robot.p[0], robot.p[1], (double)robot.dp[0], (double)robot.dp[1], (double)robot.iq[0], (double)robot.iq[1],
+			robot.motors[0].dp_ctl.command_word, robot.motors[1].dp_ctl.command_word, m.x(), m.y(), robot.ee_pos.x(), robot.ee_pos.y());
+	}
+	fclose(out);
+
+	double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+	double sim_s = plant.time_s();
+	printf("%llu cycles, %.1f s simulated in %.3f s (%.0fx real time)\n",
+		(unsigned long long)cycles, sim_s, wall_s, wall_s > 0.0 ? sim_s / wall_s : 0.0);
+	printf("final p0 %.1f deg (targ %.1f), mass at (%.3f, %.3f) m\n", robot.p[0], (double)robot.targ,
+		plant.mass_position().x(), plant.mass_position().y());
+	printf("forward kinematics puts it at (%.3f, %.3f) m (rigid cables, so off by the stretch)\n",
+		robot.ee_pos.x(), robot.ee_pos.y());
+	printf("trajectory written to %s\n", out_path);
+	return 0;
+}
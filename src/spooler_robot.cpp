@@ -1,4 +1,5 @@
 #include "spooler_robot.h"
+#include "cable_sim.h"
 #include "dartt_init.h"
 #include "dartt.h"
 #include "dartt_sync.h"
@@ -10,11 +11,16 @@ static constexpr double THETA_SCALE = 180.0 / ((double)(1 << 14) * 3.14159265);
 
 void SpoolerRobot::add_motor(unsigned char addr, const char* ip, uint16_t port)
 {
-    motors.emplace_back(addr);
+    add_offline_motor(addr);
     Motor& m = motors.back();
     snprintf(m.socket.ip, sizeof(m.socket.ip), "%s", ip);
     m.socket.port = port;
     udp_connect(&m.socket);
+}
+
+void SpoolerRobot::add_offline_motor(unsigned char addr)
+{
+    motors.emplace_back(addr);
 
     int n = (int)motors.size();
     p.conservativeResize(n); 
@@ -28,28 +34,384 @@ void SpoolerRobot::add_motor(unsigned char addr, const char* ip, uint16_t port)
 	dp[n-1] = 0.0;
 }
 
-bool SpoolerRobot::read()
+SpoolerRobot::~SpoolerRobot()
+{
+	if (pool != nullptr)
+	{
+		tcs_pool_destroy(&pool);
+	}
+}
+
+/*
+	Keep the read-poll set in step with the motor sockets. Sockets are replaced whenever
+	a motor reconnects (e.g. from the socket UI), so compare handles and rebuild on change.
+	The motor index rides along as the pool user data.
+*/
+bool SpoolerRobot::sync_pool(void)
+{
+	bool stale = (pool == nullptr) || (pool_sockets.size() != motors.size());
+	for (int i = 0; !stale && i < (int)motors.size(); i++)
+	{
+		if (pool_sockets[i] != motors[i].socket.socket)
+			stale = true;
+	}
+	if (!stale)
+		return true;
+
+	if (pool != nullptr)
+		tcs_pool_destroy(&pool);
+	pool_sockets.clear();
+	if (tcs_pool_create(&pool) != TCS_SUCCESS)
+	{
+		pool = nullptr;
+		return false;
+	}
+	for (int i = 0; i < (int)motors.size(); i++)
+	{
+		pool_sockets.push_back(motors[i].socket.socket);
+		if (motors[i].socket.connected)
+			tcs_pool_add(pool, motors[i].socket.socket, (void*)(intptr_t)i, true, false, false);
+	}
+	return true;
+}
+
+uint32_t SpoolerRobot::reply_timeout_us(int i) const
+{
+	return adaptive_timeouts ? motors[i].timeout.timeout_us : cycle_timeout_ms * 1000;
+}
+
+/*
+	Wait for replies from every motor that has a request in flight, taking each one
+	as soon as its socket is readable, until each has answered or passed its own
+	reply deadline (send time + reply_timeout_us).
+*/
+void SpoolerRobot::gather_replies(void)
+{
+	if (!sync_pool())
+		return;
+
+	poll_events.resize(motors.size());
+	while (true)
+	{
+		int64_t now = udp_now_ns();
+		int64_t last_deadline = now;
+		for (int i = 0; i < (int)motors.size(); i++)
+		{
+			const UdpState& s = motors[i].socket;
+			int64_t deadline = s.tx_time_ns + (int64_t)reply_timeout_us(i) * 1000;
+			if (s.awaiting_reply && deadline > last_deadline)
+				last_deadline = deadline;
+		}
+		if (last_deadline <= now)
+			break;	//everyone answered, or whoever has not is past their deadline and misses this cycle
+		//round up so a sub-millisecond remainder still polls instead of spinning
+		int64_t remaining_ms = (last_deadline - now + 999999) / 1000000;
+
+		size_t populated = 0;
+		TcsResult res = tcs_pool_poll(pool, poll_events.data(), poll_events.size(), &populated, remaining_ms);
+		if (res != TCS_SUCCESS)
+			break;	//timed out or poll error; whoever has not answered misses this cycle
+		for (size_t e = 0; e < populated; e++)
+		{
+			if (!poll_events[e].can_read)
+				continue;
+			int i = (int)(intptr_t)poll_events[e].user_data;
+			udp_gather_reply(&motors[i].socket);
+		}
+	}
+}
+
+/*
+	One cycle of traffic to every motor. Each motor's frames are staged into a single datagram
+	(the command write, if requested, followed by the telemetry read), all datagrams are sent,
+	and the replies gathered against each motor's reply deadline before dartt parses them.
+	DARTT writes are not acknowledged, so each datagram is answered by exactly one read reply.
+*/
+bool SpoolerRobot::transact(bool with_command)
 {
+	if (sim != nullptr)
+		return transact_sim(with_command);
+
     bool ok = true;
-    for (int i = 0; i < (int)motors.size(); i++)
+	int n = (int)motors.size();
+
+	bool batched = use_batch_transport && (batch.is_open() || batch.open());
+	TelemetryRow row;
+
+	//stage: rx is suppressed, so dartt returns right after each frame is encoded onto the socket state
+	for (int i = 0; i < n; i++)
+	{
+		UdpState& s = motors[i].socket;
+		s.awaiting_reply = false;
+		s.rx_pending_len = 0;
+		s.tx_staged_len = 0;
+		s.mode = UDP_MODE_STAGE;
+		if (with_command)
+		{
+			motors[i].dp_ctl.command_word = (int32_t)t[i];
+			dartt_buffer_t w = {
+				.buf  = motors[i].ds.ctl_base.buf,
+				.size = sizeof(uint32_t),
+				.len  = sizeof(uint32_t)
+			};
+			if (dartt_write_multi(&w, &motors[i].ds) != 0)
+				motors[i].stats.write_failures++;	//shows in the comms panel; no printf on the control thread
+		}
+		dartt_buffer_t r = {
+            .buf  = motors[i].ds.ctl_base.buf,
+            .size = sizeof(uint32_t) * 4,
+            .len  = sizeof(uint32_t) * 4
+        };
+		dartt_read_multi(&r, &motors[i].ds);
+	}
+
+	//fan-out + gather
+	if (batched)
+	{
+		batch_states.clear();
+		for (int i = 0; i < n; i++)
+		{
+			batch_states.push_back(&motors[i].socket);
+		}
+		uint32_t gather_us = 0;	//one shared socket, so wait out the longest motor timeout
+		for (int i = 0; i < n; i++)
+		{
+			if (reply_timeout_us(i) > gather_us)
+				gather_us = reply_timeout_us(i);
+		}
+		batch.send(batch_states.data(), n);
+		batch.gather(batch_states.data(), n, (gather_us + 999) / 1000);
+	}
+	else
+	{
+		for (int i = 0; i < n; i++)
+		{
+			udp_send_staged(&motors[i].socket);
+		}
+		gather_replies();
+	}
+	for (int i = 0; i < n; i++)
+	{
+		MotorCommsStats& st = motors[i].stats;
+		const UdpState& s = motors[i].socket;
+		if (s.rx_pending_len != 0 || s.awaiting_reply)
+			st.transactions++;
+		else
+			st.send_failures++;
+	}
+
+	//parse: rebuild the same read frame, and let dartt consume the gathered reply in place of a blocking receive
+    for (int i = 0; i < n; i++)
     {
         dartt_buffer_t r = {
             .buf  = motors[i].ds.ctl_base.buf,
             .size = sizeof(uint32_t) * 4,
             .len  = sizeof(uint32_t) * 4
         };
+		UdpState& s = motors[i].socket;
+		MotorCommsStats& st = motors[i].stats;
+		bool answered = (s.rx_pending_len != 0);
+		int32_t rtt_us = -1;
+		s.rx_status = COBS_SUCCESS;
+		s.mode = UDP_MODE_REPLAY;
         if (dartt_read_multi(&r, &motors[i].ds) != DARTT_PROTOCOL_SUCCESS)
+		{
             ok = false;
+			if (!answered)
+			{
+				if (s.awaiting_reply)
+					st.timeouts++;
+			}
+			else if (s.rx_status != COBS_SUCCESS)
+				st.cobs_failures++;
+			else
+				st.short_reads++;
+		}
+		else
+		{
+			rtt_us = (int32_t)((s.rx_time_ns - s.tx_time_ns) / 1000);
+			st.rtt.record((uint32_t)rtt_us);
+			motors[i].timeout.record((uint32_t)rtt_us);
+		}
+		s.mode = UDP_MODE_BLOCKING;
+		s.awaiting_reply = false;
+
+		//drops counted by the transport, including any from blocking transactions since the last cycle
+		st.stale_replies += s.stale_replies;
+		st.duplicate_replies += s.duplicate_replies;
+		s.stale_replies = 0;
+		s.duplicate_replies = 0;
+		if (s.late_rtt_max_us != 0)
+		{
+			motors[i].timeout.record(s.late_rtt_max_us);	//the tail our timeout cut off
+			s.late_rtt_max_us = 0;
+		}
+		if (adaptive_timeouts)
+			motors[i].ds.timeout_ms = motors[i].timeout.timeout_ms();
+		st.timeout_us = reply_timeout_us(i);
+
+		unpack_telemetry(i);
+		if (rtt_us >= 0)
+			feed_plot(i, s.rx_time_ns);
 
-        p[i]  = motors[i].dp_periph.theta_rem_m * THETA_SCALE;
-        iq[i] = (float)motors[i].dp_periph.iq;
-		dp[i] = (float)motors[i].dp_periph.dtheta_fixedpoint_rad_p_sec / 16.f;
+		record_motor(row, i, rtt_us);
     }
+	record_cycle(row, ok, with_command);
     return ok;
 }
 
+/*
+	transact() against the simulator: the command goes into the plant's registers, the plant
+	advances one control period, and its registers are taken as the reply. Sockets and comms
+	stats are not touched. Motors beyond the plant's spool count never answer.
+*/
+bool SpoolerRobot::transact_sim(bool with_command)
+{
+	bool ok = true;
+	int n = (int)motors.size();
+	TelemetryRow row;
+	for (int i = 0; i < n && i < sim->num_spools(); i++)
+	{
+		if (with_command)
+			motors[i].dp_ctl.command_word = (int32_t)t[i];
+		sim->regs(i).command_word = motors[i].dp_ctl.command_word;
+	}
+	sim->advance(sim_cycle_s);
+	int64_t now_ns = udp_now_ns();
+	for (int i = 0; i < n; i++)
+	{
+		if (i < sim->num_spools())
+		{
+			const dartt_mctl_params_t& r = sim->regs(i);
+			motors[i].dp_periph.theta_rem_m = r.theta_rem_m;
+			motors[i].dp_periph.iq = r.iq;
+			motors[i].dp_periph.dtheta_fixedpoint_rad_p_sec = r.dtheta_fixedpoint_rad_p_sec;
+			unpack_telemetry(i);
+			feed_plot(i, now_ns);
+		}
+		else
+		{
+			ok = false;
+		}
+		record_motor(row, i, i < sim->num_spools() ? 0 : -1);
+	}
+	record_cycle(row, ok, with_command);
+	return ok;
+}
+
+void SpoolerRobot::record_motor(TelemetryRow& row, int i, int32_t rtt_us)
+{
+	if (recorder != nullptr && i < TELEMETRY_MAX_MOTORS)
+	{
+		row.theta[i] = motors[i].dp_periph.theta_rem_m;
+		row.iq[i] = motors[i].dp_periph.iq;
+		row.dtheta[i] = motors[i].dp_periph.dtheta_fixedpoint_rad_p_sec;
+		row.command[i] = motors[i].dp_ctl.command_word;
+		row.rtt_us[i] = rtt_us;
+	}
+}
+
+void SpoolerRobot::feed_plot(int i, int64_t t_ns)
+{
+	if (plot_feed == nullptr)
+		return;
+	PlotSample ps;
+	ps.t_ns = t_ns;
+	ps.motor = i;
+	ps.p = (float)p[i];
+	ps.iq = iq[i];
+	ps.dp = dp[i];
+	if (!plot_feed->push(ps))
+		plot_feed_drops++;	//GUI stalled; it will see a gap rather than block this thread
+}
+
+void SpoolerRobot::record_cycle(TelemetryRow& row, bool ok, bool with_command)
+{
+	int n = (int)motors.size();
+	if (recorder != nullptr)
+	{
+		row.ts_ns = udp_now_ns();
+		row.flags = (ok ? TELEMETRY_FLAG_COMMS_GOOD : 0) | (with_command ? TELEMETRY_FLAG_FUSED : 0)
+			| (input_targ_set ? TELEMETRY_FLAG_TARG_SET : 0) | (calibrating ? TELEMETRY_FLAG_CALIBRATING : 0)
+			| (use_tension_solver ? TELEMETRY_FLAG_TENSION_SOLVER : 0);
+		row.mode = input_mode;
+		row.clicked = input_clicked ? 1 : 0;
+		row.xpos = input_xpos;
+		row.k = k;
+		row.kd = kd;
+		row.tmax = tmax;
+		row.targ = targ;
+		row.traj_t_s = traj_time;
+		row.rom_degrees = rom_degrees;
+		row.do_oscillation = do_oscillation ? 1 : 0;
+		input_targ_set = false;
+		for (int i = n; i < TELEMETRY_MAX_MOTORS; i++)
+		{
+			row.theta[i] = row.iq[i] = row.dtheta[i] = row.command[i] = 0;
+			row.rtt_us[i] = -1;
+		}
+		recorder->push(row);
+	}
+}
+
+//fixed-point telemetry -> p (degrees), iq, dp
+void SpoolerRobot::unpack_telemetry(int i)
+{
+	p[i]  = motors[i].dp_periph.theta_rem_m * THETA_SCALE;
+	iq[i] = (float)motors[i].dp_periph.iq;
+	dp[i] = (float)motors[i].dp_periph.dtheta_fixedpoint_rad_p_sec / 16.f;
+}
+
+void SpoolerRobot::load_telemetry(const TelemetryRow& row)
+{
+	for (int i = 0; i < (int)motors.size() && i < TELEMETRY_MAX_MOTORS; i++)
+	{
+		motors[i].dp_periph.theta_rem_m = row.theta[i];
+		motors[i].dp_periph.iq = row.iq[i];
+		motors[i].dp_periph.dtheta_fixedpoint_rad_p_sec = row.dtheta[i];
+		motors[i].dp_ctl.command_word = row.command[i];
+		unpack_telemetry(i);
+	}
+	update_pose();
+}
+
+void SpoolerRobot::update_pose(void)
+{
+	if (!track_pose || (int)motors.size() < 2)
+	{
+		return;
+	}
+	double angles[2] = {p[0], p[1]};
+	CableKinematics<2, 2>::Lengths l;
+	kin.lengths_from_angles(angles, l);
+	kin.forward(l, ee_pos);
+}
+
+bool SpoolerRobot::read()
+{
+	bool ok = transact(false);
+	update_pose();
+	return ok;
+}
+
+bool SpoolerRobot::exchange()
+{
+	bool ok = transact(true);
+	update_pose();
+	return ok;
+}
+
 void SpoolerRobot::write()
 {
+	if (sim != nullptr)
+	{
+		for (int i = 0; i < (int)motors.size() && i < sim->num_spools(); i++)
+		{
+			motors[i].dp_ctl.command_word = (int32_t)t[i];
+			sim->regs(i).command_word = motors[i].dp_ctl.command_word;
+		}
+		return;
+	}
     for (int i = 0; i < (int)motors.size(); i++)
     {
         motors[i].dp_ctl.command_word = (int32_t)t[i];
@@ -59,16 +421,28 @@ void SpoolerRobot::write()
             .len  = sizeof(uint32_t)
         };
         if (dartt_write_multi(&w, &motors[i].ds) != 0)
-            printf("write failure motor %d\r\n", i);
+			motors[i].stats.write_failures++;	//shows in the comms panel; no printf on the control thread
     }
 }
 
+bool SpoolerRobot::zero_offset(int i)
+{
+	if (sim != nullptr)
+	{
+		if (i >= sim->num_spools())
+			return false;
+		sim->zero(i);
+		return true;
+	}
+	return motors[i].write_zero_offset();
+}
+
 bool SpoolerRobot::write_zero_offsets()
 {
 	bool pass = true;
 	for(int i = 0; i < (int)motors.size(); i++)
 	{
-		bool res = motors[i].write_zero_offset();
+		bool res = zero_offset(i);
 		if(res == false)
 		{
 			pass = false;
@@ -77,20 +451,41 @@ bool SpoolerRobot::write_zero_offsets()
 	return pass;
 }
 
-void SpoolerRobot::oscillate(float time)
+void SpoolerRobot::start_trajectory(double time)
 {
-	float elapsed_time = time - prev_time;
-	if(elapsed_time > 3)
+	traj_t0 = time;
+	traj_running = !traj.empty();
+}
+
+void SpoolerRobot::follow_trajectory(double time)
+{
+	traj_time = time;
+	if (do_oscillation != osc_planned)
 	{
-		prev_time = time;
-		if(targ > -10000)
-		{
-			targ = -20000;
-		}
-		else
-		{
-			targ = -2000;
-		}
+		osc_planned = do_oscillation;
+		traj_running = false;	//toggled either way: drop whatever was running, targ stays put
+	}
+	if (do_oscillation && (!traj_running || time - traj_t0 >= traj.duration()))
+	{
+		//a new period starts where the last one ended, so the phase does not drift with the cycle time
+		double t0 = traj_running ? traj_t0 + traj.duration() : time;
+		traj.loop = false;
+		traj.reset(targ);
+		traj.append_scurve(osc_far, osc_limits);
+		traj.append_hold(osc_dwell_s);
+		traj.append_scurve(osc_near, osc_limits);
+		traj.append_hold(osc_dwell_s);
+		start_trajectory(t0);
+	}
+	if (!traj_running)
+	{
+		return;
+	}
+	double t = time - traj_t0;
+	targ = (float)traj.sample(t);
+	if (!traj.loop && t >= traj.duration())
+	{
+		traj_running = false;
 	}
 }
 
@@ -114,6 +509,7 @@ float abs_f(float input)
 void SpoolerRobot::calibrate(void)
 {
 	printf("Starting calibration...\n");
+	calibrating = true;
 	for(int m = 0; m < motors.size(); m++)
 	{	
 		float start = time_sec();
@@ -138,7 +534,7 @@ void SpoolerRobot::calibrate(void)
 				printf("writing zero\n");
 				for(int i = 0; i < 1000; i++)
 				{
-					bool rc = motors[m].write_zero_offset();
+					bool rc = zero_offset(m);
 					if(rc == true)
 					{
 						i = 1000;
@@ -147,6 +543,7 @@ void SpoolerRobot::calibrate(void)
 					else
 					{
 						printf("Fail to write motor0 attempt: %d\n", i);
+						motors[m].stats.retries++;
 					}
 				}
 				printf("Done writing zero\n");
@@ -158,6 +555,7 @@ void SpoolerRobot::calibrate(void)
 		}
 	}
 	rom_degrees = p[0];
+	calibrating = false;
 	printf("...Stopped. Using rom %f\n", rom_degrees);
 
 }
\ No newline at end of file
@@ -5,6 +5,14 @@
 #include <cstdint>
 #include <Eigen/Dense>
 #include "motor.h"
+#include "udp_batch.h"
+#include "telemetry_recorder.h"
+#include "trajectory.h"
+#include "tension_solver.h"
+#include "kinematics.h"
+#include "plot_feed.h"
+
+class RobotSim;
 
 class SpoolerRobot
 {
@@ -27,23 +35,91 @@ public:
 
 
 	bool do_oscillation;
-	float prev_time;
+
+	// Position mode: split the PD output into the two tensions with line_tensions (net pull
+	// exactly f, the slack side at the 100 count floor, both within [100, tmax]) instead of
+	// putting f on one cable and 100 on the other. Off by default so recorded logs replay as run.
+	bool use_tension_solver = false;
+	TensionSolver<1, 2> line_tensions;
+
+	// End-effector position from the spool angles: every read()/exchange()/load_telemetry
+	// runs kin.forward on the cable lengths p implies, warm-started from the last cycle, and
+	// leaves the result in ee_pos (m). kin also holds the structure matrix at that pose.
+	// Off until kin has its geometry (kin.set_geometry).
+	bool track_pose = false;
+	CableKinematics<2, 2> kin;
+	Eigen::Vector2d ee_pos = Eigen::Vector2d::Zero();
+
+	// Setpoint generator for targ. While do_oscillation is set, follow_trajectory() plans a
+	// jerk-limited move to osc_far, a dwell, a move back to osc_near and a dwell, starting from
+	// wherever targ is, and replans it at the end of each period. Anything else built in traj
+	// runs once after start_trajectory().
+	Trajectory traj;
+	TrajLimits osc_limits = {4000.0, 12000.0, 60000.0};	//deg/s, deg/s^2, deg/s^3
+	float osc_near = -2000;
+	float osc_far = -20000;
+	float osc_dwell_s = 0.5;
+
+	uint32_t cycle_timeout_ms = 10;	//reply deadline for every motor in read(), unless adaptive_timeouts
+
+	// Give each motor its own reply deadline from its measured RTTs (Motor::timeout),
+	// applied to the cycle gather and to blocking transactions via ds.timeout_ms
+	bool adaptive_timeouts = true;
+
+	// When set to an open recorder, every read()/exchange() pushes one TelemetryRow to it
+	TelemetryRecorder* recorder = nullptr;
+
+	// When set, every motor reply that parses is pushed to it as a PlotSample stamped with its
+	// receive time. A full queue drops the sample and counts it in plot_feed_drops.
+	PlotFeed* plot_feed = nullptr;
+	uint64_t plot_feed_drops = 0;
+
+	// GUI inputs compute_tensions will see this cycle, kept here by ControlLoop only so the
+	// recorder can log them alongside the telemetry
+	int input_mode = 0;
+	bool input_clicked = false;
+	double input_xpos = 0.0;
+	bool input_targ_set = false;	//targ was set from the GUI since the last recorded row
+	bool calibrating = false;	//inside calibrate()
+
+	// Linux: send all telemetry requests with one sendmmsg and drain replies with recvmmsg
+	// over one shared socket (see udp_batch.h). Falls back to the per-motor sockets if it cannot open.
+	bool use_batch_transport = false;
+
+	// When set, read()/write()/exchange() and zeroing talk to this plant (cable_sim.h) instead
+	// of the motors' sockets: commands go into its registers, each read()/exchange() advances it
+	// by sim_cycle_s, and its registers come back as the telemetry. Motors can be offline.
+	RobotSim* sim = nullptr;
+	double sim_cycle_s = 0.001;
 
 
     SpoolerRobot() = default;
+    ~SpoolerRobot();
     SpoolerRobot(const SpoolerRobot&) = delete;
     SpoolerRobot& operator=(const SpoolerRobot&) = delete;
 
     // Add motor, connect immediately; resizes p/iq/t
     void add_motor(unsigned char addr, const char* ip, uint16_t port);
 
-    // Read all motors via dartt_read_multi; convert fixed-point → p, iq.
+    // Add motor without a socket, for replay
+    void add_offline_motor(unsigned char addr);
+
+    // Replay: take one recorded row as if read() had just returned it (p/iq/dp, command_word)
+    void load_telemetry(const TelemetryRow& row);
+
+    // Read all motors: fan the telemetry request out to every motor, then gather the
+    // replies as they arrive, each against its motor's reply deadline; convert fixed-point → p, iq.
     // Returns true if all reads succeeded.
     bool read();
 
     // Convert t → command_word (int32_t) for each motor; write via dartt_write_multi.
     void write();
 
+    // Fused write + read: command_word (from t) and the telemetry request go to each motor
+    // in one datagram, so a control cycle needs one round-trip per motor instead of two.
+    // Telemetry handling is as read(). Returns true if all reads succeeded.
+    bool exchange();
+
 	//send one-time fixed theta offset to motors
 	bool write_zero_offsets(void);
 
@@ -51,7 +127,36 @@ public:
 	void calibrate(void);	
 
 
-	void oscillate(float time);
+	// Sample traj from time onwards (seconds, on the clock later passed to follow_trajectory)
+	void start_trajectory(double time);
+
+	// Once per control cycle: replan the oscillation if due, then targ = traj at time
+	void follow_trajectory(double time);
+
+private:
+	struct TcsPool* pool = nullptr;	//read-poll set over all motor sockets, rebuilt when a socket changes
+	std::vector<TcsSocket> pool_sockets;
+	std::vector<TcsPollEvent> poll_events;
+
+	UdpBatchTransport batch;
+	std::vector<UdpState*> batch_states;
+
+	bool traj_running = false;
+	bool osc_planned = false;	//do_oscillation as of the last follow_trajectory
+	double traj_t0 = 0.0;
+	double traj_time = 0.0;	//time the last follow_trajectory sampled at, logged so a replay can sample the same instant
+
+	bool transact(bool with_command);
+	bool transact_sim(bool with_command);
+	bool zero_offset(int i);
+	void record_motor(TelemetryRow& row, int i, int32_t rtt_us);
+	void record_cycle(TelemetryRow& row, bool ok, bool with_command);
+	void feed_plot(int i, int64_t t_ns);
+	bool sync_pool(void);
+	uint32_t reply_timeout_us(int i) const;
+	void unpack_telemetry(int i);
+	void update_pose(void);
+	void gather_replies(void);
 };
 
 #endif
@@ -0,0 +1,91 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+	Lock-free bounded single producer / single consumer FIFO of T.
+	Storage is allocated once by init(); push() and pop() never allocate, block or make
+	syscalls, so the producer can be a real-time thread. When full, push() fails and the
+	caller decides what to drop. Unlike TripleBuffer, every value is delivered in order.
+
+	T should be trivially copyable and fixed size.
+*/
+template <typename T>
+class SpscQueue
+{
+public:
+	SpscQueue()
+		: slots()
+		, mask(0)
+		, head(0)
+		, tail(0)
+	{
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Allocate room for capacity values (rounded up to a power of two). Not thread safe -
+	// call before either side starts.
+	void init(size_t capacity)
+	{
+		size_t n = 1;
+		while (n < capacity)
+		{
+			n <<= 1;
+		}
+		slots.assign(n, T());
+		mask = (uint32_t)(n - 1);
+		head.store(0);
+		tail.store(0);
+	}
+
+	size_t capacity() const
+	{
+		return slots.size();
+	}
+
+	// Producer: copy v in. Returns false if the queue is full (or not initialized).
+	bool push(const T& v)
+	{
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= (uint32_t)slots.size())
+		{
+			return false;
+		}
+		slots[h & mask] = v;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer: copy the oldest value out. Returns false if empty.
+	bool pop(T& v)
+	{
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		v = slots[t & mask];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Either side: number of values waiting (a snapshot)
+	size_t size() const
+	{
+		return (size_t)(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire));
+	}
+
+private:
+	std::vector<T> slots;
+	uint32_t mask;
+	std::atomic<uint32_t> head;	//next slot the producer fills
+	std::atomic<uint32_t> tail;	//next slot the consumer takes
+};
+
+#endif // SPSC_QUEUE_H
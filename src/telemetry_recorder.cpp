@@ -0,0 +1,394 @@
+#include "telemetry_recorder.h"
+#include <cstring>
+#include <cstddef>
+#include <chrono>
+
+/*
+	Column schema. Per-row fields first, then TELEMETRY_MOTOR_FIELDS once per motor,
+	named with the motor index appended.
+*/
+struct FieldDesc
+{
+	const char* name;
+	telemetry_type_t type;
+	size_t offset;
+};
+
+static const FieldDesc ROW_FIELDS[] = {
+	{"ts_ns", TELEMETRY_INT64, offsetof(TelemetryRow, ts_ns)},
+	{"flags", TELEMETRY_INT32, offsetof(TelemetryRow, flags)},
+	{"mode", TELEMETRY_INT32, offsetof(TelemetryRow, mode)},
+	{"clicked", TELEMETRY_INT32, offsetof(TelemetryRow, clicked)},
+	{"xpos", TELEMETRY_FLOAT64, offsetof(TelemetryRow, xpos)},
+	{"k", TELEMETRY_FLOAT32, offsetof(TelemetryRow, k)},
+	{"kd", TELEMETRY_FLOAT32, offsetof(TelemetryRow, kd)},
+	{"tmax", TELEMETRY_FLOAT32, offsetof(TelemetryRow, tmax)},
+	{"targ", TELEMETRY_FLOAT32, offsetof(TelemetryRow, targ)},
+	{"traj_t_s", TELEMETRY_FLOAT64, offsetof(TelemetryRow, traj_t_s)},
+	{"rom_degrees", TELEMETRY_FLOAT32, offsetof(TelemetryRow, rom_degrees)},
+	{"do_oscillation", TELEMETRY_INT32, offsetof(TelemetryRow, do_oscillation)},
+};
+#define NUM_ROW_FIELDS (int)(sizeof(ROW_FIELDS) / sizeof(ROW_FIELDS[0]))
+
+static const FieldDesc MOTOR_FIELDS[] = {
+	{"theta", TELEMETRY_INT32, offsetof(TelemetryRow, theta)},
+	{"iq", TELEMETRY_INT32, offsetof(TelemetryRow, iq)},
+	{"dtheta", TELEMETRY_INT32, offsetof(TelemetryRow, dtheta)},
+	{"command", TELEMETRY_INT32, offsetof(TelemetryRow, command)},
+	{"rtt_us", TELEMETRY_INT32, offsetof(TelemetryRow, rtt_us)},
+};
+#define NUM_MOTOR_FIELDS (int)(sizeof(MOTOR_FIELDS) / sizeof(MOTOR_FIELDS[0]))
+
+static size_t type_size(uint32_t type)
+{
+	return (type == TELEMETRY_INT64 || type == TELEMETRY_FLOAT64) ? 8 : 4;
+}
+
+TelemetryRecorder::TelemetryRecorder()
+	: f(NULL)
+	, num_motors(0)
+	, queue()
+	, num_columns(0)
+	, first_ts_ns(0)
+	, last_ts_ns(0)
+	, chunk_fill(0)
+	, chunk_index(0)
+	, written(0)
+	, dropped(0)
+	, writer()
+	, running(false)
+{
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+	close();
+}
+
+bool TelemetryRecorder::open(const char* path, int motors)
+{
+	if (f != NULL)
+	{
+		return true;
+	}
+	if (motors < 1 || motors > TELEMETRY_MAX_MOTORS)
+	{
+		printf("Recorder: unsupported motor count %d\n", motors);
+		return false;
+	}
+	f = fopen(path, "wb");
+	if (f == NULL)
+	{
+		printf("Recorder: failed to open %s\n", path);
+		return false;
+	}
+	num_motors = motors;
+
+	//everything the recorder will ever need is allocated here, not on the control thread
+	queue.init(TELEMETRY_QUEUE_ROWS);
+	num_columns = 0;
+	for (int c = 0; c < NUM_ROW_FIELDS; c++)
+	{
+		col_offset[num_columns] = ROW_FIELDS[c].offset;
+		col_size[num_columns] = type_size(ROW_FIELDS[c].type);
+		num_columns++;
+	}
+	for (int m = 0; m < num_motors; m++)
+	{
+		for (int c = 0; c < NUM_MOTOR_FIELDS; c++)
+		{
+			col_offset[num_columns] = MOTOR_FIELDS[c].offset + (size_t)m * sizeof(int32_t);
+			col_size[num_columns] = type_size(MOTOR_FIELDS[c].type);
+			num_columns++;
+		}
+	}
+	for (int c = 0; c < num_columns; c++)
+	{
+		col_buf[c].assign(col_size[c] * TELEMETRY_CHUNK_ROWS, 0);
+	}
+	chunk_fill = 0;
+	chunk_index = 0;
+	written.store(0);
+	dropped.store(0);
+
+	write_header();
+	running.store(true);
+	writer = std::thread(&TelemetryRecorder::run, this);
+	printf("Recorder: writing %s\n", path);
+	return true;
+}
+
+void TelemetryRecorder::close(void)
+{
+	running.store(false);
+	if (writer.joinable())
+	{
+		writer.join();
+	}
+	if (f != NULL)
+	{
+		drain();
+		flush_chunk();
+		fclose(f);
+		f = NULL;
+	}
+}
+
+bool TelemetryRecorder::is_open(void) const
+{
+	return f != NULL;
+}
+
+bool TelemetryRecorder::push(const TelemetryRow& row)
+{
+	if (!queue.push(row))
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+uint64_t TelemetryRecorder::rows_written(void) const
+{
+	return written.load();
+}
+
+uint64_t TelemetryRecorder::rows_dropped(void) const
+{
+	return dropped.load();
+}
+
+void TelemetryRecorder::write_header(void)
+{
+	TelemetryFileHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, TELEMETRY_FILE_MAGIC, sizeof(h.magic));
+	h.version = TELEMETRY_FILE_VERSION;
+	h.num_motors = (uint32_t)num_motors;
+	h.num_columns = (uint32_t)num_columns;
+	h.chunk_rows = TELEMETRY_CHUNK_ROWS;
+	fwrite(&h, sizeof(h), 1, f);
+
+	TelemetryColumn c;
+	for (int i = 0; i < NUM_ROW_FIELDS; i++)
+	{
+		memset(&c, 0, sizeof(c));
+		snprintf(c.name, sizeof(c.name), "%s", ROW_FIELDS[i].name);
+		c.type = ROW_FIELDS[i].type;
+		c.motor = -1;
+		fwrite(&c, sizeof(c), 1, f);
+	}
+	for (int m = 0; m < num_motors; m++)
+	{
+		for (int i = 0; i < NUM_MOTOR_FIELDS; i++)
+		{
+			memset(&c, 0, sizeof(c));
+			snprintf(c.name, sizeof(c.name), "%s%d", MOTOR_FIELDS[i].name, m);
+			c.type = MOTOR_FIELDS[i].type;
+			c.motor = m;
+			fwrite(&c, sizeof(c), 1, f);
+		}
+	}
+	fflush(f);
+}
+
+void TelemetryRecorder::run(void)
+{
+	while (running.load())
+	{
+		drain();
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+}
+
+void TelemetryRecorder::drain(void)
+{
+	TelemetryRow r;
+	while (queue.pop(r))
+	{
+		append(r);
+	}
+}
+
+//transpose one row into the chunk columns
+void TelemetryRecorder::append(const TelemetryRow& r)
+{
+	const unsigned char* src = (const unsigned char*)&r;
+	for (int c = 0; c < num_columns; c++)
+	{
+		memcpy(col_buf[c].data() + (size_t)chunk_fill * col_size[c], src + col_offset[c], col_size[c]);
+	}
+	if (chunk_fill == 0)
+	{
+		first_ts_ns = r.ts_ns;
+	}
+	last_ts_ns = r.ts_ns;
+	chunk_fill++;
+	if (chunk_fill == TELEMETRY_CHUNK_ROWS)
+	{
+		flush_chunk();
+	}
+}
+
+void TelemetryRecorder::flush_chunk(void)
+{
+	if (chunk_fill == 0)
+	{
+		return;
+	}
+	TelemetryChunkHeader h;
+	h.magic = TELEMETRY_CHUNK_MAGIC;
+	h.rows = chunk_fill;
+	h.index = chunk_index;
+	h.first_ts_ns = first_ts_ns;
+	h.last_ts_ns = last_ts_ns;
+	fwrite(&h, sizeof(h), 1, f);
+	for (int c = 0; c < num_columns; c++)
+	{
+		fwrite(col_buf[c].data(), col_size[c], chunk_fill, f);
+	}
+	fflush(f);
+	written.fetch_add(chunk_fill, std::memory_order_relaxed);
+	chunk_index++;
+	chunk_fill = 0;
+}
+
+TelemetryReader::TelemetryReader()
+	: f(NULL)
+	, num_motors(0)
+	, num_columns(0)
+	, chunk_rows(0)
+	, chunk_pos(0)
+{
+}
+
+TelemetryReader::~TelemetryReader()
+{
+	close();
+}
+
+bool TelemetryReader::open(const char* path)
+{
+	close();
+	f = fopen(path, "rb");
+	if (f == NULL)
+	{
+		printf("Reader: failed to open %s\n", path);
+		return false;
+	}
+	TelemetryFileHeader h;
+	if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, TELEMETRY_FILE_MAGIC, sizeof(h.magic)) != 0
+		|| h.num_motors > TELEMETRY_MAX_MOTORS || h.num_columns > TELEMETRY_MAX_COLUMNS)
+	{
+		printf("Reader: %s is not a telemetry file\n", path);
+		close();
+		return false;
+	}
+	num_motors = (int)h.num_motors;
+	num_columns = (int)h.num_columns;
+	for (int c = 0; c < num_columns; c++)
+	{
+		TelemetryColumn col;
+		if (fread(&col, sizeof(col), 1, f) != 1)
+		{
+			close();
+			return false;
+		}
+		col.name[sizeof(col.name) - 1] = 0;
+		col_size[c] = type_size(col.type);
+		col_offset[c] = -1;
+		if (col.motor < 0)
+		{
+			for (int i = 0; i < NUM_ROW_FIELDS; i++)
+			{
+				if (strcmp(col.name, ROW_FIELDS[i].name) == 0 && type_size(ROW_FIELDS[i].type) == col_size[c])
+					col_offset[c] = (long)ROW_FIELDS[i].offset;
+			}
+		}
+		else if (col.motor < TELEMETRY_MAX_MOTORS)
+		{
+			for (int i = 0; i < NUM_MOTOR_FIELDS; i++)
+			{
+				char name[24];
+				snprintf(name, sizeof(name), "%s%d", MOTOR_FIELDS[i].name, col.motor);
+				if (strcmp(col.name, name) == 0 && type_size(MOTOR_FIELDS[i].type) == col_size[c])
+					col_offset[c] = (long)(MOTOR_FIELDS[i].offset + (size_t)col.motor * sizeof(int32_t));
+			}
+		}
+		col_buf[c].assign(col_size[c] * h.chunk_rows, 0);
+	}
+	chunk_rows = 0;
+	chunk_pos = 0;
+	return true;
+}
+
+void TelemetryReader::close(void)
+{
+	if (f != NULL)
+	{
+		fclose(f);
+		f = NULL;
+	}
+}
+
+int TelemetryReader::motor_count(void) const
+{
+	return num_motors;
+}
+
+bool TelemetryReader::load_chunk(void)
+{
+	TelemetryChunkHeader h;
+	if (fread(&h, sizeof(h), 1, f) != 1)
+	{
+		return false;
+	}
+	if (h.magic != TELEMETRY_CHUNK_MAGIC || h.rows == 0)
+	{
+		printf("Reader: bad chunk header\n");
+		return false;
+	}
+	for (int c = 0; c < num_columns; c++)
+	{
+		if (col_buf[c].size() < col_size[c] * h.rows)
+		{
+			col_buf[c].resize(col_size[c] * h.rows);
+		}
+		if (fread(col_buf[c].data(), col_size[c], h.rows, f) != h.rows)
+		{
+			printf("Reader: truncated chunk %llu\n", (unsigned long long)h.index);
+			return false;
+		}
+	}
+	chunk_rows = h.rows;
+	chunk_pos = 0;
+	return true;
+}
+
+bool TelemetryReader::next(TelemetryRow& row)
+{
+	if (f == NULL)
+	{
+		return false;
+	}
+	if (chunk_pos >= chunk_rows && !load_chunk())
+	{
+		return false;
+	}
+	memset(&row, 0, sizeof(row));
+	for (int i = 0; i < TELEMETRY_MAX_MOTORS; i++)
+	{
+		row.rtt_us[i] = -1;
+	}
+	unsigned char* dst = (unsigned char*)&row;
+	for (int c = 0; c < num_columns; c++)
+	{
+		if (col_offset[c] >= 0)
+		{
+			memcpy(dst + col_offset[c], col_buf[c].data() + (size_t)chunk_pos * col_size[c], col_size[c]);
+		}
+	}
+	chunk_pos++;
+	return true;
+}
@@ -0,0 +1,175 @@
+#ifndef TELEMETRY_RECORDER_H
+#define TELEMETRY_RECORDER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "spsc_queue.h"
+
+#define TELEMETRY_MAX_MOTORS 8	//matches MAX_MOTORS in control_loop.h
+#define TELEMETRY_CHUNK_ROWS 4096
+#define TELEMETRY_QUEUE_ROWS 16384	//~16 s of slack at 1 kHz before rows are dropped
+
+/*
+	One control cycle as read by SpoolerRobot, in the raw fixed-point units the motors report.
+	command is the command_word in force when the telemetry was read, i.e. the one computed
+	from the previous row (sent with this exchange, or by the previous cycle's write()).
+	The controller inputs are the ones compute_tensions will see this cycle, so a replay
+	can reproduce the next row's command from this row alone.
+*/
+struct TelemetryRow
+{
+	int64_t ts_ns;	//udp_now_ns() when the cycle's replies had been gathered
+	int32_t flags;	//TELEMETRY_FLAG_*
+
+	//controller inputs
+	int32_t mode;	//FORCE_MODE / PCTL_TYPED / PCTL_CURSOR
+	int32_t clicked;
+	double xpos;
+	float k;
+	float kd;
+	float tmax;
+	float targ;
+	double traj_t_s;	//time the previous cycle's follow_trajectory() sampled targ at, on the caller's clock
+	float rom_degrees;
+	int32_t do_oscillation;
+
+	int32_t theta[TELEMETRY_MAX_MOTORS];	//theta_rem_m
+	int32_t iq[TELEMETRY_MAX_MOTORS];
+	int32_t dtheta[TELEMETRY_MAX_MOTORS];	//dtheta_fixedpoint_rad_p_sec
+	int32_t command[TELEMETRY_MAX_MOTORS];	//command_word
+	int32_t rtt_us[TELEMETRY_MAX_MOTORS];	//-1 if that motor did not answer
+};
+
+#define TELEMETRY_FLAG_COMMS_GOOD 0x1	//every motor answered
+#define TELEMETRY_FLAG_FUSED 0x2	//command and read shared one datagram (SpoolerRobot::exchange)
+#define TELEMETRY_FLAG_TARG_SET 0x4	//targ was set from the GUI this cycle, not by the controller
+#define TELEMETRY_FLAG_CALIBRATING 0x8	//read by SpoolerRobot::calibrate, which commands tensions itself
+#define TELEMETRY_FLAG_TENSION_SOLVER 0x10	//compute_tensions split the force with the tension solver (SpoolerRobot::use_tension_solver)
+
+/*
+	File layout, all little-endian:
+		TelemetryFileHeader
+		num_columns x TelemetryColumn
+		chunks: TelemetryChunkHeader, then each column as one contiguous array of rows values,
+		        in column-table order (the per-row fields, then per motor theta/iq/dtheta/command/rtt_us)
+	The last chunk may be short. A chunk is only ever written whole, so a crash loses at most
+	the rows still in memory. Readers match columns by name, so columns can be added without
+	breaking older files; fields a file lacks read back as zero.
+*/
+#define TELEMETRY_FILE_MAGIC "SPLTLM01"
+#define TELEMETRY_FILE_VERSION 3	//2: controller input columns, 3: traj_t_s
+#define TELEMETRY_CHUNK_MAGIC 0x4B4E4843u	//"CHNK"
+#define TELEMETRY_MAX_COLUMNS 64
+
+struct TelemetryFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t num_motors;
+	uint32_t num_columns;
+	uint32_t chunk_rows;	//rows per full chunk
+};
+
+typedef enum {TELEMETRY_INT64 = 0, TELEMETRY_INT32 = 1, TELEMETRY_FLOAT32 = 2, TELEMETRY_FLOAT64 = 3} telemetry_type_t;
+
+struct TelemetryColumn
+{
+	char name[24];
+	uint32_t type;	//telemetry_type_t
+	int32_t motor;	//-1 for per-row columns
+};
+
+struct TelemetryChunkHeader
+{
+	uint32_t magic;
+	uint32_t rows;
+	uint64_t index;
+	int64_t first_ts_ns;
+	int64_t last_ts_ns;
+};
+
+/*
+	Control thread side: push() copies a row into a lock-free queue and returns - no allocation,
+	no syscall, no lock. A writer thread transposes rows into per-column chunk buffers and writes
+	each chunk with one fwrite per column. Rows that do not fit in the queue are dropped and counted.
+*/
+class TelemetryRecorder
+{
+public:
+	TelemetryRecorder();
+	~TelemetryRecorder();
+
+	TelemetryRecorder(const TelemetryRecorder&) = delete;
+	TelemetryRecorder& operator=(const TelemetryRecorder&) = delete;
+
+	bool open(const char* path, int num_motors);
+	// Write out everything queued, including a final short chunk, and close the file
+	void close(void);
+	bool is_open(void) const;
+
+	// Producer (control thread). Returns false if the row was dropped.
+	bool push(const TelemetryRow& row);
+
+	uint64_t rows_written(void) const;
+	uint64_t rows_dropped(void) const;
+
+private:
+	FILE* f;
+	int num_motors;
+	SpscQueue<TelemetryRow> queue;
+	int num_columns;
+	size_t col_offset[TELEMETRY_MAX_COLUMNS];	//where each column lives in TelemetryRow
+	size_t col_size[TELEMETRY_MAX_COLUMNS];
+	std::vector<unsigned char> col_buf[TELEMETRY_MAX_COLUMNS];	//TELEMETRY_CHUNK_ROWS values each
+	int64_t first_ts_ns;
+	int64_t last_ts_ns;
+	uint32_t chunk_fill;
+	uint64_t chunk_index;
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> dropped;
+	std::thread writer;
+	std::atomic<bool> running;
+
+	void run(void);
+	void drain(void);
+	void append(const TelemetryRow& r);
+	void flush_chunk(void);
+	void write_header(void);
+};
+
+/*
+	Sequential reader for recorder files, one row at a time. Buffers one chunk.
+*/
+class TelemetryReader
+{
+public:
+	TelemetryReader();
+	~TelemetryReader();
+
+	TelemetryReader(const TelemetryReader&) = delete;
+	TelemetryReader& operator=(const TelemetryReader&) = delete;
+
+	bool open(const char* path);
+	void close(void);
+	int motor_count(void) const;
+
+	// Next row in file order. Returns false at the end of the file or on a damaged chunk.
+	bool next(TelemetryRow& row);
+
+private:
+	FILE* f;
+	int num_motors;
+	int num_columns;
+	long col_offset[TELEMETRY_MAX_COLUMNS];	//offset into TelemetryRow, -1 for columns this build does not know
+	size_t col_size[TELEMETRY_MAX_COLUMNS];
+	std::vector<unsigned char> col_buf[TELEMETRY_MAX_COLUMNS];
+	uint32_t chunk_rows;
+	uint32_t chunk_pos;
+
+	bool load_chunk(void);
+};
+
+#endif // TELEMETRY_RECORDER_H
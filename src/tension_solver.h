@@ -0,0 +1,524 @@
+#ifndef TENSION_SOLVER_H
+#define TENSION_SOLVER_H
+
+#include <cmath>
+#include <Eigen/Dense>
+
+/*
+	Tension distribution for a cable robot with N cables and M wrench dimensions (M = 1 for
+	the two-spool line, 2 or 3 for a point mass, 6 for a platform). Given the structure
+	matrix A (column i = the wrench cable i applies per unit tension) and a desired wrench w,
+	find tensions t with
+		A t = w,   tmin <= t <= tmax,   minimizing |t - tref|^2
+	i.e. the feasible tensions closest to a preferred level (usually tmin, to keep the
+	cables just taut).
+
+		N == M       one solution, t = A^-1 w, checked against the limits
+		N == M + 1   closed form: t = t0 + s n along the one-dimensional null space n of A,
+		             with s the optimum clamped to the interval the limits allow
+		otherwise    first the previous solve's set of cables at a limit is tried (one M x M
+		             solve, which is all a smoothly moving robot needs); failing that, a dual
+		             active-set QP (Goldfarb-Idnani) in the null space of A, which either
+		             finds the optimum or proves the limits cannot produce w
+	max_iterations is the hard budget: solve() never does more than that many QP steps (each
+	O(N^2) flops), and when it runs out it returns the limits-clamped best guess with
+	TENSION_BUDGET.
+	spooler_bench times the worst case (cold start) against the 1 ms control cycle.
+*/
+
+typedef enum {TENSION_OK, TENSION_INFEASIBLE, TENSION_BUDGET} tension_status_t;
+
+template <int M, int N>
+class TensionSolver
+{
+public:
+	static_assert(M >= 1 && N >= M, "need at least as many cables as wrench dimensions");
+
+	typedef Eigen::Matrix<double, M, N> StructMat;
+	typedef Eigen::Matrix<double, M, 1> Wrench;
+	typedef Eigen::Matrix<double, N, 1> Tensions;
+
+	Tensions tmin;
+	Tensions tmax;
+	Tensions tref;
+	int max_iterations;
+	double wrench_tol;	//largest |A t - w| component accepted as a solution
+
+	int iterations;	//warm-start solves and QP steps in the last call
+	Wrench residual;	//A t - w of the last result
+
+	TensionSolver()
+		: max_iterations(4 * N + 4)
+		, wrench_tol(1e-6)
+		, iterations(0)
+	{
+		tmin.setZero();
+		tmax.setConstant(1.0);
+		tref.setZero();
+		residual.setZero();
+		bound.setZero();
+	}
+
+	// Uniform limits, preferring the lower one
+	void set_limits(double lo, double hi)
+	{
+		tmin.setConstant(lo);
+		tmax.setConstant(hi);
+		tref.setConstant(lo);
+	}
+
+	// Forget the warm start, e.g. after a jump in pose or limits
+	void reset(void)
+	{
+		bound.setZero();
+	}
+
+	tension_status_t solve(const StructMat& A, const Wrench& w, Tensions& t)
+	{
+		iterations = 0;
+		if constexpr (N == M)
+		{
+			Eigen::PartialPivLU<StructMat> lu(A);
+			iterations = 1;
+			t = lu.solve(w);
+			return finish(A, w, t, !inside(t));
+		}
+		else if constexpr (N == M + 1)
+		{
+			int rc = solve_one_redundant(A, w, t);
+			if (rc >= 0)
+				return finish(A, w, t, rc == 0);
+			//A rank deficient: the active set handles it
+		}
+		return solve_active_set(A, w, t);
+	}
+
+private:
+	Eigen::Matrix<int, N, 1> bound;	//warm start: 0 free, -1 at tmin, +1 at tmax
+
+	bool inside(const Tensions& t) const
+	{
+		return (t.array() >= tmin.array() - wrench_tol).all() && (t.array() <= tmax.array() + wrench_tol).all();
+	}
+
+	tension_status_t finish(const StructMat& A, const Wrench& w, Tensions& t, bool infeasible)
+	{
+		if (infeasible)
+			t = t.cwiseMax(tmin).cwiseMin(tmax);
+		residual = A * t - w;
+		if (infeasible || residual.cwiseAbs().maxCoeff() > wrench_tol * (1.0 + w.cwiseAbs().maxCoeff()))
+			return TENSION_INFEASIBLE;
+		return TENSION_OK;
+	}
+
+	// N = M + 1. The null space direction has components (-1)^i det(A without column i).
+	// 1: solved, 0: no feasible tensions (t is the unclamped split nearest tref), -1: A rank deficient
+	int solve_one_redundant(const StructMat& A, const Wrench& w, Tensions& t)
+	{
+		Tensions n;
+		for (int i = 0; i < N; i++)
+		{
+			Eigen::Matrix<double, M, M> minor;
+			for (int c = 0, k = 0; c < N; c++)
+			{
+				if (c != i)
+					minor.col(k++) = A.col(c);
+			}
+			n[i] = ((i & 1) ? -1.0 : 1.0) * minor.determinant();
+		}
+		double nn = n.squaredNorm();
+		double scale = A.cwiseAbs().maxCoeff();
+		if (!(nn > 1e-18 * std::pow(scale, 2 * M)))
+		{
+			return -1;
+		}
+		iterations = 1;
+		Eigen::Matrix<double, M, M> AAt = A * A.transpose();
+		Tensions t0 = A.transpose() * AAt.ldlt().solve(w);	//minimum-norm particular solution
+
+		double lo = -INFINITY;
+		double hi = INFINITY;
+		for (int i = 0; i < N; i++)
+		{
+			if (n[i] > 0.0)
+			{
+				lo = std::fmax(lo, (tmin[i] - t0[i]) / n[i]);
+				hi = std::fmin(hi, (tmax[i] - t0[i]) / n[i]);
+			}
+			else if (n[i] < 0.0)
+			{
+				lo = std::fmax(lo, (tmax[i] - t0[i]) / n[i]);
+				hi = std::fmin(hi, (tmin[i] - t0[i]) / n[i]);
+			}
+			else if (t0[i] < tmin[i] - wrench_tol || t0[i] > tmax[i] + wrench_tol)
+			{
+				lo = INFINITY;	//this cable's tension is fixed by w, outside its limits
+			}
+		}
+		double s = n.dot(tref - t0) / nn;
+		if (lo <= hi)
+			s = std::fmin(std::fmax(s, lo), hi);
+		t = t0 + s * n;
+		return (lo <= hi) ? 1 : 0;
+	}
+
+	/*
+		Warm start: cables in the bound set sit at their limit, the free ones solve the
+		equality-constrained least squares  min |t_f - tref_f|^2  s.t.  A_f t_f = w - A_b t_b,
+		i.e. t_f = tref_f + A_f^T y with (A_f A_f^T) y = w - A_b t_b - A_f tref_f. If that is
+		inside the limits and every bound cable's KKT multiplier has the right sign, it is the
+		optimum and costs one M x M solve. Otherwise the QP below starts from scratch.
+	*/
+	bool try_warm_start(const StructMat& A, const Wrench& w, Tensions& t)
+	{
+		StructMat Af = A;
+		Tensions tb;
+		Tensions rf = tref;
+		tb.setZero();
+		int nfree = 0;
+		for (int i = 0; i < N; i++)
+		{
+			if (bound[i] != 0)
+			{
+				Af.col(i).setZero();
+				tb[i] = (bound[i] < 0) ? tmin[i] : tmax[i];
+				rf[i] = 0.0;
+			}
+			else
+			{
+				nfree++;
+			}
+		}
+		if (nfree < M)
+		{
+			return false;
+		}
+		Eigen::Matrix<double, M, M> K = Af * Af.transpose();
+		Eigen::LDLT<Eigen::Matrix<double, M, M>> ldlt(K);
+		if (ldlt.info() != Eigen::Success || !(ldlt.vectorD().cwiseAbs().minCoeff() > 1e-12 * (1.0 + K.diagonal().maxCoeff())))
+		{
+			return false;
+		}
+		Wrench y = ldlt.solve(w - A * tb - Af * rf);
+		iterations++;
+		t = tb + rf + Af.transpose() * y;
+		if (!inside(t))
+		{
+			return false;
+		}
+		//multiplier of each bound cable: t - tref - A^T y must be >= 0 at tmin, <= 0 at tmax
+		Tensions g = t - tref - A.transpose() * y;
+		for (int i = 0; i < N; i++)
+		{
+			if ((bound[i] < 0 && g[i] < -wrench_tol) || (bound[i] > 0 && g[i] > wrench_tol))
+				return false;
+		}
+		return true;
+	}
+
+	tension_status_t solve_active_set(const StructMat& A, const Wrench& w, Tensions& t)
+	{
+		if (try_warm_start(A, w, t))
+		{
+			return finish(A, w, t, false);
+		}
+		tension_status_t st = solve_qp(A, w, t);
+		if (st != TENSION_OK)
+		{
+			bound.setZero();
+			t = t.cwiseMax(tmin).cwiseMin(tmax);
+			residual = A * t - w;
+			return st;
+		}
+		return finish(A, w, t, false);
+	}
+
+	/*
+		Goldfarb-Idnani dual active-set method, in the null space of A so the equality is
+		exact: with A^T = Q [R1; 0], t = t0 + Z s where t0 = Q1 R1^-T w is the minimum-norm
+		solution and Z = Q2 is an orthonormal null-space basis. The objective becomes
+		|s - s*|^2 with s* = Z^T (tref - t0), and the limits become 2N inequalities
+			 z_i . s >= tmin_i - t0_i,   -z_i . s >= t0_i - tmax_i
+		Starting from the unconstrained optimum s*, each iteration adds the most violated
+		inequality, dropping active ones whose multipliers would go negative, with the
+		factorization updated by Givens rotations. It terminates at the optimum, or proves
+		the limits cannot be met (no step direction and no multiplier to drop).
+	*/
+	static constexpr int R = N - M;	//null space dimension
+	static constexpr int C = 2 * N;	//inequalities
+
+	tension_status_t solve_qp(const StructMat& A, const Wrench& w, Tensions& t)
+	{
+		Eigen::Matrix<double, N, M> At = A.transpose();
+		Eigen::HouseholderQR<Eigen::Matrix<double, N, M>> qr(At);
+		Eigen::Matrix<double, N, N> Q = qr.householderQ();
+		Eigen::Matrix<double, M, M> R1 = qr.matrixQR().template topRows<M>().template triangularView<Eigen::Upper>();
+		if (!(R1.diagonal().cwiseAbs().minCoeff() > 1e-12 * (1.0 + R1.diagonal().cwiseAbs().maxCoeff())))
+		{
+			t = tref;
+			return TENSION_INFEASIBLE;	//A does not have full rank: some wrench directions cannot be produced
+		}
+		Tensions t0 = Q.template leftCols<M>() * R1.transpose().template triangularView<Eigen::Lower>().solve(w);
+		Eigen::Matrix<double, N, R> Z = Q.template rightCols<R>();
+		Eigen::Matrix<double, R, 1> x = Z.transpose() * (tref - t0);
+
+		Eigen::Matrix<double, R, C> cons;
+		Eigen::Matrix<double, C, 1> lim;
+		for (int i = 0; i < N; i++)
+		{
+			cons.col(i) = Z.row(i).transpose();
+			lim[i] = tmin[i] - t0[i];
+			cons.col(N + i) = -Z.row(i).transpose();
+			lim[N + i] = t0[i] - tmax[i];
+		}
+
+		Eigen::Matrix<double, R, R> J = Eigen::Matrix<double, R, R>::Identity();
+		Eigen::Matrix<double, R, R> Rm = Eigen::Matrix<double, R, R>::Zero();
+		Eigen::Matrix<double, R + 1, 1> u = Eigen::Matrix<double, R + 1, 1>::Zero();
+		int active[R + 1];
+		bool excluded[C];
+		int iq = 0;
+		double r_norm = 1.0;
+		const double eps = 1e-12;
+		for (int i = 0; i < C; i++)
+			excluded[i] = false;
+
+		while (true)
+		{
+			//step 1: most violated inequality not in the active set
+			int p = -1;
+			double sp = -wrench_tol;
+			for (int i = 0; i < C; i++)
+			{
+				if (excluded[i] || is_active(active, iq, i))
+					continue;
+				double slack = cons.col(i).dot(x) - lim[i];
+				if (slack < sp)
+				{
+					sp = slack;
+					p = i;
+				}
+			}
+			if (p < 0)
+			{
+				t = t0 + Z * x;
+				update_bound(active, iq);
+				return TENSION_OK;
+			}
+			Eigen::Matrix<double, R, 1> np = cons.col(p);
+			u[iq] = 0.0;
+
+			Eigen::Matrix<double, R, 1> x_old = x;
+			Eigen::Matrix<double, R + 1, 1> u_old = u;
+			int active_old[R + 1] = {};
+			int iq_old = iq;
+			for (int i = 0; i < iq; i++)
+				active_old[i] = active[i];
+
+			while (true)
+			{
+				if (iterations >= max_iterations)
+				{
+					t = t0 + Z * x;
+					return TENSION_BUDGET;
+				}
+				iterations++;
+
+				//step 2a: primal direction z in the space orthogonal to the active set, dual direction r
+				Eigen::Matrix<double, R, 1> d = J.transpose() * np;
+				Eigen::Matrix<double, R, 1> z = Eigen::Matrix<double, R, 1>::Zero();
+				for (int j = iq; j < R; j++)
+					z += J.col(j) * d[j];
+				Eigen::Matrix<double, R, 1> r = Eigen::Matrix<double, R, 1>::Zero();
+				for (int i = iq - 1; i >= 0; i--)
+				{
+					double sum = d[i];
+					for (int j = i + 1; j < iq; j++)
+						sum -= Rm(i, j) * r[j];
+					r[i] = sum / Rm(i, i);
+				}
+
+				//step 2b: partial (dual) step t1 limited by active multipliers, full step t2
+				double t1 = INFINITY;
+				int l = -1;
+				for (int k = 0; k < iq; k++)
+				{
+					if (r[k] > eps && u[k] / r[k] < t1)
+					{
+						t1 = u[k] / r[k];
+						l = k;
+					}
+				}
+				double zn = z.dot(np);
+				double slack = np.dot(x) - lim[p];
+				double t2 = (z.squaredNorm() > eps * eps && zn > eps) ? -slack / zn : INFINITY;
+				double step = std::fmin(t1, t2);
+				if (step == INFINITY)
+				{
+					t = t0 + Z * x;
+					return TENSION_INFEASIBLE;
+				}
+
+				//step 2c
+				for (int k = 0; k < iq; k++)
+					u[k] -= step * r[k];
+				u[iq] += step;
+				if (t2 == INFINITY)
+				{
+					//dual step only
+					delete_constraint(J, Rm, u, active, iq, l);
+					continue;
+				}
+				x += step * z;
+				if (step == t2)
+				{
+					if (!add_constraint(J, Rm, d, iq, r_norm, eps))
+					{
+						//p depends on the active set: put everything back and try another one
+						excluded[p] = true;
+						x = x_old;
+						u = u_old;
+						iq = iq_old;
+						for (int i = 0; i < iq; i++)
+							active[i] = active_old[i];
+						rebuild(J, Rm, cons, active, iq, r_norm, eps);
+						break;
+					}
+					active[iq - 1] = p;
+					for (int i = 0; i < C; i++)
+						excluded[i] = false;
+					break;
+				}
+				delete_constraint(J, Rm, u, active, iq, l);
+			}
+		}
+	}
+
+	static bool is_active(const int* active, int iq, int c)
+	{
+		for (int i = 0; i < iq; i++)
+		{
+			if (active[i] == c)
+				return true;
+		}
+		return false;
+	}
+
+	void update_bound(const int* active, int iq)
+	{
+		bound.setZero();
+		for (int i = 0; i < iq; i++)
+			bound[active[i] % N] = (active[i] < N) ? -1 : 1;
+	}
+
+	// Append d's constraint to the QR of the active set: rotate d so only its first iq+1 entries remain
+	static bool add_constraint(Eigen::Matrix<double, R, R>& J, Eigen::Matrix<double, R, R>& Rm, Eigen::Matrix<double, R, 1>& d, int& iq, double& r_norm, double eps)
+	{
+		for (int j = R - 1; j >= iq + 1; j--)
+		{
+			double cc = d[j - 1];
+			double ss = d[j];
+			double h = std::hypot(cc, ss);
+			if (h == 0.0)
+				continue;
+			d[j] = 0.0;
+			ss /= h;
+			cc /= h;
+			if (cc < 0.0)
+			{
+				cc = -cc;
+				ss = -ss;
+				d[j - 1] = -h;
+			}
+			else
+			{
+				d[j - 1] = h;
+			}
+			double xny = ss / (1.0 + cc);
+			for (int k = 0; k < R; k++)
+			{
+				double a = J(k, j - 1);
+				double b = J(k, j);
+				J(k, j - 1) = a * cc + b * ss;
+				J(k, j) = xny * (a + J(k, j - 1)) - b;
+			}
+		}
+		iq++;
+		for (int i = 0; i < iq; i++)
+			Rm(i, iq - 1) = d[i];
+		if (std::fabs(d[iq - 1]) <= eps * r_norm)
+		{
+			iq--;
+			return false;
+		}
+		r_norm = std::fmax(r_norm, std::fabs(d[iq - 1]));
+		return true;
+	}
+
+	// Remove active entry l and restore the triangular factor with Givens rotations
+	static void delete_constraint(Eigen::Matrix<double, R, R>& J, Eigen::Matrix<double, R, R>& Rm, Eigen::Matrix<double, R + 1, 1>& u, int* active, int& iq, int l)
+	{
+		for (int i = l; i < iq - 1; i++)
+		{
+			active[i] = active[i + 1];
+			u[i] = u[i + 1];
+			Rm.col(i) = Rm.col(i + 1);
+		}
+		u[iq - 1] = u[iq];
+		u[iq] = 0.0;
+		Rm.col(iq - 1).setZero();
+		iq--;
+		for (int j = l; j < iq; j++)
+		{
+			double cc = Rm(j, j);
+			double ss = Rm(j + 1, j);
+			double h = std::hypot(cc, ss);
+			if (h == 0.0)
+				continue;
+			cc /= h;
+			ss /= h;
+			Rm(j + 1, j) = 0.0;
+			if (cc < 0.0)
+			{
+				Rm(j, j) = -h;
+				cc = -cc;
+				ss = -ss;
+			}
+			else
+			{
+				Rm(j, j) = h;
+			}
+			double xny = ss / (1.0 + cc);
+			for (int k = j + 1; k < iq; k++)
+			{
+				double a = Rm(j, k);
+				double b = Rm(j + 1, k);
+				Rm(j, k) = a * cc + b * ss;
+				Rm(j + 1, k) = xny * (a + Rm(j, k)) - b;
+			}
+			for (int k = 0; k < R; k++)
+			{
+				double a = J(k, j);
+				double b = J(k, j + 1);
+				J(k, j) = a * cc + b * ss;
+				J(k, j + 1) = xny * (J(k, j) + a) - b;
+			}
+		}
+	}
+
+	// Factor a restored active set from scratch
+	static void rebuild(Eigen::Matrix<double, R, R>& J, Eigen::Matrix<double, R, R>& Rm, const Eigen::Matrix<double, R, C>& cons, const int* active, int iq, double& r_norm, double eps)
+	{
+		J.setIdentity();
+		Rm.setZero();
+		r_norm = 1.0;
+		int n = 0;
+		for (int i = 0; i < iq; i++)
+		{
+			Eigen::Matrix<double, R, 1> d = J.transpose() * cons.col(active[i]);
+			add_constraint(J, Rm, d, n, r_norm, eps);
+		}
+	}
+};
+
+#endif // TENSION_SOLVER_H
@@ -0,0 +1,223 @@
+#include "trajectory.h"
+#include <algorithm>
+#include <cmath>
+
+void Trajectory::reset(double p0)
+{
+	segs.clear();
+	cursor = 0;
+	start_p = p0;
+	end_p = p0;
+	end_t = 0.0;
+}
+
+void Trajectory::push(double t0, double c0, double c1, double c2, double c3)
+{
+	TrajPiece s;
+	s.t0 = t0;
+	s.c[0] = c0;
+	s.c[1] = c1;
+	s.c[2] = c2;
+	s.c[3] = c3;
+	segs.push_back(s);
+}
+
+void Trajectory::append_hold(double seconds)
+{
+	if (seconds <= 0.0)
+		return;
+	push(end_t, end_p, 0.0, 0.0, 0.0);
+	end_t += seconds;
+}
+
+/*
+	Rest-to-rest S-curve over distance h: jerk phases of length tj, acceleration phases of
+	length ta (including its two jerk phases), cruise tv, mirrored for deceleration. Cases:
+		vmax reached, amax reached         tj = a/j, ta = tj + v/a
+		vmax reached, amax not             tj = sqrt(v/j), ta = 2 tj
+		vmax not reached, amax reached     tj = a/j, ta solves h = a (ta - tj) ta
+		neither                            tj = cbrt(h / 2j), ta = 2 tj
+	The seven pieces are then integrated from constant jerk +j, 0, -j, 0, -j, 0, +j.
+*/
+bool Trajectory::append_scurve(double p1, const TrajLimits& lim)
+{
+	if (lim.vmax <= 0.0 || lim.amax <= 0.0 || lim.jmax <= 0.0)
+	{
+		return false;
+	}
+	double h = p1 - end_p;
+	double dir = h < 0.0 ? -1.0 : 1.0;
+	h = std::fabs(h);
+	if (h == 0.0)
+	{
+		return true;
+	}
+	const double v = lim.vmax;
+	const double a = lim.amax;
+	const double j = lim.jmax;
+
+	double tj, ta, tv;
+	if (v * j >= a * a)
+	{
+		tj = a / j;
+		ta = tj + v / a;
+	}
+	else
+	{
+		tj = std::sqrt(v / j);
+		ta = 2.0 * tj;
+	}
+	tv = h / v - ta;
+	if (tv < 0.0)
+	{
+		tv = 0.0;
+		if (h >= 2.0 * a * a * a / (j * j))
+		{
+			tj = a / j;
+			ta = 0.5 * tj + std::sqrt(0.25 * tj * tj + h / a);
+		}
+		else
+		{
+			tj = std::cbrt(h / (2.0 * j));
+			ta = 2.0 * tj;
+		}
+	}
+
+	const double dur[7] = {tj, ta - 2.0 * tj, tj, tv, tj, ta - 2.0 * tj, tj};
+	const double jerk[7] = {j, 0.0, -j, 0.0, -j, 0.0, j};
+	double p = end_p;
+	double vel = 0.0;
+	double acc = 0.0;
+	double t = end_t;
+	for (int i = 0; i < 7; i++)
+	{
+		double d = dur[i];
+		if (d <= 0.0)
+			continue;
+		double jk = dir * jerk[i];
+		push(t, p, vel, 0.5 * acc, jk / 6.0);
+		p += vel * d + 0.5 * acc * d * d + jk * d * d * d / 6.0;
+		vel += acc * d + 0.5 * jk * d * d;
+		acc += jk * d;
+		t += d;
+	}
+	end_p = p1;	//the integrated end is within rounding of p1; hold exactly p1 from here
+	end_t = t;
+	return true;
+}
+
+/*
+	Clamped cubic spline (zero slope at both ends) through the current end and the
+	waypoints. The second derivatives m at the knots solve the tridiagonal system
+		h[i-1] m[i-1] + 2 (h[i-1] + h[i]) m[i] + h[i] m[i+1] = 6 (slope[i] - slope[i-1])
+	with slope[i] = (y[i+1] - y[i]) / h[i], solved with the Thomas algorithm.
+*/
+bool Trajectory::append_spline(const double* dt, const double* p, int n)
+{
+	if (n < 1)
+	{
+		return false;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		if (!(dt[i] > 0.0))
+			return false;
+	}
+
+	int k = n + 1;	//knots, including the current end
+	std::vector<double> y(k), hs(n), m(k), diag(k), upper(k), rhs(k);
+	y[0] = end_p;
+	for (int i = 0; i < n; i++)
+	{
+		y[i + 1] = p[i];
+		hs[i] = dt[i];
+	}
+
+	//second derivatives m: clamped ends give 2 h0 m0 + h0 m1 = 6 ((y1 - y0)/h0 - 0), mirrored at the far end
+	for (int i = 0; i < k; i++)
+	{
+		double lower = 0.0;
+		if (i == 0)
+		{
+			diag[i] = 2.0 * hs[0];
+			upper[i] = hs[0];
+			rhs[i] = 6.0 * (y[1] - y[0]) / hs[0];
+		}
+		else if (i == k - 1)
+		{
+			lower = hs[n - 1];
+			diag[i] = 2.0 * hs[n - 1];
+			upper[i] = 0.0;
+			rhs[i] = -6.0 * (y[k - 1] - y[k - 2]) / hs[n - 1];
+		}
+		else
+		{
+			lower = hs[i - 1];
+			diag[i] = 2.0 * (hs[i - 1] + hs[i]);
+			upper[i] = hs[i];
+			rhs[i] = 6.0 * ((y[i + 1] - y[i]) / hs[i] - (y[i] - y[i - 1]) / hs[i - 1]);
+		}
+		if (i > 0)
+		{
+			double w = lower / diag[i - 1];
+			diag[i] -= w * upper[i - 1];
+			rhs[i] -= w * rhs[i - 1];
+		}
+	}
+	m[k - 1] = rhs[k - 1] / diag[k - 1];
+	for (int i = k - 2; i >= 0; i--)
+	{
+		m[i] = (rhs[i] - upper[i] * m[i + 1]) / diag[i];
+	}
+
+	double t = end_t;
+	for (int i = 0; i < n; i++)
+	{
+		double h = hs[i];
+		double slope = (y[i + 1] - y[i]) / h - h * (2.0 * m[i] + m[i + 1]) / 6.0;
+		push(t, y[i], slope, 0.5 * m[i], (m[i + 1] - m[i]) / (6.0 * h));
+		t += h;
+	}
+	end_p = y[k - 1];
+	end_t = t;
+	return true;
+}
+
+double Trajectory::sample(double t, double* vel)
+{
+	if (segs.empty())
+	{
+		if (vel != nullptr)
+			*vel = 0.0;
+		return end_p;
+	}
+	if (loop && end_t > 0.0)
+	{
+		t = std::fmod(t, end_t);
+		if (t < 0.0)
+			t += end_t;
+	}
+	if (t >= end_t || t < 0.0)
+	{
+		if (vel != nullptr)
+			*vel = 0.0;
+		return t < 0.0 ? start_p : end_p;
+	}
+
+	if (t < segs[cursor].t0)
+	{
+		//went backwards (or wrapped): last piece starting at or before t
+		cursor = (size_t)(std::upper_bound(segs.begin(), segs.end(), t,
+			[](double tv, const TrajPiece& s) { return tv < s.t0; }) - segs.begin()) - 1;
+	}
+	while (cursor + 1 < segs.size() && t >= segs[cursor + 1].t0)
+	{
+		cursor++;
+	}
+
+	const TrajPiece& s = segs[cursor];
+	double tau = t - s.t0;
+	if (vel != nullptr)
+		*vel = s.c[1] + tau * (2.0 * s.c[2] + tau * 3.0 * s.c[3]);
+	return s.c[0] + tau * (s.c[1] + tau * (s.c[2] + tau * s.c[3]));
+}
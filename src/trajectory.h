@@ -0,0 +1,71 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <cstddef>
+#include <vector>
+
+/*
+	Setpoint profiles for the position loop, built once and sampled every control cycle.
+
+	A Trajectory is a chain of cubic pieces in time. Planning works out each piece's
+	coefficients up front, so sample() is a cursor check and one Horner evaluation:
+	O(1) per tick while time moves forward (a backwards jump costs one binary search).
+	Pieces are appended from wherever the chain currently ends:
+		append_scurve   time-optimal rest-to-rest move under velocity, acceleration and jerk
+		                limits: the 7-phase jerk-limited S-curve, shortened phases when the
+		                move is too short to reach the limits
+		append_spline   cubic spline through waypoints at given times, C2 inside, starting
+		                and ending at rest so it chains with the other pieces. Its speed is
+		                set by the timing, not checked against any limit.
+		append_hold     stay put
+	Units are whatever the positions are in (degrees for SpoolerRobot::targ) and seconds.
+*/
+
+struct TrajLimits
+{
+	double vmax;	//units/s
+	double amax;	//units/s^2
+	double jmax;	//units/s^3
+};
+
+struct TrajPiece
+{
+	double t0;	//start time within the trajectory
+	double c[4];	//position = c0 + c1 tau + c2 tau^2 + c3 tau^3, tau = t - t0
+};
+
+class Trajectory
+{
+public:
+	bool loop = false;	//sample() wraps time by duration() instead of holding the end position
+
+	// Empty trajectory resting at p0
+	void reset(double p0);
+
+	// false (and nothing appended) if a limit is not positive
+	bool append_scurve(double p1, const TrajLimits& lim);
+	void append_hold(double seconds);
+	// n waypoints; dt[i] is the time from the previous point (the current end for i = 0) to p[i].
+	// false (and nothing appended) if n < 1 or any dt is not positive.
+	bool append_spline(const double* dt, const double* p, int n);
+
+	double duration(void) const { return end_t; }
+	double end_position(void) const { return end_p; }
+	size_t pieces(void) const { return segs.size(); }
+	bool empty(void) const { return segs.empty(); }
+
+	// Position at t seconds from the start; clamped to the ends unless loop is set.
+	// vel, if given, receives the first derivative.
+	double sample(double t, double* vel = nullptr);
+
+private:
+	std::vector<TrajPiece> segs;
+	size_t cursor = 0;
+	double start_p = 0.0;
+	double end_p = 0.0;
+	double end_t = 0.0;
+
+	void push(double t0, double c0, double c1, double c2, double c3);
+};
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,161 @@
+#include "trig_batch.h"
+#include "trig_batch_simd.h"
+#include <atomic>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static void sin_14b_scalar(const int32_t* theta, int32_t* out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = sin_14b(theta[i]);
+	}
+}
+
+static void cos_14b_scalar(const int32_t* theta, int32_t* out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = cos_14b(theta[i]);
+	}
+}
+
+static void atan2_14b_scalar(const int32_t* y, const int32_t* x, int32_t* out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = atan2_14b(y[i], x[i]);
+	}
+}
+
+static void sqrt_i32_scalar(const int32_t* v, int32_t* out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = sqrt_i32(v[i]);
+	}
+}
+
+static const TrigBatchKernels scalar_kernels = {
+	&sin_14b_scalar,
+	&cos_14b_scalar,
+	&atan2_14b_scalar,
+	&sqrt_i32_scalar,
+};
+
+static bool cpu_has(trig_batch_isa_t isa)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int r[4];
+	__cpuid(r, 1);
+	bool sse41 = (r[2] & (1 << 19)) != 0;
+	bool os_ymm = (r[2] & (1 << 27)) != 0 && (r[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;	//OSXSAVE, AVX, XMM+YMM state enabled
+	__cpuidex(r, 7, 0);
+	bool avx2 = os_ymm && (r[1] & (1 << 5)) != 0;
+	return (isa == TRIG_BATCH_SSE41) ? sse41 : avx2;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	return (isa == TRIG_BATCH_SSE41) ? __builtin_cpu_supports("sse4.1") != 0 : __builtin_cpu_supports("avx2") != 0;	//includes the OS check
+#else
+	(void)isa;
+	return false;
+#endif
+}
+
+static const TrigBatchKernels* kernels_for(trig_batch_isa_t isa)
+{
+	switch (isa)
+	{
+	case TRIG_BATCH_SCALAR:
+		return &scalar_kernels;
+	case TRIG_BATCH_SSE41:
+		return cpu_has(isa) ? trig_batch_kernels_sse41() : nullptr;
+	case TRIG_BATCH_AVX2:
+		return cpu_has(isa) ? trig_batch_kernels_avx2() : nullptr;
+	}
+	return nullptr;
+}
+
+static std::atomic<const TrigBatchKernels*> g_kernels(nullptr);
+static std::atomic<int> g_isa(TRIG_BATCH_SCALAR);
+
+static const TrigBatchKernels* active(void)
+{
+	const TrigBatchKernels* k = g_kernels.load(std::memory_order_acquire);
+	if (k != nullptr)
+	{
+		return k;
+	}
+	//first use: best supported set. Racing threads all pick the same one.
+	for (int isa = TRIG_BATCH_AVX2; isa >= TRIG_BATCH_SCALAR; isa--)
+	{
+		k = kernels_for((trig_batch_isa_t)isa);
+		if (k != nullptr)
+		{
+			g_isa.store(isa);
+			g_kernels.store(k, std::memory_order_release);
+			return k;
+		}
+	}
+	return &scalar_kernels;
+}
+
+void sin_14b_batch(const int32_t* theta, int32_t* out, size_t n)
+{
+	active()->sin_14b(theta, out, n);
+}
+
+void cos_14b_batch(const int32_t* theta, int32_t* out, size_t n)
+{
+	active()->cos_14b(theta, out, n);
+}
+
+void atan2_14b_batch(const int32_t* y, const int32_t* x, int32_t* out, size_t n)
+{
+	active()->atan2_14b(y, x, out, n);
+}
+
+void sqrt_i32_batch(const int32_t* v, int32_t* out, size_t n)
+{
+	active()->sqrt_i32(v, out, n);
+}
+
+trig_batch_isa_t trig_batch_isa(void)
+{
+	active();
+	return (trig_batch_isa_t)g_isa.load();
+}
+
+const char* trig_batch_isa_name(trig_batch_isa_t isa)
+{
+	switch (isa)
+	{
+	case TRIG_BATCH_SCALAR:
+		return "scalar";
+	case TRIG_BATCH_SSE41:
+		return "sse4.1";
+	case TRIG_BATCH_AVX2:
+		return "avx2";
+	}
+	return "unknown";
+}
+
+int trig_batch_isa_supported(trig_batch_isa_t isa)
+{
+	return kernels_for(isa) != nullptr;
+}
+
+int trig_batch_set_isa(trig_batch_isa_t isa)
+{
+	const TrigBatchKernels* k = kernels_for(isa);
+	if (k == nullptr)
+	{
+		return 0;
+	}
+	g_isa.store(isa);
+	g_kernels.store(k, std::memory_order_release);
+	return 1;
+}
@@ -0,0 +1,40 @@
+#ifndef TRIG_BATCH_H
+#define TRIG_BATCH_H
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+	Array versions of the trig_fixed functions for host-side bulk work (log analysis,
+	simulation, FOC diagnostics). Every output element is bit-identical to calling the
+	scalar function on the same input, including the scalar code's int32 wraparound outside
+	its documented range - trig_batch_verify checks this exhaustively.
+
+	The kernel set (AVX2, SSE4.1 or the scalar loop) is picked on first use from what the
+	CPU supports. trig_fixed.c itself is untouched, so it stays shareable with the firmware.
+	in and out may be the same array; any alignment is fine.
+*/
+
+typedef enum {TRIG_BATCH_SCALAR = 0, TRIG_BATCH_SSE41 = 1, TRIG_BATCH_AVX2 = 2} trig_batch_isa_t;
+
+void sin_14b_batch(const int32_t* theta, int32_t* out, size_t n);
+void cos_14b_batch(const int32_t* theta, int32_t* out, size_t n);
+void atan2_14b_batch(const int32_t* y, const int32_t* x, int32_t* out, size_t n);
+void sqrt_i32_batch(const int32_t* v, int32_t* out, size_t n);
+
+// Kernel set in use
+trig_batch_isa_t trig_batch_isa(void);
+const char* trig_batch_isa_name(trig_batch_isa_t isa);
+// Whether this build and CPU can run isa
+int trig_batch_isa_supported(trig_batch_isa_t isa);
+// Switch kernel sets, e.g. to compare them. Returns 0 (and changes nothing) if isa is not supported.
+int trig_batch_set_isa(trig_batch_isa_t isa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRIG_BATCH_H
@@ -0,0 +1,72 @@
+/*
+	AVX2 kernels for trig_batch, 8 lanes. Built with -mavx2 (/arch:AVX2 on MSVC, see
+	CMakeLists.txt); only called after trig_batch has checked the CPU and OS support it.
+*/
+#define TRIG_BATCH_KERNELS
+#include "trig_batch_simd.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2
+{
+	typedef __m256i vec;
+	static const size_t LANES = 8;
+
+	static inline vec load(const int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static inline void store(int32_t* p, vec v) { _mm256_storeu_si256((__m256i*)p, v); }
+	static inline vec set1(int32_t v) { return _mm256_set1_epi32(v); }
+	static inline vec add(vec a, vec b) { return _mm256_add_epi32(a, b); }
+	static inline vec sub(vec a, vec b) { return _mm256_sub_epi32(a, b); }
+	static inline vec mullo(vec a, vec b) { return _mm256_mullo_epi32(a, b); }
+	static inline vec srai14(vec a) { return _mm256_srai_epi32(a, 14); }
+	static inline vec slli14(vec a) { return _mm256_slli_epi32(a, 14); }
+	static inline vec gt(vec a, vec b) { return _mm256_cmpgt_epi32(a, b); }
+	static inline vec eq(vec a, vec b) { return _mm256_cmpeq_epi32(a, b); }
+	static inline vec and_(vec a, vec b) { return _mm256_and_si256(a, b); }
+	static inline vec or_(vec a, vec b) { return _mm256_or_si256(a, b); }
+	static inline vec andnot(vec a, vec b) { return _mm256_andnot_si256(a, b); }
+	static inline vec blend(vec a, vec b, vec mask) { return _mm256_blendv_epi8(a, b, mask); }
+	static inline vec abs(vec a) { return _mm256_abs_epi32(a); }
+	static inline vec min(vec a, vec b) { return _mm256_min_epi32(a, b); }
+	static inline vec max(vec a, vec b) { return _mm256_max_epi32(a, b); }
+
+	//see the SSE4.1 version for why these are exact
+	static inline vec div_trunc(vec a, vec b)
+	{
+		__m256d lo = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(a)), _mm256_cvtepi32_pd(_mm256_castsi256_si128(b)));
+		__m256d hi = _mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(a, 1)), _mm256_cvtepi32_pd(_mm256_extracti128_si256(b, 1)));
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_cvttpd_epi32(lo)), _mm256_cvttpd_epi32(hi), 1);
+	}
+
+	static inline __m128i sqrt_half(__m128i v)
+	{
+		__m256d d = _mm256_cvtepi32_pd(v);
+		__m256d wrap = _mm256_cvtepi32_pd(_mm_srai_epi32(v, 31));	//-1.0 for negative lanes
+		return _mm256_cvttpd_epi32(_mm256_sqrt_pd(_mm256_sub_pd(d, _mm256_mul_pd(wrap, _mm256_set1_pd(4294967296.0)))));
+	}
+	static inline vec sqrt_u32(vec v)
+	{
+		__m128i lo = sqrt_half(_mm256_castsi256_si128(v));
+		__m128i hi = sqrt_half(_mm256_extracti128_si256(v, 1));
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+	}
+};
+
+}
+
+const TrigBatchKernels* trig_batch_kernels_avx2(void)
+{
+	return make_kernels<Avx2>();
+}
+
+#else
+
+const TrigBatchKernels* trig_batch_kernels_avx2(void)
+{
+	return nullptr;
+}
+
+#endif
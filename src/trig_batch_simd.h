@@ -0,0 +1,200 @@
+#ifndef TRIG_BATCH_SIMD_H
+#define TRIG_BATCH_SIMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "trig_fixed.h"
+
+/*
+	Internal to trig_batch: the per-ISA kernel tables, and the kernels themselves written once
+	against a small vector-ops struct V. Each ISA translation unit is compiled with its own
+	target flags, defines its V and TRIG_BATCH_KERNELS, then includes this header, so every
+	instantiation has internal linkage and nothing compiled for AVX2 leaks into shared code.
+*/
+struct TrigBatchKernels
+{
+	void (*sin_14b)(const int32_t* theta, int32_t* out, size_t n);
+	void (*cos_14b)(const int32_t* theta, int32_t* out, size_t n);
+	void (*atan2_14b)(const int32_t* y, const int32_t* x, int32_t* out, size_t n);
+	void (*sqrt_i32)(const int32_t* v, int32_t* out, size_t n);
+};
+
+// nullptr when the ISA was not compiled in (non-x86 target, or the source lacked its flags)
+const TrigBatchKernels* trig_batch_kernels_sse41(void);
+const TrigBatchKernels* trig_batch_kernels_avx2(void);
+
+#ifdef TRIG_BATCH_KERNELS
+
+//polynomial coefficients of sin_14b and atan2_14b (file-static in trig_fixed.c)
+static const int32_t TB_SC1_14B = 469;
+static const int32_t TB_SC2_14B = -3339;
+static const int32_t TB_SC3_14B = 342;
+static const int32_t TB_SC4_14B = 16310;
+static const int32_t TB_SC5_14B = 4;
+static const int32_t TB_TC1_14B = 2310;
+static const int32_t TB_TC2_14B = -5625;
+static const int32_t TB_TC3_14B = -266;
+static const int32_t TB_TC4_14B = 16447;
+static const int32_t TB_TC5_14B = -3 * 16384;
+
+/*
+	V provides, on int32 lanes unless noted:
+		vec, LANES, load, store, set1, add, sub, mullo, srai14, slli14, gt, eq,
+		and_, or_, andnot (~a & b), blend (mask ? b : a), abs, min, max,
+		div_trunc (exact truncating a / b for b != 0), sqrt_u32 (floor sqrt of the lane as uint32)
+	Signed arithmetic wraps like the scalar code compiled for the firmware.
+*/
+template <class V>
+static inline typename V::vec sin_14b_lanes(typename V::vec theta)
+{
+	typedef typename V::vec vec;
+	const vec zero = V::set1(0);
+	const vec half_pi = V::set1(HALF_PI_14B);
+	const vec pi = V::set1(PI_14B);
+	const vec neg_pi = V::set1(-PI_14B);
+	const vec three_half_pi = V::set1(THREE_BY_TWO_PI_14B);
+	const vec two_pi = V::set1(TWO_PI_14B);
+
+	vec is_zero = V::or_(V::eq(theta, zero), V::or_(V::eq(theta, pi), V::eq(theta, neg_pi)));
+
+	//quadrant folding, same conditions as sin_14b. The ranges are disjoint, so no else-chain is needed.
+	vec q2 = V::andnot(V::gt(theta, pi), V::gt(theta, half_pi));	//(H, PI]
+	vec q3 = V::and_(V::gt(theta, V::sub(pi, V::set1(1))), V::gt(three_half_pi, theta));	//[PI, 3H)
+	q3 = V::andnot(q2, q3);
+	vec q4 = V::and_(V::gt(theta, three_half_pi), V::gt(two_pi, theta));	//(3H, 2PI)
+	vec q3n = V::andnot(V::gt(neg_pi, theta), V::gt(V::sub(zero, half_pi), theta));	//[-PI, -H)
+	vec q4n = V::andnot(V::gt(V::sub(zero, half_pi), theta), V::gt(zero, theta));	//[-H, 0)
+
+	vec t = theta;
+	t = V::blend(t, V::sub(pi, theta), q2);
+	t = V::blend(t, V::sub(theta, pi), q3);
+	t = V::blend(t, V::sub(theta, two_pi), q4);
+	t = V::blend(t, V::add(theta, pi), q3n);
+	t = V::blend(t, V::sub(zero, theta), q4n);
+	vec is_neg = V::or_(q3, V::or_(q3n, q4n));
+
+	vec t2 = V::srai14(V::mullo(t, t));
+	vec t3 = V::srai14(V::mullo(t2, t));
+	vec t4 = V::srai14(V::mullo(t3, t));
+	vec res = V::mullo(V::set1(TB_SC1_14B), t4);
+	res = V::add(res, V::mullo(V::set1(TB_SC2_14B), t3));
+	res = V::add(res, V::mullo(V::set1(TB_SC3_14B), t2));
+	res = V::add(res, V::mullo(V::set1(TB_SC4_14B), t));
+	res = V::add(res, V::set1(TB_SC5_14B << 14));
+	res = V::srai14(res);
+
+	res = V::blend(res, V::sub(zero, res), is_neg);
+	return V::andnot(is_zero, res);
+}
+
+template <class V>
+static inline typename V::vec atan2_14b_lanes(typename V::vec y, typename V::vec x)
+{
+	typedef typename V::vec vec;
+	const vec zero = V::set1(0);
+	const vec half_pi = V::set1(HALF_PI_14B);
+	const vec pi = V::set1(PI_14B);
+
+	vec abs_s = V::abs(y);
+	vec abs_c = V::abs(x);
+	vec minv = V::min(abs_s, abs_c);
+	vec maxv = V::max(abs_s, abs_c);
+	vec x_zero = V::eq(x, zero);
+	vec y_zero = V::eq(y, zero);
+	//the edge cases below replace the lanes that would divide by zero
+	vec a = V::div_trunc(V::slli14(minv), V::blend(maxv, V::set1(1), V::eq(maxv, zero)));
+
+	vec a2 = V::srai14(V::mullo(a, a));
+	vec a3 = V::srai14(V::mullo(a2, a));
+	vec a4 = V::srai14(V::mullo(a3, a));
+	vec r = V::mullo(a4, V::set1(TB_TC1_14B));
+	r = V::add(r, V::mullo(a3, V::set1(TB_TC2_14B)));
+	r = V::add(r, V::mullo(a2, V::set1(TB_TC3_14B)));
+	r = V::add(r, V::mullo(a, V::set1(TB_TC4_14B)));
+	r = V::add(r, V::set1(TB_TC5_14B));
+	r = V::srai14(r);
+
+	r = V::blend(r, V::sub(half_pi, r), V::gt(abs_s, abs_c));
+	r = V::blend(r, V::sub(pi, r), V::gt(zero, x));
+	r = V::blend(r, V::sub(zero, r), V::gt(zero, y));
+
+	//x == 0: 0, +H or -H by the sign of y; y == 0 (x != 0): 0 or PI by the sign of x
+	vec on_y_axis = V::blend(V::and_(V::gt(y, zero), half_pi), V::sub(zero, half_pi), V::gt(zero, y));
+	vec on_x_axis = V::and_(V::gt(zero, x), pi);
+	r = V::blend(r, on_x_axis, y_zero);
+	r = V::blend(r, on_y_axis, x_zero);
+	return r;
+}
+
+template <class V>
+static void sin_14b_kernel(const int32_t* theta, int32_t* out, size_t n)
+{
+	size_t i = 0;
+	for (; i + V::LANES <= n; i += V::LANES)
+	{
+		V::store(out + i, sin_14b_lanes<V>(V::load(theta + i)));
+	}
+	for (; i < n; i++)
+	{
+		out[i] = sin_14b(theta[i]);
+	}
+}
+
+template <class V>
+static void cos_14b_kernel(const int32_t* theta, int32_t* out, size_t n)
+{
+	size_t i = 0;
+	const typename V::vec half_pi = V::set1(HALF_PI_14B);
+	for (; i + V::LANES <= n; i += V::LANES)
+	{
+		V::store(out + i, sin_14b_lanes<V>(V::add(V::load(theta + i), half_pi)));
+	}
+	for (; i < n; i++)
+	{
+		out[i] = cos_14b(theta[i]);
+	}
+}
+
+template <class V>
+static void atan2_14b_kernel(const int32_t* y, const int32_t* x, int32_t* out, size_t n)
+{
+	size_t i = 0;
+	for (; i + V::LANES <= n; i += V::LANES)
+	{
+		V::store(out + i, atan2_14b_lanes<V>(V::load(y + i), V::load(x + i)));
+	}
+	for (; i < n; i++)
+	{
+		out[i] = atan2_14b(y[i], x[i]);
+	}
+}
+
+template <class V>
+static void sqrt_i32_kernel(const int32_t* v, int32_t* out, size_t n)
+{
+	size_t i = 0;
+	for (; i + V::LANES <= n; i += V::LANES)
+	{
+		V::store(out + i, V::sqrt_u32(V::load(v + i)));
+	}
+	for (; i < n; i++)
+	{
+		out[i] = sqrt_i32(v[i]);
+	}
+}
+
+template <class V>
+static const TrigBatchKernels* make_kernels(void)
+{
+	static const TrigBatchKernels k = {
+		&sin_14b_kernel<V>,
+		&cos_14b_kernel<V>,
+		&atan2_14b_kernel<V>,
+		&sqrt_i32_kernel<V>,
+	};
+	return &k;
+}
+
+#endif // TRIG_BATCH_KERNELS
+
+#endif // TRIG_BATCH_SIMD_H
@@ -0,0 +1,74 @@
+/*
+	SSE4.1 kernels for trig_batch, 4 lanes. Built with -msse4.1 (see CMakeLists.txt);
+	only called after trig_batch has checked the CPU supports it.
+*/
+#define TRIG_BATCH_KERNELS
+#include "trig_batch_simd.h"
+
+#if defined(__SSE4_1__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+#include <smmintrin.h>
+
+namespace {
+
+struct Sse41
+{
+	typedef __m128i vec;
+	static const size_t LANES = 4;
+
+	static inline vec load(const int32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static inline void store(int32_t* p, vec v) { _mm_storeu_si128((__m128i*)p, v); }
+	static inline vec set1(int32_t v) { return _mm_set1_epi32(v); }
+	static inline vec add(vec a, vec b) { return _mm_add_epi32(a, b); }
+	static inline vec sub(vec a, vec b) { return _mm_sub_epi32(a, b); }
+	static inline vec mullo(vec a, vec b) { return _mm_mullo_epi32(a, b); }
+	static inline vec srai14(vec a) { return _mm_srai_epi32(a, 14); }
+	static inline vec slli14(vec a) { return _mm_slli_epi32(a, 14); }
+	static inline vec gt(vec a, vec b) { return _mm_cmpgt_epi32(a, b); }
+	static inline vec eq(vec a, vec b) { return _mm_cmpeq_epi32(a, b); }
+	static inline vec and_(vec a, vec b) { return _mm_and_si128(a, b); }
+	static inline vec or_(vec a, vec b) { return _mm_or_si128(a, b); }
+	static inline vec andnot(vec a, vec b) { return _mm_andnot_si128(a, b); }
+	static inline vec blend(vec a, vec b, vec mask) { return _mm_blendv_epi8(a, b, mask); }
+	static inline vec abs(vec a) { return _mm_abs_epi32(a); }
+	static inline vec min(vec a, vec b) { return _mm_min_epi32(a, b); }
+	static inline vec max(vec a, vec b) { return _mm_max_epi32(a, b); }
+
+	//int32 / int32 is exact in double (both operands < 2^53), and cvtt truncates toward zero like C
+	static inline vec div_trunc(vec a, vec b)
+	{
+		__m128d lo = _mm_div_pd(_mm_cvtepi32_pd(a), _mm_cvtepi32_pd(b));
+		__m128d hi = _mm_div_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(a, a)), _mm_cvtepi32_pd(_mm_unpackhi_epi64(b, b)));
+		return _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo), _mm_cvttpd_epi32(hi));
+	}
+
+	//sqrt_i32 treats its input as uint32. The double sqrt of an integer < 2^32 is never close
+	//enough to the next integer to round up to it, so truncating gives the integer root.
+	static inline __m128d sqrt_half(vec v)
+	{
+		__m128d d = _mm_cvtepi32_pd(v);
+		__m128d wrap = _mm_cvtepi32_pd(_mm_srai_epi32(v, 31));	//-1.0 for negative lanes
+		return _mm_sqrt_pd(_mm_sub_pd(d, _mm_mul_pd(wrap, _mm_set1_pd(4294967296.0))));
+	}
+	static inline vec sqrt_u32(vec v)
+	{
+		vec lo = _mm_cvttpd_epi32(sqrt_half(v));
+		vec hi = _mm_cvttpd_epi32(sqrt_half(_mm_unpackhi_epi64(v, v)));
+		return _mm_unpacklo_epi64(lo, hi);
+	}
+};
+
+}
+
+const TrigBatchKernels* trig_batch_kernels_sse41(void)
+{
+	return make_kernels<Sse41>();
+}
+
+#else
+
+const TrigBatchKernels* trig_batch_kernels_sse41(void)
+{
+	return nullptr;
+}
+
+#endif
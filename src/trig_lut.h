@@ -0,0 +1,199 @@
+#ifndef TRIG_LUT_H
+#define TRIG_LUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include "trig_fixed.h"
+
+/*
+	Lookup-table alternatives to the polynomial sin/cos/atan2 in trig_fixed.c, in the same
+	fixed-point units: angles and outputs are scaled by 2^Q, so TrigLut<14, ...>::sin is a
+	drop-in for sin_14b and TrigLut<12, ...>::sin for sin_12b.
+
+	The tables are generated at compile time (constexpr series, no <cmath>), so there is no
+	runtime init and each configuration is just a const array in .rodata. Table size and
+	interpolation are template parameters; trig_lut_report measures max error and ns/call for
+	each configuration next to the polynomial versions, to pick the cheapest one that meets
+	an error budget.
+
+		sin(theta)     theta in [-PI_Q, 2PI_Q), which covers the polynomial's range and cos's shift
+		cos(theta)     theta in [-3PI_Q/2, 3PI_Q/2]
+		atan2(y, x)    any int32 y, x (the ratio is formed in 64 bits); same edge cases as
+		               atan2_14b (0 at the origin, PI on the negative x axis)
+*/
+
+typedef enum {TRIG_LUT_NEAREST, TRIG_LUT_LINEAR} trig_lut_interp_t;
+
+namespace trig_lut_detail {
+
+constexpr double PI = 3.14159265358979323846;
+
+// sin on [-pi/2, pi/2] by Taylor series; enough terms for full double precision
+constexpr double sin_series(double x)
+{
+	double term = x;
+	double sum = x;
+	for (int n = 1; n < 20; n++)
+	{
+		term *= -x * x / (double)((2 * n) * (2 * n + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double sqrt_newton(double v)
+{
+	if (v <= 0.0)
+		return 0.0;
+	double r = v > 1.0 ? v : 1.0;
+	for (int i = 0; i < 64; i++)
+		r = 0.5 * (r + v / r);
+	return r;
+}
+
+// atan on [0, 1]: two half-angle reductions bring x under tan(pi/16), then the series converges fast
+constexpr double atan_01(double x)
+{
+	for (int i = 0; i < 2; i++)
+		x = x / (1.0 + sqrt_newton(1.0 + x * x));
+	double term = x;
+	double sum = x;
+	for (int n = 1; n < 30; n++)
+	{
+		term *= -x * x;
+		sum += term / (double)(2 * n + 1);
+	}
+	return 4.0 * sum;
+}
+
+constexpr int32_t round_to_i32(double v)
+{
+	return (int32_t)(v < 0.0 ? v - 0.5 : v + 0.5);
+}
+
+// Table entries carry this many bits below the output LSB, so interpolation rounds once at the end
+constexpr int EXTRA = 8;
+
+// quarter-wave table: entry i is sin at angle i/2^B of the way to HALF_PI, in Q + EXTRA units
+template <int Q, int B>
+constexpr std::array<int32_t, (1 << B) + 1> make_sin_table(int32_t half_pi)
+{
+	std::array<int32_t, (1 << B) + 1> t = {};
+	for (int i = 0; i <= (1 << B); i++)
+	{
+		double theta = (double)half_pi * (double)i / (double)(1 << B) / (double)(1 << Q);	//radians
+		t[i] = round_to_i32(sin_series(theta) * (double)(1 << (Q + EXTRA)));
+	}
+	return t;
+}
+
+// entry i is atan(i/2^B) in Q + EXTRA units
+template <int Q, int B>
+constexpr std::array<int32_t, (1 << B) + 1> make_atan_table(void)
+{
+	std::array<int32_t, (1 << B) + 1> t = {};
+	for (int i = 0; i <= (1 << B); i++)
+	{
+		t[i] = round_to_i32(atan_01((double)i / (double)(1 << B)) * (double)(1 << (Q + EXTRA)));
+	}
+	return t;
+}
+
+}
+
+template <int Q, int TABLE_BITS, trig_lut_interp_t INTERP = TRIG_LUT_LINEAR>
+struct TrigLut
+{
+	static_assert(Q >= 8 && Q <= 16, "angles in Q8..Q16");
+	static_assert(TABLE_BITS >= 2 && TABLE_BITS <= 14, "2^2..2^14 table entries");
+
+	static constexpr int32_t HALF_PI = trig_lut_detail::round_to_i32(trig_lut_detail::PI / 2.0 * (double)(1 << Q));
+	static constexpr int32_t PI = 2 * HALF_PI;
+	static constexpr int32_t TWO_PI = 4 * HALF_PI;
+	static_assert(Q != 12 || (HALF_PI == HALF_PI_12B && PI == PI_12B && TWO_PI == TWO_PI_12B), "must agree with trig_fixed.h");
+	static_assert(Q != 14 || (HALF_PI == HALF_PI_14B && PI == PI_14B && TWO_PI == TWO_PI_14B), "must agree with trig_fixed.h");
+
+	static constexpr int FRAC = 16;	//fractional bits of the table position
+	static constexpr uint64_t SIN_STEP = (((uint64_t)1 << (TABLE_BITS + FRAC + 32)) + HALF_PI / 2) / HALF_PI;	//table position per angle unit, Q32
+
+	static constexpr std::array<int32_t, (1 << TABLE_BITS) + 1> sin_table = trig_lut_detail::make_sin_table<Q, TABLE_BITS>(HALF_PI);
+	static constexpr std::array<int32_t, (1 << TABLE_BITS) + 1> atan_table = trig_lut_detail::make_atan_table<Q, TABLE_BITS>();
+
+	static constexpr std::size_t table_bytes(void) { return sizeof(sin_table) + sizeof(atan_table); }
+
+	// table lookup at a position with FRAC fractional bits, 0..2^(TABLE_BITS+FRAC), rounded to Q
+	static inline int32_t lookup(const std::array<int32_t, (1 << TABLE_BITS) + 1>& t, uint32_t pos)
+	{
+		const int32_t half = 1 << (trig_lut_detail::EXTRA - 1);
+		if (INTERP == TRIG_LUT_NEAREST)
+		{
+			return (t[(pos + (1u << (FRAC - 1))) >> FRAC] + half) >> trig_lut_detail::EXTRA;
+		}
+		uint32_t i = pos >> FRAC;
+		if (i >= (1u << TABLE_BITS))
+		{
+			return (t[1 << TABLE_BITS] + half) >> trig_lut_detail::EXTRA;
+		}
+		int32_t frac = (int32_t)(pos & ((1u << FRAC) - 1));
+		int32_t y0 = t[i];
+		int32_t y = y0 + (int32_t)(((int64_t)(t[i + 1] - y0) * frac) >> FRAC);
+		return (y + half) >> trig_lut_detail::EXTRA;
+	}
+
+	static inline int32_t sin(int32_t theta)
+	{
+		bool neg = false;
+		if (theta < 0)
+		{
+			theta = -theta;
+			neg = true;
+		}
+		if (theta > PI)
+		{
+			theta -= PI;
+			neg = !neg;
+		}
+		if (theta > HALF_PI)
+		{
+			theta = PI - theta;
+		}
+		uint32_t pos = (uint32_t)(((uint64_t)theta * SIN_STEP) >> 32);
+		int32_t r = lookup(sin_table, pos);
+		return neg ? -r : r;
+	}
+
+	static inline int32_t cos(int32_t theta)
+	{
+		return sin(theta + HALF_PI);
+	}
+
+	static inline int32_t atan2(int32_t y, int32_t x)
+	{
+		if (x == 0)
+		{
+			if (y == 0)
+				return 0;
+			return (y > 0) ? HALF_PI : -HALF_PI;
+		}
+		if (y == 0)
+		{
+			return (x > 0) ? 0 : PI;
+		}
+		int64_t abs_s = y < 0 ? -(int64_t)y : (int64_t)y;
+		int64_t abs_c = x < 0 ? -(int64_t)x : (int64_t)x;
+		int64_t minv = abs_s < abs_c ? abs_s : abs_c;
+		int64_t maxv = abs_s < abs_c ? abs_c : abs_s;
+		uint32_t pos = (uint32_t)((minv << (TABLE_BITS + FRAC)) / maxv);
+		int32_t r = lookup(atan_table, pos);
+		if (abs_s > abs_c)
+			r = HALF_PI - r;
+		if (x < 0)
+			r = PI - r;
+		if (y < 0)
+			r = -r;
+		return r;
+	}
+};
+
+#endif // TRIG_LUT_H
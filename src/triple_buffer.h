@@ -0,0 +1,69 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+	Lock-free single producer / single consumer handoff of the latest value of T.
+	The producer always has a private slot to fill, the consumer always has a private slot
+	to read, and the third slot is swapped between them atomically. Neither side ever waits;
+	the consumer simply sees the most recent published value (intermediate values may be skipped).
+
+	T should be trivially copyable and fixed size - no allocations happen here.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+		: slots()
+		, back(0)
+		, middle(1)
+		, front(2)
+	{
+	}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Producer: slot to fill before publish()
+	T& write_slot()
+	{
+		return slots[back];
+	}
+
+	// Producer: make the write slot visible to the consumer
+	void publish()
+	{
+		back = middle.exchange(back | DIRTY_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Consumer: pick up the newest published value, if any. Returns true if read() changed.
+	bool update()
+	{
+		if ((middle.load(std::memory_order_relaxed) & DIRTY_BIT) == 0)
+		{
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	// Consumer: latest value picked up by update()
+	const T& read() const
+	{
+		return slots[front];
+	}
+
+private:
+	static constexpr uint8_t INDEX_MASK = 0x3;
+	static constexpr uint8_t DIRTY_BIT = 0x4;
+
+	T slots[3];
+	uint8_t back;	//producer-owned index
+	std::atomic<uint8_t> middle;	//shared index, DIRTY_BIT set when it holds an unread value
+	uint8_t front;	//consumer-owned index
+};
+
+#endif // TRIPLE_BUFFER_H
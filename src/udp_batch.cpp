@@ -0,0 +1,369 @@
+#include "udp_batch.h"
+#include "packet_capture.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef UDP_BATCH_SUPPORTED
+
+#include <chrono>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define UDP_BATCH_RX_SLOTS UDP_BATCH_MAX_PEERS
+#define UDP_BATCH_RX_SIZE 64	//matches UdpState::rx_cobs_mem
+#define UDP_BATCH_CTRL_SIZE CMSG_SPACE(sizeof(struct timespec))	//room for SCM_TIMESTAMPNS
+
+UdpBatchTransport::UdpBatchTransport()
+	: stats()
+	, fd(-1)
+	, local_port(0)
+	, peers()
+{
+}
+
+UdpBatchTransport::~UdpBatchTransport()
+{
+	close();
+}
+
+bool UdpBatchTransport::open(void)
+{
+	if (fd >= 0)
+	{
+		return true;
+	}
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		printf("UDP batch: failed to create socket (%d)\n", errno);
+		return false;
+	}
+	struct sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = 0;
+	if (bind(fd, (struct sockaddr*)&local, sizeof(local)) != 0)
+	{
+		printf("UDP batch: failed to bind (%d)\n", errno);
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+	socklen_t local_len = sizeof(local);
+	local_port = (getsockname(fd, (struct sockaddr*)&local, &local_len) == 0) ? ntohs(local.sin_port) : 0;
+	{
+		//kernel receive times, for late replies drained by send() and for packet capture
+		int one = 1;
+		setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one));
+	}
+	for (int i = 0; i < UDP_BATCH_MAX_PEERS; i++)
+	{
+		peers[i].valid = false;
+	}
+	return true;
+}
+
+void UdpBatchTransport::close(void)
+{
+	if (fd >= 0)
+	{
+		::close(fd);
+		fd = -1;
+	}
+}
+
+bool UdpBatchTransport::is_open(void) const
+{
+	return fd >= 0;
+}
+
+bool UdpBatchTransport::resolve_peer(int idx, const UdpState* state)
+{
+	Peer& p = peers[idx];
+	if (p.valid && p.port == state->port && strncmp(p.ip, state->ip, sizeof(p.ip)) == 0)
+	{
+		return true;
+	}
+	struct in_addr a;
+	if (inet_pton(AF_INET, state->ip, &a) != 1)
+	{
+		p.valid = false;
+		return false;
+	}
+	snprintf(p.ip, sizeof(p.ip), "%s", state->ip);
+	p.port = state->port;
+	p.addr_be = a.s_addr;
+	p.port_be = htons(state->port);
+	p.valid = true;
+	return true;
+}
+
+int UdpBatchTransport::match_peer(uint32_t addr_be, uint16_t port_be, int n) const
+{
+	for (int i = 0; i < n; i++)
+	{
+		if (peers[i].valid && peers[i].addr_be == addr_be && peers[i].port_be == port_be)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int UdpBatchTransport::send(UdpState* const* states, int n)
+{
+	if (fd < 0 || n > UDP_BATCH_MAX_PEERS)
+	{
+		return -1;
+	}
+
+	struct mmsghdr msgs[UDP_BATCH_MAX_PEERS];
+	struct iovec iovs[UDP_BATCH_MAX_PEERS];
+	struct sockaddr_in dst[UDP_BATCH_MAX_PEERS];
+	int count = 0;
+	for (int i = 0; i < n; i++)
+	{
+		UdpState* s = states[i];
+		if (s->tx_staged_len == 0)
+		{
+			continue;
+		}
+		if (!resolve_peer(i, s))
+		{
+			s->tx_staged_len = 0;
+			s->awaiting_reply = false;
+			continue;
+		}
+		memset(&dst[count], 0, sizeof(dst[count]));
+		dst[count].sin_family = AF_INET;
+		dst[count].sin_addr.s_addr = peers[i].addr_be;
+		dst[count].sin_port = peers[i].port_be;
+
+		iovs[count].iov_base = s->tx_cobs_mem;
+		iovs[count].iov_len = s->tx_staged_len;
+
+		memset(&msgs[count], 0, sizeof(msgs[count]));
+		msgs[count].msg_hdr.msg_name = &dst[count];
+		msgs[count].msg_hdr.msg_namelen = sizeof(dst[count]);
+		msgs[count].msg_hdr.msg_iov = &iovs[count];
+		msgs[count].msg_hdr.msg_iovlen = 1;
+		count++;
+	}
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	//whatever is queued now arrived after the last gather gave up, so it predates these requests
+	int drained = 0;
+	while (receive(states, n, true, &drained) == UDP_BATCH_RX_SLOTS)
+	{
+	}
+
+	int64_t tx_time_ns = udp_now_ns();
+	int sent = sendmmsg(fd, msgs, count, 0);
+	stats.syscalls++;
+	if (sent < 0)
+	{
+		sent = 0;
+	}
+	stats.frames_sent += sent;
+
+	int k = 0;
+	for (int i = 0; i < n; i++)
+	{
+		UdpState* s = states[i];
+		if (s->tx_staged_len == 0)
+		{
+			continue;
+		}
+		if (udp_capture != nullptr && k < sent)
+		{
+			udp_capture->record(CAPTURE_TX, CAPTURE_WIRE, ntohl(peers[i].addr_be), peers[i].port, local_port,
+				s->tx_cobs_mem, s->tx_staged_len, capture_realtime_ns());
+		}
+		s->awaiting_reply = (k < sent);	//anything the kernel did not take will not be answered
+		s->tx_time_ns = tx_time_ns;
+		if (s->awaiting_reply)
+		{
+			udp_expect_reply(s);
+		}
+		s->rx_pending_len = 0;
+		s->tx_staged_len = 0;
+		k++;
+	}
+	return sent;
+}
+
+//SO_TIMESTAMPNS receive time from a received message, or 0 if the kernel did not attach one
+static int64_t kernel_time_ns(struct msghdr* msg)
+{
+	for (struct cmsghdr* c = CMSG_FIRSTHDR(msg); c != NULL; c = CMSG_NXTHDR(msg, c))
+	{
+		if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+		{
+			struct timespec ts;
+			memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+			return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+		}
+	}
+	return 0;
+}
+
+/*
+	One non-blocking recvmmsg, demultiplexed onto the peers' states. Before a send (late set)
+	every datagram is a late reply to the previous cycle and is dropped through
+	udp_drop_late_reply with its kernel arrival time; otherwise replies go through udp_accept_reply and the accepted ones
+	are stashed for a UDP_MODE_REPLAY parse. Returns datagrams received, with the number
+	accepted added to *matched.
+*/
+int UdpBatchTransport::receive(UdpState* const* states, int n, bool late, int* matched)
+{
+	unsigned char rx_mem[UDP_BATCH_RX_SLOTS][UDP_BATCH_RX_SIZE];
+	struct mmsghdr msgs[UDP_BATCH_RX_SLOTS];
+	struct iovec iovs[UDP_BATCH_RX_SLOTS];
+	struct sockaddr_in src[UDP_BATCH_RX_SLOTS];
+	alignas(struct cmsghdr) char ctrl[UDP_BATCH_RX_SLOTS][UDP_BATCH_CTRL_SIZE];
+
+	for (int j = 0; j < UDP_BATCH_RX_SLOTS; j++)
+	{
+		iovs[j].iov_base = rx_mem[j];
+		iovs[j].iov_len = UDP_BATCH_RX_SIZE;
+		memset(&msgs[j], 0, sizeof(msgs[j]));
+		msgs[j].msg_hdr.msg_name = &src[j];
+		msgs[j].msg_hdr.msg_namelen = sizeof(src[j]);
+		msgs[j].msg_hdr.msg_iov = &iovs[j];
+		msgs[j].msg_hdr.msg_iovlen = 1;
+		msgs[j].msg_hdr.msg_control = ctrl[j];
+		msgs[j].msg_hdr.msg_controllen = UDP_BATCH_CTRL_SIZE;
+	}
+	int got = recvmmsg(fd, msgs, UDP_BATCH_RX_SLOTS, MSG_DONTWAIT, nullptr);
+	stats.syscalls++;
+	if (got <= 0)
+		return 0;
+	stats.frames_received += got;
+	int64_t rx_time_ns = udp_now_ns();
+
+	for (int j = 0; j < got; j++)
+	{
+		int i = match_peer(src[j].sin_addr.s_addr, src[j].sin_port, n);
+		if (i < 0 || msgs[j].msg_len == 0)
+		{
+			stats.frames_unmatched++;
+			continue;
+		}
+		UdpState* s = states[i];
+		int64_t kernel_ts_ns = kernel_time_ns(&msgs[j].msg_hdr);
+		if (udp_capture != nullptr)
+		{
+			udp_capture->record(CAPTURE_RX, CAPTURE_WIRE, ntohl(src[j].sin_addr.s_addr), ntohs(src[j].sin_port), local_port,
+				rx_mem[j], msgs[j].msg_len, kernel_ts_ns != 0 ? kernel_ts_ns : capture_realtime_ns());
+		}
+		if (late)
+		{
+			udp_drop_late_reply(s, udp_arrival_ns(kernel_ts_ns));	//timed by arrival, not by this drain
+			continue;
+		}
+		if (!udp_accept_reply(s))
+		{
+			continue;	//duplicate, counted on the state
+		}
+		memcpy(s->rx_cobs_mem, rx_mem[j], msgs[j].msg_len);
+		s->rx_pending_len = msgs[j].msg_len;
+		s->rx_time_ns = rx_time_ns;
+		s->awaiting_reply = false;
+		(*matched)++;
+	}
+	return got;
+}
+
+int UdpBatchTransport::gather(UdpState* const* states, int n, uint32_t timeout_ms)
+{
+	if (fd < 0)
+	{
+		return 0;
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+	int matched = 0;
+	while (true)
+	{
+		int outstanding = 0;
+		for (int i = 0; i < n; i++)
+		{
+			if (states[i]->awaiting_reply)
+				outstanding++;
+		}
+		if (outstanding == 0)
+			break;
+
+		auto now = std::chrono::steady_clock::now();
+		if (now >= deadline)
+			break;
+		//round up so a sub-millisecond remainder still polls instead of spinning
+		int remaining_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now + std::chrono::microseconds(999)).count();
+
+		struct pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		int pr = poll(&pfd, 1, remaining_ms);
+		stats.syscalls++;
+		if (pr <= 0)
+			break;
+
+		receive(states, n, false, &matched);
+	}
+	return matched;
+}
+
+#else
+
+UdpBatchTransport::UdpBatchTransport()
+	: stats()
+	, fd(-1)
+	, local_port(0)
+	, peers()
+{
+}
+
+UdpBatchTransport::~UdpBatchTransport()
+{
+}
+
+bool UdpBatchTransport::open(void)
+{
+	printf("UDP batch: sendmmsg/recvmmsg transport is only available on Linux\n");
+	return false;
+}
+
+void UdpBatchTransport::close(void)
+{
+}
+
+bool UdpBatchTransport::is_open(void) const
+{
+	return false;
+}
+
+int UdpBatchTransport::send(UdpState* const* states, int n)
+{
+	(void)states;
+	(void)n;
+	return -1;
+}
+
+int UdpBatchTransport::gather(UdpState* const* states, int n, uint32_t timeout_ms)
+{
+	(void)states;
+	(void)n;
+	(void)timeout_ms;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef UDP_BATCH_H
+#define UDP_BATCH_H
+
+#include <cstdint>
+#include <cstddef>
+#include "dartt_init.h"
+
+/*
+	Linux-only batched transport. All actuators share one unconnected UDP socket:
+	every request staged for the cycle (UDP_MODE_STAGE) goes out in a single sendmmsg,
+	and replies are drained with recvmmsg and demultiplexed by source address back
+	onto each peer's UdpState, ready for a UDP_MODE_REPLAY parse.
+
+	The per-motor connected sockets are untouched and still carry the blocking
+	transactions (writes, zeroing, calibration).
+*/
+#if defined(__linux__) && !defined(__ANDROID__)
+#define UDP_BATCH_SUPPORTED
+#endif
+
+#define UDP_BATCH_MAX_PEERS 16
+
+struct UdpBatchStats
+{
+	uint64_t syscalls;	//every socket syscall issued by the transport (sendmmsg, recvmmsg, poll)
+	uint64_t frames_sent;
+	uint64_t frames_received;
+	uint64_t frames_unmatched;	//datagrams from an address that is not a known peer
+};
+
+class UdpBatchTransport
+{
+public:
+	UdpBatchStats stats;
+
+	UdpBatchTransport();
+	~UdpBatchTransport();
+
+	UdpBatchTransport(const UdpBatchTransport&) = delete;
+	UdpBatchTransport& operator=(const UdpBatchTransport&) = delete;
+
+	bool open(void);
+	void close(void);
+	bool is_open(void) const;
+
+	// Send every staged datagram in states[0..n) with one sendmmsg and mark those states awaiting_reply.
+	// Replies to the previous cycle still queued on the socket are drained as late first.
+	// Peers are addressed by their UdpState ip/port (re-resolved only when those change).
+	// Returns datagrams sent, -1 on error.
+	int send(UdpState* const* states, int n);
+
+	// Drain replies until every state with awaiting_reply has a current one, or timeout_ms elapses.
+	// Duplicate replies are dropped (see udp_accept_reply). Returns the number of replies accepted.
+	int gather(UdpState* const* states, int n, uint32_t timeout_ms);
+
+private:
+	int fd;
+	uint16_t local_port;	//for packet capture
+
+	//cached destination per peer slot, keyed on the ip/port it was resolved from
+	struct Peer
+	{
+		char ip[64];
+		uint16_t port;
+		bool valid;
+		uint32_t addr_be;	//network order
+		uint16_t port_be;
+	};
+	Peer peers[UDP_BATCH_MAX_PEERS];
+
+	bool resolve_peer(int idx, const UdpState* state);
+	int match_peer(uint32_t addr_be, uint16_t port_be, int n) const;
+	int receive(UdpState* const* states, int n, bool late, int* matched);
+};
+
+#endif // UDP_BATCH_H
@@ -1,10 +1,11 @@
 #include "ui.h"
-#include "spooler_robot.h"
+#include "control_loop.h"
 #include "imgui.h"
 #include "imgui_impl_sdl2.h"
 #include "imgui_impl_opengl3.h"
 #include <SDL.h>
 #include <cstdio>
+#include <cfloat>
 #include <vector>
 #include <string>
 #include "colors.h"
@@ -53,29 +54,28 @@ void shutdown_imgui()
     ImGui::DestroyContext();
 }
 
-void render_socket_ui(SpoolerRobot& robot)
+void render_socket_ui(const RobotSnapshot& snap, ControlInput& in)
 {
     ImGui::Begin("Socket Config");
-    for (int i = 0; i < (int)robot.motors.size(); i++)
+    for (int i = 0; i < snap.num_motors; i++)
     {
-        Motor& m = robot.motors[i];
         ImGui::PushID(i);
         ImGui::Text("Motor %d", i);
         ImGui::SameLine();
-        if (m.socket.connected)
+        if (snap.connected[i])
             ImGui::TextColored(ImVec4(0,1,0,1), "[Connected]");
         else
             ImGui::TextColored(ImVec4(1,0.3f,0.3f,1), "[Disconnected]");
 
-        if (ImGui::InputText("IP", m.socket.ip, sizeof(m.socket.ip),
+        if (ImGui::InputText("IP", in.ip[i], sizeof(in.ip[i]),
                              ImGuiInputTextFlags_EnterReturnsTrue))
-            udp_connect(&m.socket);
+            in.reconnect_seq[i]++;
 
-        int port = m.socket.port;
+        int port = in.port[i];
         if (ImGui::InputInt("Port", &port, 0, 0))
         {
             if (port > 0 && port <= 65535)
-            { m.socket.port = (uint16_t)port; udp_connect(&m.socket); }
+            { in.port[i] = (uint16_t)port; in.reconnect_seq[i]++; }
         }
         ImGui::Separator();
         ImGui::PopID();
@@ -83,15 +83,15 @@ void render_socket_ui(SpoolerRobot& robot)
     ImGui::End();
 }
 
-void render_telemetry_ui(SpoolerRobot& robot, int & mode)
+void render_telemetry_ui(const RobotSnapshot& snap, ControlInput& in)
 {
     ImGui::Begin("Telemetry");
 
-	ImGui::RadioButton("FORCE", &mode, FORCE_MODE);
+	ImGui::RadioButton("FORCE", &in.mode, FORCE_MODE);
 	ImGui::SameLine();
-	ImGui::RadioButton("PCTL TYPED", &mode, PCTL_TYPED);
+	ImGui::RadioButton("PCTL TYPED", &in.mode, PCTL_TYPED);
 	ImGui::SameLine();
-	ImGui::RadioButton("PCTL CURSOR", &mode, PCTL_CURSOR);
+	ImGui::RadioButton("PCTL CURSOR", &in.mode, PCTL_CURSOR);
 	
     if (ImGui::BeginTable("telem", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
     {
@@ -99,30 +99,36 @@ void render_telemetry_ui(SpoolerRobot& robot, int & mode)
         ImGui::TableSetupColumn("Pos (deg)");
         ImGui::TableSetupColumn("Iq");
         ImGui::TableSetupColumn("dQ");
-        for (int i = 0; i < (int)robot.motors.size(); i++)
+        for (int i = 0; i < snap.num_motors; i++)
         {
             ImGui::TableNextRow();
             ImGui::TableSetColumnIndex(0); ImGui::Text("%d", i);
-            ImGui::TableSetColumnIndex(1); ImGui::Text("%.3f", robot.p[i]);
-            ImGui::TableSetColumnIndex(2); ImGui::Text("%.1f", (double)robot.iq[i]);
-			ImGui::TableSetColumnIndex(3); ImGui::Text("%.3f", robot.dp[i]);
+            ImGui::TableSetColumnIndex(1); ImGui::Text("%.3f", (double)snap.p[i]);
+            ImGui::TableSetColumnIndex(2); ImGui::Text("%.1f", (double)snap.iq[i]);
+			ImGui::TableSetColumnIndex(3); ImGui::Text("%.3f", (double)snap.dp[i]);
         }
         ImGui::EndTable();
     }
 	ImGui::Text("k");
 	ImGui::SameLine();
-	ImGui::InputScalar("##pctl_gain", ImGuiDataType_Float, &robot.k);
+	ImGui::InputScalar("##pctl_gain", ImGuiDataType_Float, &in.k);
 	ImGui::Text("kd");
 	ImGui::SameLine();
-	ImGui::InputScalar("##derivative_gain", ImGuiDataType_Float, &robot.kd);
+	ImGui::InputScalar("##derivative_gain", ImGuiDataType_Float, &in.kd);
 
 	ImGui::Text("tmax");
 	ImGui::SameLine();
-	ImGui::InputScalar("##tmax", ImGuiDataType_Float, &robot.tmax);
+	ImGui::InputScalar("##tmax", ImGuiDataType_Float, &in.tmax);
 
+	//targ is also moved by the controller, so show the live value and only send edits
 	ImGui::Text("targ");
 	ImGui::SameLine();
-	ImGui::InputScalar("##targ", ImGuiDataType_Float, &robot.targ);
+	float targ = snap.targ;
+	if (ImGui::InputScalar("##targ", ImGuiDataType_Float, &targ))
+	{
+		in.targ = targ;
+		in.targ_seq++;
+	}
 	
 
 	// if(ImGui::Button("Rezero"))
@@ -143,20 +149,121 @@ void render_telemetry_ui(SpoolerRobot& robot, int & mode)
 	// 	}
 	// }
 
-	if(ImGui::Button("Calibrate"))
+	if(snap.calibrating)
 	{
-		robot.calibrate();
+		ImGui::Text("calibrating...");
+	}
+	else if(ImGui::Button("Calibrate"))
+	{
+		in.calibrate_seq++;
 	}
 
 	if(ImGui::Button("Do Oscillate"))
 	{
-		robot.do_oscillation = !robot.do_oscillation;
+		in.oscillate_toggle_seq++;
 	}
 	ImGui::SameLine();
-	if(robot.do_oscillation)
+	if(snap.do_oscillation)
 	{
 		ImGui::Text("oscillating...");
 	}
+
+	ImGui::Text("control: %llu cycles, %llu overruns, last cycle %.0f us",
+		(unsigned long long)snap.cycle_count, (unsigned long long)snap.overrun_count, (double)snap.cycle_us);
+	if (snap.plot_drops != 0)
+	{
+		ImGui::Text("plot feed: %llu samples dropped", (unsigned long long)snap.plot_drops);
+	}
 	
     ImGui::End();
 }
+
+void render_comms_ui(const CommsStatsSnapshot& stats, ControlInput& in)
+{
+    ImGui::Begin("Comms Performance");
+
+    if (ImGui::BeginTable("comms", 12, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+    {
+        ImGui::TableSetupColumn("Motor");
+        ImGui::TableSetupColumn("Timeout us");
+        ImGui::TableSetupColumn("Tx");
+        ImGui::TableSetupColumn("p50 us");
+        ImGui::TableSetupColumn("p99 us");
+        ImGui::TableSetupColumn("p999 us");
+        ImGui::TableSetupColumn("max us");
+        ImGui::TableSetupColumn("Timeout");
+        ImGui::TableSetupColumn("COBS");
+        ImGui::TableSetupColumn("Short");
+        ImGui::TableSetupColumn("Stale/Dup");
+        ImGui::TableSetupColumn("Wr/Retry");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < stats.num_motors; i++)
+        {
+            const MotorCommsStats& s = stats.motors[i];
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0); ImGui::Text("%d", i);
+            ImGui::TableSetColumnIndex(1); ImGui::Text("%u", s.timeout_us);
+            ImGui::TableSetColumnIndex(2); ImGui::Text("%llu", (unsigned long long)s.transactions);
+            ImGui::TableSetColumnIndex(3); ImGui::Text("%u", s.rtt.percentile(0.5));
+            ImGui::TableSetColumnIndex(4); ImGui::Text("%u", s.rtt.percentile(0.99));
+            ImGui::TableSetColumnIndex(5); ImGui::Text("%u", s.rtt.percentile(0.999));
+            ImGui::TableSetColumnIndex(6); ImGui::Text("%u", s.rtt.max_us);
+            ImGui::TableSetColumnIndex(7); ImGui::Text("%llu", (unsigned long long)s.timeouts);
+            ImGui::TableSetColumnIndex(8); ImGui::Text("%llu", (unsigned long long)s.cobs_failures);
+            ImGui::TableSetColumnIndex(9); ImGui::Text("%llu", (unsigned long long)s.short_reads);
+            ImGui::TableSetColumnIndex(10); ImGui::Text("%llu/%llu", (unsigned long long)s.stale_replies, (unsigned long long)s.duplicate_replies);
+            ImGui::TableSetColumnIndex(11); ImGui::Text("%llu/%llu", (unsigned long long)(s.write_failures + s.send_failures), (unsigned long long)s.retries);
+        }
+        ImGui::EndTable();
+    }
+
+    //RTT histogram per motor, trimmed to the occupied bucket range
+    for (int i = 0; i < stats.num_motors; i++)
+    {
+        const LatencyHistogram& h = stats.motors[i].rtt;
+        if (h.total == 0)
+            continue;
+        int lo = LatencyHistogram::bucket_of(h.min_us);
+        int hi = LatencyHistogram::bucket_of(h.max_us);
+        float bars[LATENCY_BUCKETS];
+        for (int b = lo; b <= hi; b++)
+            bars[b - lo] = (float)h.counts[b];
+        char label[64];
+        snprintf(label, sizeof(label), "m%d %u..%u us", i, h.min_us, h.max_us);
+        ImGui::PlotHistogram(label, bars, hi - lo + 1, 0, nullptr, 0.f, FLT_MAX, ImVec2(0, 60));
+    }
+
+    if (ImGui::Button("Reset"))
+    {
+        in.stats_reset_seq++;
+    }
+
+    ImGui::End();
+}
+
+void render_plot_ui(Plotter& plot)
+{
+    ImGui::Begin("Plot");
+
+    bool live = (plot.view_seconds <= 0.f);
+    if (ImGui::Checkbox("Live buffer", &live))
+    {
+        plot.view_seconds = live ? 0.f : 60.f;
+    }
+    if (!live)
+    {
+        //1 s to a day, from the lines' history pyramids
+        ImGui::SliderFloat("Window (s)", &plot.view_seconds, 1.f, 86400.f, "%.0f", ImGuiSliderFlags_Logarithmic);
+        ImGui::Checkbox("Mean", &plot.view_mean);
+        for (int i = 0; i < (int)plot.lines.size(); i++)
+        {
+            const RingBuffer<HistoryBin>& top = plot.lines[i].history.level(HISTORY_LEVELS - 1);
+            if (!top.empty())
+            {
+                ImGui::Text("line %d: %.0f s of history", i, top.back().t_last - top.front().t_first);
+            }
+        }
+    }
+
+    ImGui::End();
+}
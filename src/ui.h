@@ -6,7 +6,9 @@
 
 enum {FORCE_MODE, PCTL_TYPED, PCTL_CURSOR};
 
-class SpoolerRobot;
+struct ControlInput;
+struct RobotSnapshot;
+struct CommsStatsSnapshot;
 
 // Initialize ImGui (call after SDL/OpenGL setup)
 bool init_imgui(SDL_Window* window, SDL_GLContext gl_context);
@@ -14,7 +16,13 @@ bool init_imgui(SDL_Window* window, SDL_GLContext gl_context);
 // Shutdown ImGui
 void shutdown_imgui();
 
-void render_socket_ui(SpoolerRobot& robot);
-void render_telemetry_ui(SpoolerRobot& robot, int & mode);
+// The control thread owns the robot: these draw from its latest snapshot and
+// post any edits back through the input block
+void render_socket_ui(const RobotSnapshot& snap, ControlInput& in);
+void render_telemetry_ui(const RobotSnapshot& snap, ControlInput& in);
+void render_comms_ui(const CommsStatsSnapshot& stats, ControlInput& in);
+
+// Plot view: live buffer, or a zoomable window over the lines' history
+void render_plot_ui(Plotter& plot);
 
 #endif // DARTT_UI_H